@@ -0,0 +1,78 @@
+#pragma once
+
+// OpenCL SDK includes
+#include "OpenCLSDKCpp_Export.h"
+
+// OpenCL includes
+#include <CL/opencl.hpp>
+
+// STL includes
+#include <vector>
+
+namespace cl {
+namespace sdk {
+    // Level 1 BLAS operations on vectors of n floats in device buffers.
+    // Kernels load vectors of several floats at once and loop over the
+    // elements with a grid stride, so that a fixed number of work-groups,
+    // enough to fill the device, covers vectors of any length. Reductions
+    // write a partial result per work-group, which are read and summed on
+    // the host, so they block until the result is known.
+    class SDKCPP_EXPORT Blas {
+    public:
+        // vector_width is the number of floats loaded at once: 1, 2, 4, 8
+        // or 16. If 0, CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT of device.
+        Blas(const cl::Context& context, const cl::Device& device,
+             const cl::CommandQueue& queue, cl_uint vector_width = 0);
+
+        // y = alpha * x + y
+        cl::Event axpy(cl_float alpha, const cl::Buffer& x, const cl::Buffer& y,
+                       cl::size_type n);
+
+        // y = alpha * x + beta * y
+        cl::Event axpby(cl_float alpha, const cl::Buffer& x, cl_float beta,
+                        const cl::Buffer& y, cl::size_type n);
+
+        // x = alpha * x
+        cl::Event scal(cl_float alpha, const cl::Buffer& x, cl::size_type n);
+
+        cl_float dot(const cl::Buffer& x, const cl::Buffer& y, cl::size_type n);
+
+        // Square root of dot(x, x), without the scaling of reference BLAS
+        // against overflow.
+        cl_float nrm2(const cl::Buffer& x, cl::size_type n);
+
+        // Sum of the absolute values
+        cl_float asum(const cl::Buffer& x, cl::size_type n);
+
+        // y = alpha * x + beta * y, and returns the dot product of the new y
+        // and z in the same pass over the vectors. z may be y, for the
+        // squared norm of the result.
+        cl_float axpby_dot(cl_float alpha, const cl::Buffer& x, cl_float beta,
+                           const cl::Buffer& y, const cl::Buffer& z,
+                           cl::size_type n);
+
+        cl_uint vector_width() const { return width; }
+
+    private:
+        cl::CommandQueue queue;
+        cl_uint width;
+        cl::size_type local_size;
+        cl::size_type max_groups;
+        // Longest vector the 32-bit indices of the kernels cover without
+        // wrapping around
+        cl::size_type max_length;
+
+        cl::Kernel axpby_kernel, scal_kernel, dot_kernel, asum_kernel,
+            axpby_dot_kernel;
+
+        cl::Buffer partials;
+        std::vector<cl_float> host_partials;
+
+        // Work-groups of a launch over n elements
+        cl::size_type groups(cl::size_type n) const;
+        bool check_length(cl::size_type n, const char* message) const;
+        cl::Event launch(cl::Kernel& kernel, cl::size_type n);
+        cl_float reduce(cl::Kernel& kernel, cl::size_type n);
+    };
+}
+}
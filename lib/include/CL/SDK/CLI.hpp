@@ -136,16 +136,46 @@ namespace sdk {
                                                    "Height of window", false,
                                                    800, "positive integral"),
             std::make_shared<TCLAP::SwitchArg>("f", "fullscreen",
-                                               "Fullscreen window", false));
+                                               "Fullscreen window", false),
+            std::make_shared<TCLAP::ValueArg<std::size_t>>(
+                "u", "steps-per-frame", "Simulation steps per frame", false, 1,
+                "positive integral"));
     }
     template <>
     inline options::Window comprehend<options::Window>(
         std::shared_ptr<TCLAP::ValueArg<int>> width_arg,
         std::shared_ptr<TCLAP::ValueArg<int>> height_arg,
-        std::shared_ptr<TCLAP::SwitchArg> fullscreen_arg)
+        std::shared_ptr<TCLAP::SwitchArg> fullscreen_arg,
+        std::shared_ptr<TCLAP::ValueArg<std::size_t>> steps_per_frame_arg)
     {
         return options::Window{ width_arg->getValue(), height_arg->getValue(),
-                                fullscreen_arg->getValue() };
+                                fullscreen_arg->getValue(),
+                                steps_per_frame_arg->getValue() };
+    }
+
+    template <> inline auto parse<options::Headless>()
+    {
+        return std::make_tuple(
+            std::make_shared<TCLAP::SwitchArg>(
+                "H", "headless",
+                "Update the scene without a window and report steps/s", false),
+            std::make_shared<TCLAP::ValueArg<std::size_t>>(
+                "i", "iterations", "Scene updates to run headless", false,
+                1000, "positive integral"),
+            std::make_shared<TCLAP::ValueArg<double>>(
+                "S", "seconds",
+                "Seconds to run headless, instead of a number of updates",
+                false, 0, "positive real"));
+    }
+    template <>
+    inline options::Headless comprehend<options::Headless>(
+        std::shared_ptr<TCLAP::SwitchArg> headless_arg,
+        std::shared_ptr<TCLAP::ValueArg<std::size_t>> iterations_arg,
+        std::shared_ptr<TCLAP::ValueArg<double>> seconds_arg)
+    {
+        return options::Headless{ headless_arg->getValue(),
+                                  iterations_arg->getValue(),
+                                  seconds_arg->getValue() };
     }
 
 }
@@ -0,0 +1,122 @@
+#pragma once
+
+// OpenCL SDK includes
+#include "OpenCLSDKCpp_Export.h"
+#include <CL/SDK/ReadbackPipeline.hpp>
+
+// OpenCL includes
+#include <CL/opencl.hpp>
+
+// STL includes
+#include <cstdint> // std::uint64_t
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility> // std::pair
+#include <vector>
+
+namespace cl {
+namespace sdk {
+    // State of a simulation at a step, as named sections of raw bytes, for
+    // eg. the contents of device buffers and images.
+    struct SDKCPP_EXPORT Checkpoint
+    {
+        struct Section
+        {
+            std::string name;
+            std::vector<unsigned char> data;
+        };
+
+        std::uint64_t step = 0;
+        std::vector<Section> sections;
+
+        // nullptr if there is no section named name
+        const Section* find(const std::string& name) const;
+    };
+
+    enum class Compression
+    {
+        None,
+        LZ // LZ4 block format, sections that do not shrink are stored raw
+    };
+
+    // Reads the checkpoint file at path, verifying the checksum of every
+    // section.
+    SDKCPP_EXPORT
+    Checkpoint read_checkpoint(const std::string& path,
+                               cl_int* error = nullptr);
+
+    // Writes checkpoint to a temporary file and renames it to path, so that
+    // path holds either the previous or the new checkpoint if interrupted.
+    SDKCPP_EXPORT
+    cl_int write_checkpoint(const std::string& path,
+                            const Checkpoint& checkpoint,
+                            Compression compression = Compression::LZ);
+
+    // Writes checkpoints of device memory to a file in the background. The
+    // sections of a checkpoint are copied to a device buffer, read back to
+    // pinned host memory and written by a thread of a ReadbackPipeline, so
+    // the simulation only waits for the device->device copies.
+    class SDKCPP_EXPORT CheckpointWriter {
+    public:
+        struct Statistics
+        {
+            std::size_t checkpoints;
+            std::uint64_t bytes; // of the sections
+            std::uint64_t stored_bytes; // of the sections after compression
+        };
+
+        // sections are the names and sizes of the sections of every
+        // checkpoint. Device->host reads are enqueued on read_queue. Up to
+        // slots checkpoints are in flight at once.
+        CheckpointWriter(
+            const cl::Context& context, const cl::CommandQueue& read_queue,
+            std::string path,
+            std::vector<std::pair<std::string, cl::size_type>> sections,
+            Compression compression = Compression::LZ, std::size_t slots = 2);
+
+        CheckpointWriter(const CheckpointWriter&) = delete;
+        CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+        // Offset of section in the buffer passed to enqueue_copy
+        cl::size_type offset(std::size_t section) const
+        {
+            return offsets[section];
+        }
+
+        // Writes a checkpoint of step. enqueue_copy must enqueue the copies
+        // of the sections to their offsets in the buffer and return the
+        // event of the last one. Returns that event, so that commands
+        // overwriting the sections may wait for it.
+        cl::Event submit(
+            std::uint64_t step,
+            const std::function<cl::Event(const cl::Buffer&)>& enqueue_copy);
+
+        // Waits until every submitted checkpoint has been written. Rethrows
+        // the first error writing a file, or with exceptions disabled
+        // reports it in error.
+        void finish(cl_int* error = nullptr);
+
+        Statistics statistics() const;
+
+    private:
+        std::string path;
+        std::vector<std::pair<std::string, cl::size_type>> sections;
+        std::vector<cl::size_type> offsets;
+        Compression compression;
+
+        mutable std::mutex mutex;
+        std::size_t submitted;
+        std::map<std::size_t, std::uint64_t> steps; // of frames in flight
+        Statistics stats;
+        cl_int write_error; // first since the last finish()
+
+        // Last, so that its writer thread stops before the members it uses
+        // are destroyed.
+        ReadbackPipeline pipeline;
+
+        void write(const ReadbackPipeline::Frame& frame);
+    };
+}
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+// OpenCL SDK includes
+#include "OpenCLSDKCpp_Export.h"
+
+// OpenCL includes
+#include <CL/opencl.hpp>
+
+// STL includes
+#include <cstddef> // std::size_t
+#include <utility> // std::pair
+#include <vector>
+
+namespace cl {
+namespace sdk {
+    // Records a sequence of kernel launches once and replays it, for eg. the
+    // steps of a simulation between two frames. Uses cl_khr_command_buffer
+    // where the device supports it, so that a replay is a single enqueue, and
+    // launches the kernels one by one otherwise. Arguments of recorded
+    // launches may be changed between replays, in place with
+    // cl_khr_command_buffer_mutable_dispatch, or else by recording again.
+    class SDKCPP_EXPORT CommandBuffer {
+    public:
+        enum class Mode
+        {
+            Direct, // kernels are enqueued one by one
+            Recorded, // changing arguments records the sequence again
+            Mutable // arguments are updated in the recording
+        };
+
+        // queue must be an in-order queue. If native is false, kernels are
+        // always enqueued directly, for eg. to compare the two.
+        explicit CommandBuffer(const cl::CommandQueue& queue,
+                               bool native = true);
+        ~CommandBuffer();
+
+        CommandBuffer(CommandBuffer&& other) noexcept;
+        CommandBuffer& operator=(CommandBuffer&& other) noexcept;
+        CommandBuffer(const CommandBuffer&) = delete;
+        CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+        // Appends a launch of kernel with args as its arguments and returns
+        // the index of the launch. The kernel object may be shared between
+        // launches, its arguments are set before every launch. Memory objects
+        // passed as arguments must outlive the recording.
+        template <typename... Ts>
+        std::size_t add(const cl::Kernel& kernel, const cl::NDRange& global,
+                        const cl::NDRange& local, const Ts&... args)
+        {
+            Launch launch{ kernel, global, local, {}, nullptr };
+            int unpack[] = { 0, (launch.args.push_back(make_arg(args)), 0)... };
+            (void)unpack;
+            return add(std::move(launch));
+        }
+
+        // Sets argument index of launch command to value for the following
+        // replays.
+        template <typename T>
+        void set_arg(std::size_t command, cl_uint index, const T& value)
+        {
+            set_arg(command, index, make_arg(value));
+        }
+
+        // Ends recording. Called by the first enqueue() if not called before.
+        void finalize();
+
+        // Replays the sequence after events complete. Returns the event of
+        // the last launch.
+        cl::Event enqueue(const std::vector<cl::Event>& events = {});
+
+        // Becomes Direct if recording fails.
+        Mode mode() const { return mode_; }
+        std::size_t size() const { return launches.size(); }
+
+    private:
+        struct Arg
+        {
+            cl::size_type size;
+            std::vector<unsigned char> value; // empty for local memory
+        };
+        struct Launch
+        {
+            cl::Kernel kernel;
+            cl::NDRange global, local;
+            std::vector<Arg> args;
+            void* handle; // cl_mutable_command_khr
+        };
+
+        template <typename T> static Arg make_arg(const T& value)
+        {
+            using Handler = cl::detail::KernelArgumentHandler<T>;
+            const auto ptr =
+                reinterpret_cast<const unsigned char*>(Handler::ptr(value));
+            Arg arg{ Handler::size(value), {} };
+            if (ptr != nullptr) arg.value.assign(ptr, ptr + arg.size);
+            return arg;
+        }
+
+        std::size_t add(Launch launch);
+        void set_arg(std::size_t command, cl_uint index, Arg arg);
+        void set_args(Launch& launch);
+        void record();
+        void release();
+
+        cl::CommandQueue queue;
+        Mode mode_;
+        std::vector<Launch> launches;
+        void* buffer; // cl_command_buffer_khr
+        bool finalized;
+        // launches changed since the last replay as (command, argument)
+        std::vector<std::pair<std::size_t, cl_uint>> updates;
+        cl::Event last; // of the last replay
+    };
+}
+}
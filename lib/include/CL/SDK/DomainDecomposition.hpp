@@ -0,0 +1,94 @@
+#pragma once
+
+// OpenCL SDK includes
+#include "OpenCLSDKCpp_Export.h"
+
+// OpenCL includes
+#include <CL/opencl.hpp>
+
+// STL includes
+#include <functional>
+#include <vector>
+
+namespace cl {
+namespace sdk {
+    // Splits a grid along its slowest varying dimension (rows of a 2D grid,
+    // planes of a 3D grid, ...) among several devices of the same context.
+    // Every device gets a contiguous range of slices proportional to its
+    // weight, with range boundaries placed such that sub-buffers created at
+    // them satisfy CL_DEVICE_MEM_BASE_ADDR_ALIGN of all devices.
+    class SDKCPP_EXPORT DomainDecomposition {
+    public:
+        struct Part
+        {
+            cl::Device device;
+            cl::CommandQueue queue;
+            cl::size_type first; // first slice owned by the device
+            cl::size_type count; // may be zero if the grid is too small
+            double weight;
+        };
+
+        // Creates a queue for every device. Initial weights are estimated
+        // from the compute units and clock frequency of the devices, queues
+        // have profiling enabled by default so that rebalance() may be used.
+        DomainDecomposition(
+            const cl::Context& context, const cl::vector<cl::Device>& devices,
+            cl::QueueProperties properties = cl::QueueProperties::Profiling);
+
+        // Splits slices among the devices. slice_bytes lists the size of a
+        // slice in every buffer sub-buffers will be created from. halo is the
+        // number of slices needed on both sides of a range to compute it,
+        // buffers read with halos must be padded with as many slices at both
+        // ends.
+        void decompose(cl::size_type slices,
+                       const std::vector<cl::size_type>& slice_bytes,
+                       cl::size_type halo = 0);
+
+        // Sets new device weights and repeats the last decomposition.
+        void set_weights(const std::vector<double>& weights);
+
+        // Weights devices by throughput measured from one profiled event per
+        // part, for eg. the events returned by launch(), and repeats the last
+        // decomposition. Sub-buffers must be recreated afterwards.
+        void rebalance(const std::vector<cl::Event>& events);
+
+        // Sub-buffer holding the slices owned by a part.
+        cl::Buffer owned(std::size_t part, const cl::Buffer& buffer,
+                         cl::size_type slice_bytes,
+                         cl_mem_flags flags = 0) const;
+
+        // Sub-buffer holding the slices owned by a part and the halo slices
+        // on both sides of them from a padded buffer.
+        cl::Buffer with_halo(std::size_t part, const cl::Buffer& buffer,
+                             cl::size_type slice_bytes,
+                             cl_mem_flags flags = 0) const;
+
+        // Calls enqueue for every part owning slices and flushes the queues,
+        // so that devices start working concurrently. Returns the events
+        // returned by enqueue, parts without slices get an empty event.
+        std::vector<cl::Event> launch(
+            const std::function<cl::Event(std::size_t, Part&)>& enqueue);
+
+        // Waits for the non-empty events returned by launch().
+        static void join(const std::vector<cl::Event>& events);
+
+        const std::vector<Part>& parts() const { return parts_; }
+        cl::size_type halo() const { return halo_; }
+        cl::size_type granularity() const { return granularity_; }
+        // Largest CL_DEVICE_MEM_BASE_ADDR_ALIGN of the devices in bytes.
+        cl::size_type alignment() const { return align_bytes; }
+
+    private:
+        cl::Context context;
+        std::vector<Part> parts_;
+        cl::size_type align_bytes;
+        cl::size_type slices_;
+        cl::size_type halo_;
+        cl::size_type granularity_;
+
+        void split();
+        cl::Buffer sub_buffer(const cl::Buffer& buffer, cl::size_type origin,
+                              cl::size_type size, cl_mem_flags flags) const;
+    };
+}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+// OpenCL SDK includes
+#include "OpenCLSDKCpp_Export.h"
+
+// OpenCL includes
+#include <CL/opencl.hpp>
+
+// STL includes
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace cl {
+namespace sdk {
+    // Distributes a range among command queues in chunks. Every queue gets
+    // its next chunk when one of its chunks completes, chunks get smaller as
+    // the range runs out and are sized according to the throughput observed
+    // on each queue. Suits devices of unknown or varying speed, where a
+    // static split leaves the faster devices idle.
+    class SDKCPP_EXPORT DynamicScheduler {
+    public:
+        // Range [first, first + count) of the slowest varying dimension of
+        // the scheduled range, for eg. rows of a 2D range.
+        struct Chunk
+        {
+            cl::size_type first;
+            cl::size_type count;
+        };
+
+        struct Statistics
+        {
+            cl::size_type chunks;
+            cl::size_type items;
+            // device time spent on chunks if the queue has profiling
+            // enabled, otherwise host time from enqueue to completion
+            double seconds;
+            // items per second the chunk sizes are currently based on
+            double throughput;
+        };
+
+        // Chunk boundaries are multiples of granularity, for eg. to create
+        // aligned sub-buffers. Chunks have at least min_chunk items, except
+        // for the last one. depth is the number of chunks kept in flight on
+        // every queue, so that devices need not wait for the host between
+        // chunks.
+        DynamicScheduler(const std::vector<cl::CommandQueue>& queues,
+                         cl::size_type granularity = 1,
+                         cl::size_type min_chunk = 1, unsigned depth = 2);
+
+        // Calls enqueue for chunks covering [0, size) until the range is
+        // exhausted and waits for all of them. enqueue must return the event
+        // of the last command of the chunk. Throughput observed in previous
+        // runs is used to size the first chunks.
+        void run(cl::size_type size,
+                 const std::function<cl::Event(std::size_t, cl::CommandQueue&,
+                                               const Chunk&)>& enqueue);
+
+        // Statistics of the last run, one per queue.
+        const std::vector<Statistics>& statistics() const { return stats; }
+
+    private:
+        struct State;
+        struct CallbackData;
+        static void CL_CALLBACK on_complete(cl_event, cl_int status,
+                                            void* user_data);
+
+        std::vector<cl::CommandQueue> queues;
+        std::vector<bool> profiling;
+        cl::size_type granularity;
+        cl::size_type min_chunk;
+        unsigned depth;
+        std::vector<Statistics> stats;
+        std::shared_ptr<State> state;
+
+        cl::size_type chunk_size(std::size_t queue,
+                                 cl::size_type remaining) const;
+    };
+}
+}
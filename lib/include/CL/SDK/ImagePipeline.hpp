@@ -0,0 +1,92 @@
+#pragma once
+
+// OpenCL SDK includes
+#include "OpenCLSDKCpp_Export.h"
+
+// OpenCL includes
+#include <CL/opencl.hpp>
+
+// STL includes
+#include <string>
+#include <vector>
+
+namespace cl {
+namespace sdk {
+    class SDKCPP_EXPORT ImagePipeline {
+    public:
+        // A pass is a single kernel launch of the pipeline. Its name lists the
+        // stages it executes, joined by '+' if stages were fused.
+        struct Pass
+        {
+            std::string name;
+            cl::Event event;
+        };
+
+        ImagePipeline(const cl::Context& context, const cl::Device& device,
+                      const cl::CommandQueue& queue);
+
+        // Stage running an existing kernel, for eg. one of the blur kernels.
+        // The pipeline sets the input and output images as arguments 0 and 1,
+        // all other arguments must be set by the caller.
+        ImagePipeline& add_kernel(const std::string& name, cl::Kernel kernel);
+
+        // Stage computing every pixel from a neighbourhood of the input.
+        // source must define
+        //     float4 function(read_only image2d_t image, int2 coord)
+        // where the returned value is in the 0-255 range of the image.
+        ImagePipeline& add_stencil(const std::string& name,
+                                   const std::string& source,
+                                   const std::string& function);
+
+        // Stage computing every pixel from the same pixel of the input.
+        // source must define
+        //     float4 function(float4 pixel)
+        ImagePipeline& add_point(const std::string& name,
+                                 const std::string& source,
+                                 const std::string& function);
+
+        // Generates and compiles the kernels of stencil and point stages. If
+        // fuse is true, a stencil stage and the point stages following it
+        // (or consecutive point stages) are compiled into a single kernel,
+        // otherwise every stage gets a kernel of its own.
+        void build(bool fuse = true, const std::string& options = "");
+
+        // Enqueues all passes of the pipeline. Intermediate results are kept
+        // in device-side images of the same format as input. Returns a pass
+        // for every kernel launch, events may be used for profiling if the
+        // queue was created with profiling enabled.
+        std::vector<Pass> run(const cl::Image2D& input,
+                              const cl::Image2D& output);
+
+    private:
+        enum class StageType
+        {
+            Kernel,
+            Stencil,
+            Point
+        };
+        struct Stage
+        {
+            StageType type;
+            std::string name;
+            std::string source;
+            std::string function;
+            cl::Kernel kernel;
+        };
+        struct Group
+        {
+            std::string name;
+            cl::Kernel kernel;
+        };
+
+        cl::Context context;
+        cl::Device device;
+        cl::CommandQueue queue;
+        cl::Program program;
+
+        std::vector<Stage> stages;
+        std::vector<Group> groups;
+        cl::Image2D temp_images[2];
+    };
+}
+}
@@ -2,6 +2,7 @@
 
 // OpenCL SDK includes
 #include "OpenCLSDKCpp_Export.h"
+#include <CL/SDK/Options.hpp>
 
 // OpenCL Utils includes
 #include <CL/Utils/Error.hpp>
@@ -14,23 +15,54 @@
 #include <SFML/OpenGL.hpp>
 
 // STL includes
+#include <cstddef> // std::size_t
+#include <memory> // std::unique_ptr
 #include <type_traits>
+#include <utility> // std::pair
+#include <vector>
 
 namespace cl {
 namespace sdk {
-    class SDKCPP_EXPORT InteropWindow : public sf::Window {
+    // Holds the window instead of being one, so that headless runs never
+    // create an sf::Window, which needs a display.
+    class SDKCPP_EXPORT InteropWindow {
     public:
         using Style = std::underlying_type_t<decltype(sf::Style::Default)>;
 
+        // If headless is enabled, no window is opened and run() only updates
+        // the scene, on a context without OpenGL sharing, for eg. to measure
+        // the throughput of a simulation on a machine without a display.
         explicit InteropWindow(
             sf::VideoMode mode, const sf::String& title,
             Style style = sf::Style::Default,
             const sf::ContextSettings& settings = sf::ContextSettings{},
             cl_uint platform_id = 0, cl_uint device_id = 0,
-            cl_bitfield device_type = CL_DEVICE_TYPE_DEFAULT);
+            cl_bitfield device_type = CL_DEVICE_TYPE_DEFAULT,
+            const options::Headless& headless = options::Headless{ false, 0,
+                                                                   0 });
 
+        // Renders the scene, then updates it while presenting the frame,
+        // so that the device runs the simulation while display() waits for
+        // vsync. The title bar shows the frame rate and the milliseconds per
+        // frame spent in updateScene() and render(), and of those stalled
+        // waiting for the other API.
         void run();
 
+        // Size of the window, or of the video mode when headless
+        sf::Vector2u getSize() const;
+
+        // Closes the window, run() returns after the current frame. Does
+        // nothing when headless.
+        void close();
+
+        // Simulation steps a single updateScene() runs, 1 by default
+        void set_steps_per_frame(std::size_t steps);
+        std::size_t steps_per_frame() const { return steps_per_frame_; }
+
+        // Simulation steps run and seconds taken by the last headless run()
+        std::size_t headless_steps() const { return steps; }
+        double headless_seconds() const { return seconds; }
+
     protected:
         // Core functionality to be overriden
         virtual void initializeGL() = 0; // Function that initializes all OpenGL
@@ -38,19 +70,47 @@ namespace sdk {
         virtual void initializeCL() = 0; // Function that initializes all OpenCL
                                          // assets needed to draw a scene
         virtual void
-        updateScene() = 0; // Function that holds scene update guaranteed not to
-                           // conflict with drawing
+        updateScene() = 0; // Function that runs steps_per_frame() simulation
+                           // steps guaranteed not to conflict with drawing
         virtual void render() = 0; // Function that does the native rendering
         virtual void event(
             const sf::Event& e) = 0; // Function that handles render area resize
 
+        // Whether the scene is updated without a window. initializeGL(),
+        // render() and event() are not called, initializeCL() and
+        // updateScene() must use plain OpenCL memory objects instead of
+        // sharing OpenGL ones, and updateScene() must wait for its commands.
+        bool headless() const { return headless_opts.enabled; }
+
+        // Returns the events acquiring shared objects has to wait for, so
+        // that OpenGL commands issued so far complete first: that of a fence
+        // with cl_khr_gl_event, otherwise none after waiting with glFinish().
+        cl::vector<cl::Event> gl_fence();
+
+        // Waits for event, counted as stalled in the frame statistics.
+        void wait(const cl::Event& event);
+
         cl::Context opencl_context;
         bool cl_khr_gl_event_supported;
 
     private:
+        void run_headless();
+        void delete_fences(bool all);
+
         cl_uint plat_id;
         cl_uint dev_id;
         cl_bitfield dev_type;
+        options::Headless headless_opts;
+        sf::Vector2u headless_size;
+        std::size_t steps;
+        double seconds;
+
+        std::unique_ptr<sf::Window> window; // null when headless
+        sf::String title;
+        std::size_t steps_per_frame_;
+        double stalled; // milliseconds of the current call
+        // GL sync objects of gl_fence() and the events created from them
+        std::vector<std::pair<void*, cl::Event>> fences;
     };
 }
 }
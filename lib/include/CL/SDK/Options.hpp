@@ -3,6 +3,9 @@
 // OpenCL includes
 #include <CL/opencl.hpp>
 
+// STL includes
+#include <cstddef> // std::size_t
+
 namespace cl {
 namespace sdk {
     namespace options {
@@ -29,6 +32,13 @@ namespace sdk {
             int width;
             int height;
             bool fullscreen;
+            std::size_t steps_per_frame;
+        };
+        struct Headless
+        {
+            bool enabled;
+            std::size_t iterations; // scene updates, if seconds is zero
+            double seconds; // otherwise update the scene for this long
         };
     }
 }
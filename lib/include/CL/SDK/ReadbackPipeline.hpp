@@ -0,0 +1,100 @@
+#pragma once
+
+// OpenCL SDK includes
+#include "OpenCLSDKCpp_Export.h"
+
+// OpenCL Utils includes
+#include <CL/Utils/Staging.hpp>
+
+// OpenCL includes
+#include <CL/opencl.hpp>
+
+// STL includes
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace cl {
+namespace sdk {
+    // Reads frames of a fixed size back to the host and hands them to
+    // encoder threads, for eg. to write intermediate results of a simulation
+    // to disk. Device buffers and pinned host arrays are allocated once for a
+    // fixed number of slots and recycled. Completed reads are passed to the
+    // encoders through a bounded lock-free ring. When all slots are in use,
+    // submit() blocks until an encoder releases one.
+    class SDKCPP_EXPORT ReadbackPipeline {
+    public:
+        struct Frame
+        {
+            std::size_t index; // order of submission, starting from zero
+            const void* data; // valid until the encoder returns
+            cl::size_type size;
+        };
+
+        struct Statistics
+        {
+            std::size_t frames;
+            // time from the first submit() to the end of finish()
+            double seconds;
+            // time submit() waited for a free slot
+            double stall_seconds;
+            double frames_per_second;
+        };
+
+        using Encoder = std::function<void(const Frame&)>;
+
+        // Allocates slots device buffers of frame_bytes and as many pinned
+        // host arrays from a cl::util::StagingPool, and starts encoders
+        // threads calling encoder.
+        // Device->host reads are enqueued on read_queue.
+        ReadbackPipeline(const cl::Context& context,
+                         const cl::CommandQueue& read_queue,
+                         cl::size_type frame_bytes, Encoder encoder,
+                         std::size_t slots = 4, unsigned encoders = 2);
+
+        // Waits for the frames in flight and stops the encoders.
+        ~ReadbackPipeline();
+
+        ReadbackPipeline(const ReadbackPipeline&) = delete;
+        ReadbackPipeline& operator=(const ReadbackPipeline&) = delete;
+
+        // Acquires a free slot, waiting for one if necessary, and calls
+        // enqueue_copy with its device buffer. enqueue_copy must enqueue the
+        // copy of a frame to the buffer and return its event. The read of the
+        // buffer is enqueued after it. Returns the event of the copy, so that
+        // commands overwriting the source of the frame may wait for it.
+        cl::Event submit(
+            const std::function<cl::Event(const cl::Buffer&)>& enqueue_copy);
+
+        // Waits until every submitted frame has been encoded. Rethrows the
+        // first exception of an encoder and reports failed reads.
+        void finish();
+
+        Statistics statistics() const;
+
+    private:
+        struct Slot
+        {
+            cl::Buffer device;
+            cl::util::StagingPool::Block host;
+            std::size_t frame;
+        };
+        struct State;
+        struct CallbackData;
+        static void CL_CALLBACK on_read(cl_event, cl_int status,
+                                        void* user_data);
+
+        cl::Context context;
+        cl::CommandQueue read_queue;
+        cl::size_type frame_bytes;
+        Encoder encoder;
+        cl::util::StagingPool staging;
+        std::vector<Slot> slots;
+        std::shared_ptr<State> state;
+        std::vector<std::thread> workers;
+
+        void encode();
+    };
+}
+}
@@ -6,6 +6,14 @@
 
 #include <CL/SDK/CLI.hpp>
 #include <CL/SDK/Image.hpp>
+#include <CL/SDK/Blas.hpp>
+#include <CL/SDK/Checkpoint.hpp>
+#include <CL/SDK/CommandBuffer.hpp>
+#include <CL/SDK/DomainDecomposition.hpp>
+#include <CL/SDK/DynamicScheduler.hpp>
+#include <CL/SDK/ImagePipeline.hpp>
+#include <CL/SDK/ReadbackPipeline.hpp>
+#include <CL/SDK/SVM.hpp>
 #ifdef OPENCL_SDK_BUILD_OPENGL_SAMPLES
 #include <CL/SDK/InteropContext.hpp>
 #include <CL/SDK/InteropWindow.hpp>
@@ -0,0 +1,152 @@
+#pragma once
+
+// OpenCL Utils includes
+#include <CL/Utils/Arena.hpp> // cl::util::SVMArena::supported
+#include <CL/Utils/Error.hpp>
+
+// OpenCL includes
+#include <CL/opencl.hpp>
+
+// STL includes
+#include <cstddef> // std::size_t
+#include <type_traits>
+#include <utility> // std::swap
+
+#if defined(CL_VERSION_2_0) && CL_HPP_TARGET_OPENCL_VERSION >= 200
+namespace cl {
+namespace sdk {
+    enum class SVMGrain
+    {
+        None,
+        Coarse,
+        Fine
+    };
+
+    // Finest granularity of SVM buffers every device of the context supports.
+    inline SVMGrain svm_grain(const cl::Context& context)
+    {
+        if (cl::util::SVMArena::supported(
+                context, CL_MEM_READ_WRITE | CL_MEM_SVM_FINE_GRAIN_BUFFER))
+            return SVMGrain::Fine;
+        else if (cl::util::SVMArena::supported(context, CL_MEM_READ_WRITE))
+            return SVMGrain::Coarse;
+        else
+            return SVMGrain::None;
+    }
+
+    // Fixed size array in shared virtual memory. Kernels take data() as a
+    // pointer argument, for eg. through cl::KernelFunctor<T*, ...>, and the
+    // host accesses the same memory through iterators, so neither side
+    // copies. Coarse-grained memory must be mapped while the host accesses
+    // it, map() and unmap() do nothing for fine-grained memory.
+    template <typename T> class SVMVector {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "SVMVector elements are shared with kernels, they must "
+                      "be trivially copyable.");
+
+    public:
+        using value_type = T;
+        using size_type = std::size_t;
+        using iterator = T*;
+        using const_iterator = const T*;
+
+        SVMVector() = default;
+
+        // Allocates size uninitialized elements with the finest granularity
+        // supported by the context.
+        SVMVector(const cl::Context& context, size_type size)
+            : SVMVector(context, size, svm_grain(context))
+        {}
+
+        // Empty if the allocation fails with exceptions disabled.
+        SVMVector(const cl::Context& context, size_type size, SVMGrain grain)
+            : context{ context }, count{ size }, granularity{ grain }
+        {
+            if (grain == SVMGrain::None)
+            {
+                count = 0;
+                cl::util::detail::errHandler(
+                    CL_INVALID_OPERATION, nullptr,
+                    "Devices of the context do not support SVM buffers.");
+                return;
+            }
+
+            const cl_svm_mem_flags flags = grain == SVMGrain::Fine
+                ? CL_MEM_READ_WRITE | CL_MEM_SVM_FINE_GRAIN_BUFFER
+                : CL_MEM_READ_WRITE;
+            pointer = static_cast<T*>(
+                clSVMAlloc(context(), flags, size * sizeof(T), 0));
+            if (pointer == nullptr)
+            {
+                count = 0;
+                cl::util::detail::errHandler(CL_MEM_OBJECT_ALLOCATION_FAILURE,
+                                             nullptr,
+                                             "Failed to allocate SVMVector.");
+            }
+        }
+
+        SVMVector(SVMVector&& other) noexcept { swap(other); }
+        SVMVector& operator=(SVMVector&& other) noexcept
+        {
+            SVMVector{ std::move(other) }.swap(*this);
+            return *this;
+        }
+
+        // Commands using the memory must have completed.
+        ~SVMVector()
+        {
+            if (pointer != nullptr) clSVMFree(context(), pointer);
+        }
+
+        void swap(SVMVector& other) noexcept
+        {
+            std::swap(context, other.context);
+            std::swap(pointer, other.pointer);
+            std::swap(count, other.count);
+            std::swap(granularity, other.granularity);
+            std::swap(mapped, other.mapped);
+        }
+
+        // Makes coarse-grained memory accessible to the host, blocking until
+        // commands enqueued before on queue complete.
+        void map(const cl::CommandQueue& queue,
+                 cl_map_flags flags = CL_MAP_READ | CL_MAP_WRITE)
+        {
+            if (granularity != SVMGrain::Coarse || mapped) return;
+            queue.enqueueMapSVM(pointer, CL_TRUE, flags, count * sizeof(T));
+            mapped = true;
+        }
+
+        // Makes coarse-grained memory accessible to kernels enqueued after
+        // on queue.
+        void unmap(const cl::CommandQueue& queue)
+        {
+            if (!mapped) return;
+            queue.enqueueUnmapSVM(pointer);
+            mapped = false;
+        }
+
+        T* data() { return pointer; }
+        const T* data() const { return pointer; }
+        size_type size() const { return count; }
+        bool empty() const { return count == 0; }
+        SVMGrain grain() const { return granularity; }
+
+        iterator begin() { return pointer; }
+        iterator end() { return pointer + count; }
+        const_iterator begin() const { return pointer; }
+        const_iterator end() const { return pointer + count; }
+
+        T& operator[](size_type i) { return pointer[i]; }
+        const T& operator[](size_type i) const { return pointer[i]; }
+
+    private:
+        cl::Context context;
+        T* pointer = nullptr;
+        size_type count = 0;
+        SVMGrain granularity = SVMGrain::None;
+        bool mapped = false;
+    };
+}
+}
+#endif
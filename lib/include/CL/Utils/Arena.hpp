@@ -0,0 +1,114 @@
+#pragma once
+
+#include "OpenCLUtilsCpp_Export.h"
+#include <CL/Utils/Error.hpp>
+
+#include <CL/opencl.hpp>
+
+// STL includes
+#include <vector>
+
+namespace cl {
+namespace util {
+    struct ArenaStatistics
+    {
+        cl::size_type capacity; // bytes of all backing allocations
+        cl::size_type in_use; // bytes allocated since the last reset
+        cl::size_type high_water; // largest value in_use has reached
+        cl::size_type allocations; // allocations since the last reset
+        cl::size_type resets;
+        // estimate of the sub-buffers still referenced by the application at
+        // reset, summed over all resets, see BufferArena::reset()
+        cl::size_type leaks;
+    };
+
+    // Allocates sub-buffers from a few large buffers, so that creating
+    // short-lived buffers does not involve the driver's allocator. Memory is
+    // not freed individually, but all at once by reset(), for eg. at the end
+    // of every frame of a simulation. Not thread-safe.
+    class UTILSCPP_EXPORT BufferArena {
+    public:
+        // Backing buffers are block_size bytes large unless an allocation
+        // needs more. flags apply to the backing buffers and are inherited
+        // by the sub-buffers.
+        BufferArena(const cl::Context& context,
+                    cl::size_type block_size = 64 * 1024 * 1024,
+                    cl_mem_flags flags = CL_MEM_READ_WRITE);
+
+        // Returns a sub-buffer of size bytes at an offset satisfying
+        // CL_DEVICE_MEM_BASE_ADDR_ALIGN of all devices of the context.
+        cl::Buffer allocate(cl::size_type size, cl_int* error = nullptr);
+
+        // Makes all memory available again. Commands using sub-buffers must
+        // have completed, and sub-buffers should no longer be referenced.
+        // Backing buffers are kept.
+        void reset();
+
+        const ArenaStatistics& statistics() const { return stats; }
+        // Alignment of allocations in bytes.
+        cl::size_type alignment() const { return align_bytes; }
+
+    private:
+        cl::Context context;
+        cl::size_type block_size;
+        cl_mem_flags flags;
+        cl::size_type align_bytes;
+        std::vector<cl::Buffer> blocks;
+        std::vector<cl::size_type> block_sizes;
+        std::size_t current; // block allocations are carved from
+        cl::size_type offset; // first free byte of the current block
+        std::vector<cl::Buffer> live;
+        ArenaStatistics stats;
+    };
+
+#ifdef CL_VERSION_2_0
+    // Allocates shared virtual memory from a few large SVM allocations in
+    // the same way as BufferArena.
+    class UTILSCPP_EXPORT SVMArena {
+    public:
+        // flags are passed to clSVMAlloc, for eg. CL_MEM_SVM_FINE_GRAIN_BUFFER
+        // if supported by all devices of the context.
+        SVMArena(const cl::Context& context,
+                 cl::size_type block_size = 64 * 1024 * 1024,
+                 cl_svm_mem_flags flags = CL_MEM_READ_WRITE,
+                 cl_int* error = nullptr);
+        ~SVMArena();
+
+        SVMArena(const SVMArena&) = delete;
+        SVMArena& operator=(const SVMArena&) = delete;
+
+        // Tells whether every device of the context supports SVM allocations
+        // with flags.
+        static bool supported(const cl::Context& context,
+                              cl_svm_mem_flags flags = CL_MEM_READ_WRITE);
+
+        void* allocate(cl::size_type size, cl_int* error = nullptr);
+        template <typename T>
+        T* allocate(cl::size_type count, cl_int* error = nullptr)
+        {
+            return static_cast<T*>(allocate(count * sizeof(T), error));
+        }
+
+        // Makes all memory available again. Commands using the memory must
+        // have completed.
+        void reset();
+
+        const ArenaStatistics& statistics() const { return stats; }
+        // Alignment of allocations in bytes, that of the largest OpenCL C
+        // data type.
+        cl::size_type alignment() const { return align_bytes; }
+
+    private:
+        cl::Context context;
+        cl::size_type block_size;
+        cl_svm_mem_flags flags;
+        cl::size_type align_bytes;
+        std::vector<char*> blocks;
+        std::vector<cl::size_type> block_sizes;
+        std::size_t current;
+        cl::size_type offset;
+        ArenaStatistics stats;
+    };
+#endif
+}
+}
@@ -5,6 +5,9 @@
 
 #include <CL/opencl.hpp>
 
+// STL includes
+#include <vector>
+
 namespace cl {
 namespace util {
     bool UTILSCPP_EXPORT opencl_c_version_contains(
@@ -17,5 +20,42 @@ namespace util {
     bool UTILSCPP_EXPORT supports_feature(const cl::Device& device,
                                           const cl::string& feature_name);
 #endif
+
+#ifdef CL_VERSION_1_2
+    struct UTILSCPP_EXPORT Partition
+    {
+        cl::vector<cl::Device> sub_devices;
+        // CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN, CL_DEVICE_PARTITION_EQUALLY
+        // or CL_DEVICE_PARTITION_BY_COUNTS
+        cl_device_partition_property scheme;
+        // Domain the device was partitioned by, 0 for other schemes
+        cl_device_affinity_domain affinity_domain;
+        // Suggested share of the data per sub-device, proportional to its
+        // compute units
+        std::vector<double> weights;
+
+        // Splits size elements according to weights into ranges with
+        // boundaries that are multiples of granularity. Returns the
+        // sub_devices.size() + 1 boundaries of the ranges.
+        std::vector<cl::size_type> split(cl::size_type size,
+                                         cl::size_type granularity = 1) const;
+    };
+
+    // Partitions a device such that sub-devices share as much of the memory
+    // hierarchy as possible. Partitions by NUMA node or L3 cache if that
+    // yields more than one sub-device, otherwise equally or by counts into
+    // fallback_count sub-devices.
+    Partition UTILSCPP_EXPORT partition_device(const cl::Device& device,
+                                               cl_uint fallback_count = 2,
+                                               cl_int* error = nullptr);
+
+    // Fills the range [boundaries[i], boundaries[i + 1]) bytes of buffer with
+    // zeros on queues[i] and waits for them. CPU devices typically place the
+    // pages of a buffer on the NUMA node first writing them, so buffers
+    // should not have been written before, for eg. by CL_MEM_COPY_HOST_PTR.
+    void UTILSCPP_EXPORT first_touch(
+        const cl::Buffer& buffer, const std::vector<cl::CommandQueue>& queues,
+        const std::vector<cl::size_type>& boundaries, cl_int* error = nullptr);
+#endif
 }
 }
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "OpenCLUtilsCpp_Export.h"
+#include <CL/Utils/Error.hpp>
+
+#include <CL/opencl.hpp>
+
+// STL includes
+#include <functional>
+#include <map>
+#include <vector>
+
+namespace cl {
+namespace util {
+    // Runs commands of a device on several in-order queues, or on one
+    // out-of-order queue, so that independent commands may overlap, for eg.
+    // copies with kernels. Dependencies are derived from the memory objects
+    // every command reads and writes, and passed to the command as a wait
+    // list. Not thread-safe.
+    class UTILSCPP_EXPORT QueuePool {
+    public:
+        enum class Mode
+        {
+            InOrder,
+            OutOfOrder
+        };
+
+        // Receives the queue a command is to be enqueued on and the events it
+        // must wait for. Returns the event of the command.
+        using Enqueue = std::function<cl::Event(
+            cl::CommandQueue& queue, const std::vector<cl::Event>& wait)>;
+
+        // In-order mode creates count queues. Out-of-order mode creates a
+        // single queue and falls back to in-order mode if the device does not
+        // support out-of-order queues. properties are added to those of every
+        // queue, for eg. CL_QUEUE_PROFILING_ENABLE.
+        QueuePool(const cl::Context& context, const cl::Device& device,
+                  Mode mode = Mode::InOrder, std::size_t count = 2,
+                  cl_command_queue_properties properties = 0);
+
+        // Enqueues a command reading reads and writing writes. A command
+        // waits for the last command writing any memory object it accesses,
+        // and commands writing a memory object also wait for the commands
+        // reading it since. Memory objects are told apart by handle,
+        // overlapping sub-buffers of the same buffer are not detected.
+        cl::Event submit(const std::vector<cl::Memory>& reads,
+                         const std::vector<cl::Memory>& writes,
+                         const Enqueue& enqueue, cl_int* error = nullptr);
+
+        void flush();
+        // Waits for all commands and forgets the dependencies.
+        void finish();
+
+        Mode mode() const { return mode_; }
+        const std::vector<cl::CommandQueue>& queues() const { return queues_; }
+
+    private:
+        struct Use
+        {
+            cl::Event event;
+            std::size_t queue;
+        };
+        struct Access
+        {
+            Use write;
+            std::vector<Use> reads;
+        };
+
+        std::vector<cl::CommandQueue> queues_;
+        Mode mode_;
+        std::size_t next;
+        std::map<cl_mem, Access> accesses;
+    };
+}
+}
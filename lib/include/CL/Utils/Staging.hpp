@@ -0,0 +1,104 @@
+#pragma once
+
+#include "OpenCLUtilsCpp_Export.h"
+#include <CL/Utils/Error.hpp>
+
+#include <CL/opencl.hpp>
+
+// STL includes
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace cl {
+namespace util {
+    // Hands out host memory for transfers from CL_MEM_ALLOC_HOST_PTR
+    // buffers, which most implementations back with pinned memory the device
+    // may access directly. Buffers stay mapped for their whole lifetime and
+    // are recycled by size class, so acquiring memory for a transfer neither
+    // allocates nor maps after the pool has warmed up.
+    class UTILSCPP_EXPORT StagingPool {
+        struct Entry
+        {
+            cl::Buffer buffer;
+            void* data;
+            cl::size_type size;
+            cl::Event fence;
+        };
+        using EntryList = std::vector<std::unique_ptr<Entry>>;
+
+    public:
+        struct Statistics
+        {
+            cl::size_type allocations; // buffers created
+            cl::size_type reuses; // blocks served from a free buffer
+            cl::size_type bytes; // bytes of all buffers currently held
+            cl::size_type high_water; // largest value bytes has reached
+        };
+
+        // Host memory acquired from a pool, returned to it on destruction.
+        class UTILSCPP_EXPORT Block {
+        public:
+            Block() = default;
+            Block(Block&& other) noexcept;
+            Block& operator=(Block&& other) noexcept;
+            ~Block();
+
+            void* data() const { return entry ? entry->data : nullptr; }
+            template <typename T> T* as() const
+            {
+                return static_cast<T*>(data());
+            }
+            // Size of the size class, at least the size requested.
+            cl::size_type size() const { return entry ? entry->size : 0; }
+            explicit operator bool() const { return entry != nullptr; }
+
+            // The block is not handed out again until event completes. Use
+            // with the event of the last non-blocking transfer using data().
+            void fence(const cl::Event& event);
+
+            // Returns the block to the pool early.
+            void release();
+
+        private:
+            friend class StagingPool;
+            Block(StagingPool* pool, std::unique_ptr<Entry> entry);
+
+            StagingPool* pool = nullptr;
+            std::unique_ptr<Entry> entry;
+        };
+
+        // Buffers are mapped and unmapped on queue.
+        StagingPool(const cl::Context& context, const cl::CommandQueue& queue);
+
+        // Blocks must be released before the pool is destroyed.
+        ~StagingPool();
+
+        StagingPool(const StagingPool&) = delete;
+        StagingPool& operator=(const StagingPool&) = delete;
+
+        // Returns host memory of at least size bytes. Safe to call from
+        // several threads.
+        Block acquire(cl::size_type size, cl_int* error = nullptr);
+
+        // Unmaps and releases buffers not in use.
+        void trim();
+
+        Statistics statistics() const;
+
+        // Power of two size class a request of size bytes is served from.
+        static cl::size_type size_class(cl::size_type size);
+
+    private:
+        cl::Context context;
+        cl::CommandQueue queue;
+        mutable std::mutex mutex;
+        std::map<cl::size_type, EntryList> free_blocks;
+        Statistics stats;
+
+        void recycle(std::unique_ptr<Entry> entry);
+        void unmap(EntryList& entries);
+    };
+}
+}
@@ -10,6 +10,9 @@
 #include <CL/Utils/Context.hpp>
 #include <CL/Utils/Event.hpp>
 #include <CL/Utils/File.hpp>
+#include <CL/Utils/Staging.hpp>
+#include <CL/Utils/Arena.hpp>
+#include <CL/Utils/QueuePool.hpp>
 
 // OpenCL includes
 #include <CL/opencl.hpp>
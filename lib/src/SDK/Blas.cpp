@@ -0,0 +1,303 @@
+// OpenCL SDK includes
+#include <CL/SDK/Blas.hpp>
+
+// OpenCL Utils includes
+#include <CL/Utils/Error.hpp>
+
+// STL includes
+#include <algorithm> // std::min, std::max
+#include <cmath> // std::sqrt
+#include <string> // std::to_string
+
+namespace {
+// Compiled with VEC, the number of floats loaded at once. Kernels cast the
+// buffers to floats for the last n % VEC elements.
+const char* blas_source = R"(
+#define CAT(a, b) a##b
+#define XCAT(a, b) CAT(a, b)
+#if VEC == 1
+typedef float floatn;
+#else
+typedef XCAT(float, VEC) floatn;
+#endif
+
+float sum_lanes(floatn v)
+{
+#if VEC == 16
+    float8 v8 = v.lo + v.hi;
+#elif VEC == 8
+    float8 v8 = v;
+#endif
+#if VEC >= 8
+    float4 v4 = v8.lo + v8.hi;
+#elif VEC == 4
+    float4 v4 = v;
+#endif
+#if VEC >= 4
+    float2 v2 = v4.lo + v4.hi;
+#elif VEC == 2
+    float2 v2 = v;
+#endif
+#if VEC >= 2
+    return v2.x + v2.y;
+#else
+    return v;
+#endif
+}
+
+// Sums sum over the work-group, whose size is a power of two, to the
+// partial result of the work-group.
+void reduce(float sum, local float* scratch, global float* partials)
+{
+    const uint lid = get_local_id(0);
+    scratch[lid] = sum;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    for (uint s = get_local_size(0) / 2; s > 0; s /= 2)
+    {
+        if (lid < s) scratch[lid] += scratch[lid + s];
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    if (lid == 0) partials[get_group_id(0)] = scratch[0];
+}
+
+kernel void blas_axpby(float alpha, global const floatn* x, float beta,
+                       global floatn* y, uint n)
+{
+    const uint vectors = n / VEC;
+    for (uint i = get_global_id(0); i < vectors; i += get_global_size(0))
+        y[i] = alpha * x[i] + beta * y[i];
+
+    global const float* xs = (global const float*)x;
+    global float* ys = (global float*)y;
+    for (uint i = vectors * VEC + get_global_id(0); i < n;
+         i += get_global_size(0))
+        ys[i] = alpha * xs[i] + beta * ys[i];
+}
+
+kernel void blas_scal(float alpha, global floatn* x, uint n)
+{
+    const uint vectors = n / VEC;
+    for (uint i = get_global_id(0); i < vectors; i += get_global_size(0))
+        x[i] *= alpha;
+
+    global float* xs = (global float*)x;
+    for (uint i = vectors * VEC + get_global_id(0); i < n;
+         i += get_global_size(0))
+        xs[i] *= alpha;
+}
+
+kernel void blas_dot(global const floatn* x, global const floatn* y, uint n,
+                     local float* scratch, global float* partials)
+{
+    const uint vectors = n / VEC;
+    floatn acc = (floatn)(0.f);
+    for (uint i = get_global_id(0); i < vectors; i += get_global_size(0))
+        acc += x[i] * y[i];
+    float sum = sum_lanes(acc);
+
+    global const float* xs = (global const float*)x;
+    global const float* ys = (global const float*)y;
+    for (uint i = vectors * VEC + get_global_id(0); i < n;
+         i += get_global_size(0))
+        sum += xs[i] * ys[i];
+    reduce(sum, scratch, partials);
+}
+
+kernel void blas_asum(global const floatn* x, uint n, local float* scratch,
+                      global float* partials)
+{
+    const uint vectors = n / VEC;
+    floatn acc = (floatn)(0.f);
+    for (uint i = get_global_id(0); i < vectors; i += get_global_size(0))
+        acc += fabs(x[i]);
+    float sum = sum_lanes(acc);
+
+    global const float* xs = (global const float*)x;
+    for (uint i = vectors * VEC + get_global_id(0); i < n;
+         i += get_global_size(0))
+        sum += fabs(xs[i]);
+    reduce(sum, scratch, partials);
+}
+
+// z is read after y is written, so that z may be y.
+kernel void blas_axpby_dot(float alpha, global const floatn* x, float beta,
+                           global floatn* y, global const floatn* z, uint n,
+                           local float* scratch, global float* partials)
+{
+    const uint vectors = n / VEC;
+    floatn acc = (floatn)(0.f);
+    for (uint i = get_global_id(0); i < vectors; i += get_global_size(0))
+    {
+        floatn result = alpha * x[i] + beta * y[i];
+        y[i] = result;
+        acc += result * z[i];
+    }
+    float sum = sum_lanes(acc);
+
+    global const float* xs = (global const float*)x;
+    global float* ys = (global float*)y;
+    global const float* zs = (global const float*)z;
+    for (uint i = vectors * VEC + get_global_id(0); i < n;
+         i += get_global_size(0))
+    {
+        float result = alpha * xs[i] + beta * ys[i];
+        ys[i] = result;
+        sum += result * zs[i];
+    }
+    reduce(sum, scratch, partials);
+}
+)";
+}
+
+cl::sdk::Blas::Blas(const cl::Context& context, const cl::Device& device,
+                    const cl::CommandQueue& queue, cl_uint vector_width)
+    : queue{ queue }, width{ vector_width }
+{
+    if (width == 0)
+        width = device.getInfo<CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT>();
+    // Some devices report 0 or widths without a vector type.
+    if (width == 0 || width > 16 || (width & (width - 1)) != 0) width = 1;
+
+    cl::Program program{ context, blas_source };
+    program.build(device, ("-DVEC=" + std::to_string(width)).c_str());
+    axpby_kernel = cl::Kernel{ program, "blas_axpby" };
+    scal_kernel = cl::Kernel{ program, "blas_scal" };
+    dot_kernel = cl::Kernel{ program, "blas_dot" };
+    asum_kernel = cl::Kernel{ program, "blas_asum" };
+    axpby_dot_kernel = cl::Kernel{ program, "blas_axpby_dot" };
+
+    // The largest power of two up to 256 every kernel may be launched with,
+    // as the reductions need a power of two.
+    cl::size_type max_local = 256;
+    for (const auto& kernel : { axpby_kernel, scal_kernel, dot_kernel,
+                                asum_kernel, axpby_dot_kernel })
+        max_local = std::min(
+            max_local,
+            kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device));
+    local_size = 1;
+    while (local_size * 2 <= max_local) local_size *= 2;
+
+    // A few work-groups per compute unit hide the latency of memory.
+    max_groups = 4 * device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+    partials = cl::Buffer{ context, CL_MEM_READ_WRITE,
+                           max_groups * sizeof(cl_float) };
+    host_partials.resize(max_groups);
+
+    // The grid-stride loops of the kernels add the global size to indices
+    // below n, which must not exceed CL_UINT_MAX.
+    max_length = CL_UINT_MAX - max_groups * local_size * width;
+}
+
+cl::size_type cl::sdk::Blas::groups(cl::size_type n) const
+{
+    const cl::size_type vectors = n / width;
+    return std::max<cl::size_type>(
+        1, std::min(max_groups, (vectors + local_size - 1) / local_size));
+}
+
+bool cl::sdk::Blas::check_length(cl::size_type n, const char* message) const
+{
+    if (n <= max_length) return true;
+    cl::util::detail::errHandler(CL_INVALID_VALUE, nullptr, message);
+    return false;
+}
+
+cl::Event cl::sdk::Blas::launch(cl::Kernel& kernel, cl::size_type n)
+{
+    cl::Event event;
+    queue.enqueueNDRangeKernel(kernel, cl::NullRange,
+                               cl::NDRange{ groups(n) * local_size },
+                               cl::NDRange{ local_size }, nullptr, &event);
+    return event;
+}
+
+cl_float cl::sdk::Blas::reduce(cl::Kernel& kernel, cl::size_type n)
+{
+    const cl::size_type count = groups(n);
+    queue.enqueueNDRangeKernel(kernel, cl::NullRange,
+                               cl::NDRange{ count * local_size },
+                               cl::NDRange{ local_size });
+    queue.enqueueReadBuffer(partials, CL_TRUE, 0, count * sizeof(cl_float),
+                            host_partials.data());
+
+    double sum = 0;
+    for (cl::size_type i = 0; i < count; ++i) sum += host_partials[i];
+    return static_cast<cl_float>(sum);
+}
+
+cl::Event cl::sdk::Blas::axpy(cl_float alpha, const cl::Buffer& x,
+                              const cl::Buffer& y, cl::size_type n)
+{
+    return axpby(alpha, x, 1.f, y, n);
+}
+
+cl::Event cl::sdk::Blas::axpby(cl_float alpha, const cl::Buffer& x,
+                               cl_float beta, const cl::Buffer& y,
+                               cl::size_type n)
+{
+    if (!check_length(n, "Vector too long in cl::sdk::Blas::axpby()"))
+        return cl::Event{};
+    axpby_kernel.setArg(0, alpha);
+    axpby_kernel.setArg(1, x);
+    axpby_kernel.setArg(2, beta);
+    axpby_kernel.setArg(3, y);
+    axpby_kernel.setArg(4, static_cast<cl_uint>(n));
+    return launch(axpby_kernel, n);
+}
+
+cl::Event cl::sdk::Blas::scal(cl_float alpha, const cl::Buffer& x,
+                              cl::size_type n)
+{
+    if (!check_length(n, "Vector too long in cl::sdk::Blas::scal()"))
+        return cl::Event{};
+    scal_kernel.setArg(0, alpha);
+    scal_kernel.setArg(1, x);
+    scal_kernel.setArg(2, static_cast<cl_uint>(n));
+    return launch(scal_kernel, n);
+}
+
+cl_float cl::sdk::Blas::dot(const cl::Buffer& x, const cl::Buffer& y,
+                            cl::size_type n)
+{
+    if (!check_length(n, "Vector too long in cl::sdk::Blas::dot()"))
+        return 0.f;
+    dot_kernel.setArg(0, x);
+    dot_kernel.setArg(1, y);
+    dot_kernel.setArg(2, static_cast<cl_uint>(n));
+    dot_kernel.setArg(3, cl::Local(local_size * sizeof(cl_float)));
+    dot_kernel.setArg(4, partials);
+    return reduce(dot_kernel, n);
+}
+
+cl_float cl::sdk::Blas::nrm2(const cl::Buffer& x, cl::size_type n)
+{
+    return std::sqrt(dot(x, x, n));
+}
+
+cl_float cl::sdk::Blas::asum(const cl::Buffer& x, cl::size_type n)
+{
+    if (!check_length(n, "Vector too long in cl::sdk::Blas::asum()"))
+        return 0.f;
+    asum_kernel.setArg(0, x);
+    asum_kernel.setArg(1, static_cast<cl_uint>(n));
+    asum_kernel.setArg(2, cl::Local(local_size * sizeof(cl_float)));
+    asum_kernel.setArg(3, partials);
+    return reduce(asum_kernel, n);
+}
+
+cl_float cl::sdk::Blas::axpby_dot(cl_float alpha, const cl::Buffer& x,
+                                  cl_float beta, const cl::Buffer& y,
+                                  const cl::Buffer& z, cl::size_type n)
+{
+    if (!check_length(n, "Vector too long in cl::sdk::Blas::axpby_dot()"))
+        return 0.f;
+    axpby_dot_kernel.setArg(0, alpha);
+    axpby_dot_kernel.setArg(1, x);
+    axpby_dot_kernel.setArg(2, beta);
+    axpby_dot_kernel.setArg(3, y);
+    axpby_dot_kernel.setArg(4, z);
+    axpby_dot_kernel.setArg(5, static_cast<cl_uint>(n));
+    axpby_dot_kernel.setArg(6, cl::Local(local_size * sizeof(cl_float)));
+    axpby_dot_kernel.setArg(7, partials);
+    return reduce(axpby_dot_kernel, n);
+}
@@ -0,0 +1,424 @@
+// OpenCL SDK includes
+#include <CL/SDK/Checkpoint.hpp>
+
+// OpenCL Utils includes
+#include <CL/Utils/Error.hpp>
+#include <CL/Utils/ErrorCodes.h>
+
+// STL includes
+#include <algorithm> // std::min, std::copy, std::equal
+#include <cstdio> // std::rename, std::remove
+#include <cstring> // std::memcpy
+#include <fstream>
+#include <iterator> // std::istreambuf_iterator
+#include <type_traits> // std::remove_reference_t
+
+// File layout, integers little-endian:
+//   char[8] magic "CLSDKCKP"
+//   u32 version, u32 number of sections, u64 step
+//   every section:
+//     u32 length of the name, the name
+//     u32 compression, u64 size, u64 stored size
+//     u64 FNV-1a hash of the uncompressed bytes
+//     stored size bytes
+namespace {
+const char checkpoint_magic[8] = { 'C', 'L', 'S', 'D', 'K', 'C', 'K', 'P' };
+const std::uint32_t checkpoint_version = 1;
+
+struct SectionView
+{
+    const std::string& name;
+    const unsigned char* data;
+    std::uint64_t size;
+};
+
+std::uint64_t fnv1a(const unsigned char* data, std::uint64_t size)
+{
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    for (std::uint64_t i = 0; i < size; ++i)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+template <typename T> void put(std::vector<unsigned char>& out, T value)
+{
+    for (std::size_t i = 0; i < sizeof(T); ++i)
+        out.push_back(static_cast<unsigned char>(value >> (8 * i)));
+}
+
+std::uint32_t read32(const unsigned char* p)
+{
+    std::uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// Lengths of 15 or more continue in bytes of 255 and a last smaller one.
+void put_length(std::vector<unsigned char>& out, std::size_t length)
+{
+    for (; length >= 255; length -= 255) out.push_back(255);
+    out.push_back(static_cast<unsigned char>(length));
+}
+
+// Compresses to the LZ4 block format: sequences of a token with the lengths,
+// literals copied as they are, the 16-bit offset of a match of at least 4
+// bytes and the rest of its length. Matches are found greedily through a
+// table of the last position of every hashed 4 bytes.
+std::vector<unsigned char> lz_compress(const unsigned char* src,
+                                       std::size_t size)
+{
+    std::vector<unsigned char> out;
+    out.reserve(size / 2);
+    auto emit = [&](std::size_t anchor, std::size_t literals,
+                    std::size_t offset, std::size_t match) {
+        const std::size_t match_token = match != 0 ? match - 4 : 0;
+        out.push_back(static_cast<unsigned char>(
+            (std::min<std::size_t>(literals, 15) << 4)
+            | std::min<std::size_t>(match_token, 15)));
+        if (literals >= 15) put_length(out, literals - 15);
+        out.insert(out.end(), src + anchor, src + anchor + literals);
+        if (match == 0) return; // the last sequence has no match
+        out.push_back(static_cast<unsigned char>(offset));
+        out.push_back(static_cast<unsigned char>(offset >> 8));
+        if (match_token >= 15) put_length(out, match_token - 15);
+    };
+
+    // The format ends with at least 5 literals, and the last match starts
+    // at least 12 bytes before the end.
+    std::size_t anchor = 0;
+    if (size > 12)
+    {
+        const int hash_bits = 16;
+        std::vector<std::size_t> table(std::size_t{ 1 } << hash_bits, 0);
+        const std::size_t match_limit = size - 12, end_limit = size - 5;
+        for (std::size_t i = 0; i < match_limit;)
+        {
+            const std::uint32_t sequence = read32(src + i);
+            const std::size_t hash =
+                (sequence * 2654435761u) >> (32 - hash_bits);
+            const std::size_t candidate = table[hash]; // position + 1
+            table[hash] = i + 1;
+            if (candidate == 0 || i + 1 - candidate > 65535
+                || read32(src + candidate - 1) != sequence)
+            {
+                ++i;
+                continue;
+            }
+
+            const std::size_t match = candidate - 1;
+            std::size_t length = 4;
+            while (i + length < end_limit
+                   && src[match + length] == src[i + length])
+                ++length;
+            emit(anchor, i - anchor, i - match, length);
+            i += length;
+            anchor = i;
+        }
+    }
+    emit(anchor, size - anchor, 0, 0);
+    return out;
+}
+
+bool lz_decompress(const unsigned char* src, std::size_t size,
+                   unsigned char* dst, std::size_t dst_size)
+{
+    auto get_length = [&](std::size_t& i, std::size_t& length) {
+        unsigned char byte;
+        do
+        {
+            if (i >= size) return false;
+            byte = src[i++];
+            length += byte;
+        } while (byte == 255);
+        return true;
+    };
+
+    std::size_t i = 0, o = 0;
+    while (i < size)
+    {
+        const unsigned char token = src[i++];
+        std::size_t literals = token >> 4;
+        if (literals == 15 && !get_length(i, literals)) return false;
+        if (literals > size - i || literals > dst_size - o) return false;
+        std::copy(src + i, src + i + literals, dst + o);
+        i += literals;
+        o += literals;
+        if (i == size) break; // the last sequence
+
+        if (size - i < 2) return false;
+        const std::size_t offset = src[i] | (src[i + 1] << 8);
+        i += 2;
+        std::size_t match = token & 15;
+        if (match == 15 && !get_length(i, match)) return false;
+        match += 4;
+        if (offset == 0 || offset > o || match > dst_size - o) return false;
+        // Matches may overlap the bytes they produce.
+        for (std::size_t j = 0; j < match; ++j, ++o) dst[o] = dst[o - offset];
+    }
+    return o == dst_size;
+}
+
+cl_int write_file(const std::string& path, std::uint64_t step,
+                  const std::vector<SectionView>& sections,
+                  cl::sdk::Compression compression,
+                  std::uint64_t* stored_bytes = nullptr)
+{
+    std::vector<unsigned char> header(
+        checkpoint_magic, checkpoint_magic + sizeof(checkpoint_magic));
+    put(header, checkpoint_version);
+    put(header, static_cast<std::uint32_t>(sections.size()));
+    put(header, step);
+
+    const std::string temporary = path + ".tmp";
+    std::ofstream file{ temporary, std::ios::binary | std::ios::trunc };
+    file.write(reinterpret_cast<const char*>(header.data()), header.size());
+
+    std::uint64_t stored_total = 0;
+    for (const auto& section : sections)
+    {
+        std::vector<unsigned char> compressed;
+        if (compression == cl::sdk::Compression::LZ)
+            compressed = lz_compress(section.data, section.size);
+        const bool raw = compression == cl::sdk::Compression::None
+            || compressed.size() >= section.size;
+        const unsigned char* stored = raw ? section.data : compressed.data();
+        const std::uint64_t stored_size =
+            raw ? section.size : compressed.size();
+
+        header.clear();
+        put(header, static_cast<std::uint32_t>(section.name.size()));
+        header.insert(header.end(), section.name.begin(), section.name.end());
+        put(header,
+            static_cast<std::uint32_t>(raw ? cl::sdk::Compression::None
+                                           : cl::sdk::Compression::LZ));
+        put(header, section.size);
+        put(header, stored_size);
+        put(header, fnv1a(section.data, section.size));
+        file.write(reinterpret_cast<const char*>(header.data()), header.size());
+        file.write(reinterpret_cast<const char*>(stored), stored_size);
+        stored_total += stored_size;
+    }
+    file.close();
+
+    cl_int error = CL_SUCCESS;
+    if (!file)
+    {
+        std::remove(temporary.c_str());
+        cl::util::detail::errHandler(CL_UTIL_FILE_OPERATION_ERROR, &error,
+                                     "Failed to write checkpoint file.");
+        return error;
+    }
+    // Renaming replaces path at once on POSIX, elsewhere it may have to be
+    // removed first.
+    if (std::rename(temporary.c_str(), path.c_str()) != 0
+        && (std::remove(path.c_str()) != 0
+            || std::rename(temporary.c_str(), path.c_str()) != 0))
+    {
+        std::remove(temporary.c_str());
+        cl::util::detail::errHandler(CL_UTIL_FILE_OPERATION_ERROR, &error,
+                                     "Failed to rename checkpoint file.");
+        return error;
+    }
+    if (stored_bytes != nullptr) *stored_bytes = stored_total;
+    return error;
+}
+
+std::vector<cl::size_type> section_offsets(
+    const std::vector<std::pair<std::string, cl::size_type>>& sections)
+{
+    std::vector<cl::size_type> offsets{ 0 };
+    for (const auto& section : sections)
+        offsets.push_back(offsets.back() + section.second);
+    return offsets;
+}
+}
+
+const cl::sdk::Checkpoint::Section*
+cl::sdk::Checkpoint::find(const std::string& name) const
+{
+    for (const auto& section : sections)
+        if (section.name == name) return &section;
+    return nullptr;
+}
+
+cl::sdk::Checkpoint cl::sdk::read_checkpoint(const std::string& path,
+                                             cl_int* error)
+{
+    std::ifstream file{ path, std::ios::binary };
+    const std::vector<unsigned char> bytes{
+        std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{}
+    };
+
+    // Reads an integer, or fails if the file ends before it.
+    std::size_t pos = 0;
+    auto get = [&](auto& value) {
+        using T = std::remove_reference_t<decltype(value)>;
+        if (bytes.size() - pos < sizeof(T)) return false;
+        value = 0;
+        for (std::size_t i = 0; i < sizeof(T); ++i)
+            value |= static_cast<T>(bytes[pos++]) << (8 * i);
+        return true;
+    };
+    auto fail = [&](const char* message) {
+        cl::util::detail::errHandler(CL_UTIL_FILE_OPERATION_ERROR, error,
+                                     message);
+        return Checkpoint{};
+    };
+
+    if (!file.is_open()) return fail("Failed to open checkpoint file.");
+    std::uint32_t file_version = 0, count = 0;
+    Checkpoint checkpoint;
+    if (bytes.size() < sizeof(checkpoint_magic)
+        || !std::equal(checkpoint_magic,
+                       checkpoint_magic + sizeof(checkpoint_magic),
+                       bytes.begin()))
+        return fail("Not a checkpoint file.");
+    pos = sizeof(checkpoint_magic);
+    if (!get(file_version) || file_version != checkpoint_version)
+        return fail("Unsupported checkpoint version.");
+    if (!get(count) || !get(checkpoint.step))
+        return fail("Truncated checkpoint file.");
+
+    for (std::uint32_t s = 0; s < count; ++s)
+    {
+        std::uint32_t name_size = 0, codec = 0;
+        std::uint64_t size = 0, stored_size = 0, hash = 0;
+        if (!get(name_size) || bytes.size() - pos < name_size)
+            return fail("Truncated checkpoint file.");
+        Checkpoint::Section section;
+        section.name.assign(bytes.begin() + pos,
+                            bytes.begin() + pos + name_size);
+        pos += name_size;
+        if (!get(codec) || !get(size) || !get(stored_size) || !get(hash)
+            || bytes.size() - pos < stored_size)
+            return fail("Truncated checkpoint file.");
+
+        // A byte of LZ4 data expands to at most 255 bytes.
+        const bool raw =
+            codec == static_cast<std::uint32_t>(Compression::None);
+        const bool lz = codec == static_cast<std::uint32_t>(Compression::LZ);
+        if ((raw && stored_size != size) || (lz && size / 255 > stored_size)
+            || (!raw && !lz))
+            return fail("Corrupt section in checkpoint file.");
+        section.data.resize(size);
+        const unsigned char* stored = bytes.data() + pos;
+        if (raw)
+            std::copy(stored, stored + size, section.data.begin());
+        else if (!lz_decompress(stored, stored_size, section.data.data(),
+                                size))
+            return fail("Corrupt section in checkpoint file.");
+        pos += stored_size;
+
+        if (fnv1a(section.data.data(), size) != hash)
+            return fail("Checksum mismatch in checkpoint file.");
+        checkpoint.sections.push_back(std::move(section));
+    }
+
+    if (error != nullptr) *error = CL_SUCCESS;
+    return checkpoint;
+}
+
+cl_int cl::sdk::write_checkpoint(const std::string& path,
+                                 const Checkpoint& checkpoint,
+                                 Compression compression)
+{
+    std::vector<SectionView> views;
+    for (const auto& section : checkpoint.sections)
+        views.push_back(SectionView{ section.name, section.data.data(),
+                                     section.data.size() });
+    return write_file(path, checkpoint.step, views, compression);
+}
+
+cl::sdk::CheckpointWriter::CheckpointWriter(
+    const cl::Context& context, const cl::CommandQueue& read_queue,
+    std::string path,
+    std::vector<std::pair<std::string, cl::size_type>> sections,
+    Compression compression, std::size_t slots)
+    : path{ std::move(path) }, sections{ std::move(sections) },
+      offsets{ section_offsets(this->sections) }, compression{ compression },
+      submitted{ 0 }, stats{ 0, 0, 0 }, write_error{ CL_SUCCESS },
+      // A single writer thread writes the checkpoints in order.
+      pipeline{ context, read_queue, offsets.back(),
+                [this](const ReadbackPipeline::Frame& frame) { write(frame); },
+                slots, 1 }
+{}
+
+cl::Event cl::sdk::CheckpointWriter::submit(
+    std::uint64_t step,
+    const std::function<cl::Event(const cl::Buffer&)>& enqueue_copy)
+{
+    // The frame may be written before submit() returns.
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        steps[submitted] = step;
+    }
+    try
+    {
+        const cl::Event event = pipeline.submit(enqueue_copy);
+        std::lock_guard<std::mutex> lock(mutex);
+        ++submitted;
+        return event;
+    } catch (...)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        steps.erase(submitted);
+        throw;
+    }
+}
+
+void cl::sdk::CheckpointWriter::finish(cl_int* error)
+{
+    pipeline.finish();
+
+    cl_int first = CL_SUCCESS;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::swap(first, write_error);
+    }
+    if (first != CL_SUCCESS)
+        cl::util::detail::errHandler(
+            first, error, "CheckpointWriter::finish() write failed.");
+    else if (error != nullptr)
+        *error = CL_SUCCESS;
+}
+
+cl::sdk::CheckpointWriter::Statistics
+cl::sdk::CheckpointWriter::statistics() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void cl::sdk::CheckpointWriter::write(const ReadbackPipeline::Frame& frame)
+{
+    std::uint64_t step;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = steps.find(frame.index);
+        step = it->second;
+        steps.erase(it);
+    }
+
+    const auto data = static_cast<const unsigned char*>(frame.data);
+    std::vector<SectionView> views;
+    for (std::size_t i = 0; i < sections.size(); ++i)
+        views.push_back(SectionView{ sections[i].first, data + offsets[i],
+                                     sections[i].second });
+    std::uint64_t stored_bytes = 0;
+    const cl_int error =
+        write_file(path, step, views, compression, &stored_bytes);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (error != CL_SUCCESS)
+    {
+        // Only reached with exceptions disabled, finish() reports it.
+        if (write_error == CL_SUCCESS) write_error = error;
+        return;
+    }
+    ++stats.checkpoints;
+    stats.bytes += frame.size;
+    stats.stored_bytes += stored_bytes;
+}
@@ -0,0 +1,310 @@
+// OpenCL SDK includes
+#include <CL/SDK/CommandBuffer.hpp>
+
+// OpenCL Utils includes
+#include <CL/Utils/Device.hpp>
+#include <CL/Utils/Error.hpp>
+
+// STL includes
+#include <algorithm> // std::sort, std::unique
+
+// Entry points of cl_khr_command_buffer and its mutable dispatch extension are
+// resolved by the extension loader the SDK library links to.
+
+cl::sdk::CommandBuffer::CommandBuffer(const cl::CommandQueue& queue,
+                                      bool native)
+    : queue{ queue }, mode_{ Mode::Direct }, buffer{ nullptr },
+      finalized{ false }
+{
+#if defined(cl_khr_command_buffer)
+    const cl::Device device = queue.getInfo<CL_QUEUE_DEVICE>();
+    if (!native
+        || !cl::util::supports_extension(device, "cl_khr_command_buffer"))
+        return;
+
+    // Some devices only record for queues with certain properties, for eg.
+    // profiling enabled.
+    cl_command_queue_properties required = 0;
+    clGetDeviceInfo(device(),
+                    CL_DEVICE_COMMAND_BUFFER_REQUIRED_QUEUE_PROPERTIES_KHR,
+                    sizeof(required), &required, nullptr);
+    if ((queue.getInfo<CL_QUEUE_PROPERTIES>() & required) != required) return;
+    mode_ = Mode::Recorded;
+
+#if defined(cl_khr_command_buffer_mutable_dispatch)
+    cl_mutable_dispatch_fields_khr fields = 0;
+    if (cl::util::supports_extension(device,
+                                     "cl_khr_command_buffer_mutable_dispatch")
+        && clGetDeviceInfo(device(),
+                           CL_DEVICE_MUTABLE_DISPATCH_CAPABILITIES_KHR,
+                           sizeof(fields), &fields, nullptr)
+            == CL_SUCCESS
+        && (fields & CL_MUTABLE_DISPATCH_ARGUMENTS_KHR))
+        mode_ = Mode::Mutable;
+#endif
+#else
+    (void)native;
+#endif
+}
+
+cl::sdk::CommandBuffer::~CommandBuffer() { release(); }
+
+cl::sdk::CommandBuffer::CommandBuffer(CommandBuffer&& other) noexcept
+    : queue{ std::move(other.queue) }, mode_{ other.mode_ },
+      launches{ std::move(other.launches) }, buffer{ other.buffer },
+      finalized{ other.finalized }, updates{ std::move(other.updates) },
+      last{ std::move(other.last) }
+{
+    other.buffer = nullptr;
+}
+
+cl::sdk::CommandBuffer&
+cl::sdk::CommandBuffer::operator=(CommandBuffer&& other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        queue = std::move(other.queue);
+        mode_ = other.mode_;
+        launches = std::move(other.launches);
+        buffer = other.buffer;
+        finalized = other.finalized;
+        updates = std::move(other.updates);
+        last = std::move(other.last);
+        other.buffer = nullptr;
+    }
+    return *this;
+}
+
+std::size_t cl::sdk::CommandBuffer::add(Launch launch)
+{
+    if (finalized)
+    {
+        cl::util::detail::errHandler(CL_INVALID_OPERATION, nullptr,
+                                     "cl::sdk::CommandBuffer::add() called "
+                                     "after finalize()");
+        return launches.size();
+    }
+    launches.push_back(std::move(launch));
+    return launches.size() - 1;
+}
+
+void cl::sdk::CommandBuffer::set_arg(std::size_t command, cl_uint index,
+                                     Arg arg)
+{
+    if (command >= launches.size() || index >= launches[command].args.size())
+    {
+        cl::util::detail::errHandler(CL_INVALID_ARG_INDEX, nullptr,
+                                     "cl::sdk::CommandBuffer::set_arg() "
+                                     "command or argument out of range");
+        return;
+    }
+    launches[command].args[index] = std::move(arg);
+    if (finalized) updates.emplace_back(command, index);
+}
+
+void cl::sdk::CommandBuffer::set_args(Launch& launch)
+{
+    for (cl_uint i = 0; i < launch.args.size(); ++i)
+        launch.kernel.setArg(i, launch.args[i].size,
+                             launch.args[i].value.empty()
+                                 ? nullptr
+                                 : launch.args[i].value.data());
+}
+
+void cl::sdk::CommandBuffer::finalize()
+{
+    if (finalized) return;
+    if (mode_ != Mode::Direct) record();
+    finalized = true;
+}
+
+void cl::sdk::CommandBuffer::record()
+{
+#if defined(cl_khr_command_buffer)
+    release();
+
+    std::vector<cl_command_buffer_properties_khr> properties;
+    const cl_command_properties_khr* command_properties = nullptr;
+#if defined(cl_khr_command_buffer_mutable_dispatch)
+    static const cl_command_properties_khr mutable_arguments[] = {
+        CL_MUTABLE_DISPATCH_UPDATABLE_FIELDS_KHR,
+        CL_MUTABLE_DISPATCH_ARGUMENTS_KHR, 0
+    };
+    if (mode_ == Mode::Mutable)
+    {
+        properties = { CL_COMMAND_BUFFER_FLAGS_KHR,
+                       CL_COMMAND_BUFFER_MUTABLE_KHR };
+        command_properties = mutable_arguments;
+    }
+#endif
+    properties.push_back(0);
+
+    // A partial recording is dropped and the launches are enqueued directly
+    // from then on, so that they still run with exceptions disabled.
+    auto fail = [this](cl_int error, const char* message) {
+        release();
+        for (auto& launch : launches) launch.handle = nullptr;
+        mode_ = Mode::Direct;
+        cl::util::detail::errHandler(error, nullptr, message);
+    };
+
+    cl_int err = CL_SUCCESS;
+    cl_command_queue queue_handle = queue();
+    cl_command_buffer_khr command_buffer =
+        clCreateCommandBufferKHR(1, &queue_handle, properties.data(), &err);
+    if (err != CL_SUCCESS)
+    {
+        fail(err,
+             "Failed to create command buffer in "
+             "cl::sdk::CommandBuffer::record()");
+        return;
+    }
+    buffer = command_buffer;
+
+    // Every launch waits for the previous one, as on the in-order queue.
+    cl_sync_point_khr previous = 0;
+    for (std::size_t i = 0; i < launches.size() && err == CL_SUCCESS; ++i)
+    {
+        auto& launch = launches[i];
+        set_args(launch);
+        const cl::size_type* local = launch.local.dimensions() != 0
+            ? static_cast<const cl::size_type*>(launch.local)
+            : nullptr;
+        cl_sync_point_khr sync_point = 0;
+        cl_mutable_command_khr handle = nullptr;
+        err = clCommandNDRangeKernelKHR(
+            command_buffer, nullptr, command_properties, launch.kernel(),
+            static_cast<cl_uint>(launch.global.dimensions()), nullptr,
+            launch.global, local, i != 0 ? 1 : 0,
+            i != 0 ? &previous : nullptr, &sync_point,
+            mode_ == Mode::Mutable ? &handle : nullptr);
+        launch.handle = handle;
+        previous = sync_point;
+    }
+    if (err == CL_SUCCESS) err = clFinalizeCommandBufferKHR(command_buffer);
+    if (err != CL_SUCCESS)
+        fail(err,
+             "Failed to record command buffer in "
+             "cl::sdk::CommandBuffer::record()");
+#endif
+}
+
+void cl::sdk::CommandBuffer::release()
+{
+#if defined(cl_khr_command_buffer)
+    // Replays in flight keep the command buffer alive until they complete.
+    if (buffer != nullptr)
+        clReleaseCommandBufferKHR(static_cast<cl_command_buffer_khr>(buffer));
+#endif
+    buffer = nullptr;
+}
+
+cl::Event cl::sdk::CommandBuffer::enqueue(const std::vector<cl::Event>& events)
+{
+    finalize();
+
+    if (mode_ == Mode::Direct)
+    {
+        // The in-order queue orders the launches, only the first one waits
+        // for events.
+        cl::Event event;
+        for (std::size_t i = 0; i < launches.size(); ++i)
+        {
+            set_args(launches[i]);
+            queue.enqueueNDRangeKernel(
+                launches[i].kernel, cl::NullRange, launches[i].global,
+                launches[i].local, i == 0 ? &events : nullptr,
+                i + 1 == launches.size() ? &event : nullptr);
+        }
+        updates.clear();
+        last = event;
+        return event;
+    }
+
+#if defined(cl_khr_command_buffer)
+    // Implementations of earlier revisions of the extension reject updating
+    // or enqueueing a command buffer while a previous replay is pending. Wait
+    // for it and retry.
+    auto retry = [this](cl_int err) {
+        if (err != CL_INVALID_OPERATION || last() == nullptr) return false;
+        last.wait();
+        last = cl::Event{};
+        return true;
+    };
+    cl_int err = CL_SUCCESS;
+
+    if (!updates.empty() && mode_ == Mode::Recorded)
+    {
+        record();
+        // Recording failed and fell back to direct launches.
+        if (mode_ == Mode::Direct) return enqueue(events);
+    }
+#if defined(cl_khr_command_buffer_mutable_dispatch)
+    else if (!updates.empty())
+    {
+        std::sort(updates.begin(), updates.end());
+        updates.erase(std::unique(updates.begin(), updates.end()),
+                      updates.end());
+
+        std::vector<cl_mutable_dispatch_arg_khr> args(updates.size());
+        std::vector<cl_mutable_dispatch_config_khr> configs(updates.size());
+        std::vector<cl_command_buffer_update_type_khr> types(
+            updates.size(), CL_STRUCTURE_TYPE_MUTABLE_DISPATCH_CONFIG_KHR);
+        std::vector<const void*> config_ptrs(updates.size());
+        for (std::size_t i = 0; i < updates.size(); ++i)
+        {
+            const auto& launch = launches[updates[i].first];
+            const auto& arg = launch.args[updates[i].second];
+            args[i] = {};
+            args[i].arg_index = updates[i].second;
+            args[i].arg_size = arg.size;
+            args[i].arg_value = arg.value.empty() ? nullptr : arg.value.data();
+            configs[i] = {};
+            configs[i].command =
+                static_cast<cl_mutable_command_khr>(launch.handle);
+            configs[i].num_args = 1;
+            configs[i].arg_list = &args[i];
+            config_ptrs[i] = &configs[i];
+        }
+        auto update = [&]() {
+            return clUpdateMutableCommandsKHR(
+                static_cast<cl_command_buffer_khr>(buffer),
+                static_cast<cl_uint>(configs.size()), types.data(),
+                config_ptrs.data());
+        };
+        err = update();
+        if (retry(err)) err = update();
+        if (cl::util::detail::errHandler(
+                err, nullptr,
+                "Failed to update command buffer in "
+                "cl::sdk::CommandBuffer::enqueue()")
+            != CL_SUCCESS)
+            return cl::Event{};
+    }
+#endif
+    updates.clear();
+
+    std::vector<cl_event> wait;
+    for (const auto& event : events) wait.push_back(event());
+    cl_event event = nullptr;
+    auto replay = [&]() {
+        return clEnqueueCommandBufferKHR(
+            0, nullptr, static_cast<cl_command_buffer_khr>(buffer),
+            static_cast<cl_uint>(wait.size()),
+            wait.empty() ? nullptr : wait.data(), &event);
+    };
+    err = replay();
+    if (retry(err)) err = replay();
+    if (cl::util::detail::errHandler(err, nullptr,
+                                     "Failed to enqueue command buffer in "
+                                     "cl::sdk::CommandBuffer::enqueue()")
+        != CL_SUCCESS)
+        return cl::Event{};
+
+    last = cl::Event{ event };
+    return last;
+#else
+    return cl::Event{};
+#endif
+}
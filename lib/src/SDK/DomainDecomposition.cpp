@@ -0,0 +1,217 @@
+// OpenCL SDK includes
+#include <CL/SDK/DomainDecomposition.hpp>
+
+// OpenCL Utils includes
+#include <CL/Utils/Error.hpp>
+
+// STL includes
+#include <algorithm> // std::max, std::min
+#include <cmath> // std::llround
+#include <numeric> // std::accumulate
+
+namespace {
+cl::size_type gcd(cl::size_type a, cl::size_type b)
+{
+    while (b != 0)
+    {
+        const cl::size_type t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+}
+
+cl::sdk::DomainDecomposition::DomainDecomposition(
+    const cl::Context& context, const cl::vector<cl::Device>& devices,
+    cl::QueueProperties properties)
+    : context{ context }, align_bytes{ 1 }, slices_{ 0 }, halo_{ 0 },
+      granularity_{ 1 }
+{
+    for (const auto& device : devices)
+    {
+        const double weight =
+            static_cast<double>(device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>())
+            * std::max<cl_uint>(
+                device.getInfo<CL_DEVICE_MAX_CLOCK_FREQUENCY>(), 1);
+        parts_.push_back(Part{ device,
+                               cl::CommandQueue{ context, device, properties },
+                               0, 0, weight });
+
+        // the query returns the alignment in bits
+        align_bytes = std::max<cl::size_type>(
+            align_bytes, device.getInfo<CL_DEVICE_MEM_BASE_ADDR_ALIGN>() / 8);
+    }
+}
+
+void cl::sdk::DomainDecomposition::decompose(
+    cl::size_type slices, const std::vector<cl::size_type>& slice_bytes,
+    cl::size_type halo)
+{
+    slices_ = slices;
+    halo_ = halo;
+
+    // Range boundaries must be a multiple of this many slices for the origin
+    // of sub-buffers to be aligned in every buffer.
+    granularity_ = 1;
+    for (auto bytes : slice_bytes)
+    {
+        const auto g = align_bytes / gcd(align_bytes, bytes);
+        granularity_ = granularity_ / gcd(granularity_, g) * g;
+    }
+
+    split();
+}
+
+void cl::sdk::DomainDecomposition::set_weights(
+    const std::vector<double>& weights)
+{
+    if (weights.size() != parts_.size())
+    {
+        cl::util::detail::errHandler(
+            CL_INVALID_VALUE, nullptr,
+            "DomainDecomposition::set_weights() expects a weight per device.");
+        return;
+    }
+
+    for (std::size_t i = 0; i < parts_.size(); ++i)
+        parts_[i].weight = weights[i];
+    split();
+}
+
+void cl::sdk::DomainDecomposition::rebalance(
+    const std::vector<cl::Event>& events)
+{
+    if (events.size() != parts_.size())
+    {
+        cl::util::detail::errHandler(
+            CL_INVALID_VALUE, nullptr,
+            "DomainDecomposition::rebalance() expects an event per part.");
+        return;
+    }
+
+    // Parts without work keep their previous weight, rescaled below.
+    std::vector<double> weights;
+    for (std::size_t i = 0; i < parts_.size(); ++i)
+    {
+        double weight = parts_[i].weight;
+        if (parts_[i].count != 0 && events[i]() != nullptr)
+        {
+            const auto start =
+                events[i].getProfilingInfo<CL_PROFILING_COMMAND_START>();
+            const auto end =
+                events[i].getProfilingInfo<CL_PROFILING_COMMAND_END>();
+            if (end > start)
+                weight = static_cast<double>(parts_[i].count) / (end - start);
+        }
+        weights.push_back(weight);
+    }
+
+    // Weights measured in slices per nanosecond are not comparable to the
+    // previous weights of idle parts, so scale those by the overall ratio.
+    double measured = 0.0, estimated = 0.0;
+    for (std::size_t i = 0; i < parts_.size(); ++i)
+        if (parts_[i].count != 0)
+        {
+            measured += weights[i];
+            estimated += parts_[i].weight;
+        }
+    for (std::size_t i = 0; i < parts_.size(); ++i)
+        if (parts_[i].count == 0 && estimated > 0.0)
+            weights[i] *= measured / estimated;
+
+    set_weights(weights);
+}
+
+cl::Buffer cl::sdk::DomainDecomposition::owned(std::size_t part,
+                                               const cl::Buffer& buffer,
+                                               cl::size_type slice_bytes,
+                                               cl_mem_flags flags) const
+{
+    const auto& p = parts_.at(part);
+    return sub_buffer(buffer, p.first * slice_bytes, p.count * slice_bytes,
+                      flags);
+}
+
+cl::Buffer cl::sdk::DomainDecomposition::with_halo(std::size_t part,
+                                                   const cl::Buffer& buffer,
+                                                   cl::size_type slice_bytes,
+                                                   cl_mem_flags flags) const
+{
+    // slice i of the grid is slice i + halo of the padded buffer, so the
+    // range with halos starts at the same offset as the owned range
+    const auto& p = parts_.at(part);
+    return sub_buffer(buffer, p.first * slice_bytes,
+                      (p.count + 2 * halo_) * slice_bytes, flags);
+}
+
+std::vector<cl::Event> cl::sdk::DomainDecomposition::launch(
+    const std::function<cl::Event(std::size_t, Part&)>& enqueue)
+{
+    std::vector<cl::Event> events(parts_.size());
+    for (std::size_t i = 0; i < parts_.size(); ++i)
+        if (parts_[i].count != 0)
+        {
+            events[i] = enqueue(i, parts_[i]);
+            parts_[i].queue.flush();
+        }
+    return events;
+}
+
+void cl::sdk::DomainDecomposition::join(const std::vector<cl::Event>& events)
+{
+    std::vector<cl::Event> pending;
+    for (const auto& event : events)
+        if (event() != nullptr) pending.push_back(event);
+    if (!pending.empty()) cl::WaitForEvents(pending);
+}
+
+void cl::sdk::DomainDecomposition::split()
+{
+    const double total = std::accumulate(
+        parts_.begin(), parts_.end(), 0.0,
+        [](double sum, const Part& part) { return sum + part.weight; });
+
+    double cumulative = 0.0;
+    cl::size_type first = 0;
+    for (std::size_t i = 0; i < parts_.size(); ++i)
+    {
+        cumulative += parts_[i].weight;
+
+        // round boundaries to the closest aligned slice, the last part takes
+        // the remainder
+        cl::size_type last = slices_;
+        if (i + 1 < parts_.size() && total > 0.0)
+        {
+            const auto ideal = static_cast<cl::size_type>(std::llround(
+                static_cast<double>(slices_) * cumulative / total));
+            const auto aligned =
+                (ideal + granularity_ / 2) / granularity_ * granularity_;
+            last = std::min(std::max(aligned, first), slices_);
+        }
+
+        parts_[i].first = first;
+        parts_[i].count = last - first;
+        first = last;
+    }
+}
+
+cl::Buffer cl::sdk::DomainDecomposition::sub_buffer(const cl::Buffer& buffer,
+                                                    cl::size_type origin,
+                                                    cl::size_type size,
+                                                    cl_mem_flags flags) const
+{
+    if (origin % align_bytes != 0)
+    {
+        cl::util::detail::errHandler(
+            CL_MISALIGNED_SUB_BUFFER_OFFSET, nullptr,
+            "DomainDecomposition sub-buffer origin is not aligned, slice size "
+            "was not passed to decompose().");
+        return cl::Buffer{};
+    }
+
+    cl_buffer_region region = { origin, size };
+    cl::Buffer parent = buffer;
+    return parent.createSubBuffer(flags, CL_BUFFER_CREATE_TYPE_REGION,
+                                  &region);
+}
@@ -0,0 +1,202 @@
+// OpenCL SDK includes
+#include <CL/SDK/DynamicScheduler.hpp>
+
+// OpenCL Utils includes
+#include <CL/Utils/Error.hpp>
+
+// STL includes
+#include <algorithm> // std::max, std::min
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+// Completions reported by event callbacks. Callbacks may run on a thread of
+// the runtime after run() returned, so they own a reference to the state.
+struct cl::sdk::DynamicScheduler::State
+{
+    struct Completion
+    {
+        std::size_t dispatch;
+        cl_int status;
+    };
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Completion> completions;
+};
+
+struct cl::sdk::DynamicScheduler::CallbackData
+{
+    std::shared_ptr<State> state;
+    std::size_t dispatch;
+};
+
+// Callbacks must not call the OpenCL API, so they only notify run(), which
+// enqueues the next chunk.
+void CL_CALLBACK cl::sdk::DynamicScheduler::on_complete(cl_event,
+                                                        cl_int status,
+                                                        void* user_data)
+{
+    auto data = static_cast<CallbackData*>(user_data);
+    {
+        std::lock_guard<std::mutex> lock(data->state->mutex);
+        data->state->completions.push_back({ data->dispatch, status });
+    }
+    data->state->cv.notify_one();
+    delete data;
+}
+
+cl::sdk::DynamicScheduler::DynamicScheduler(
+    const std::vector<cl::CommandQueue>& queues, cl::size_type granularity,
+    cl::size_type min_chunk, unsigned depth)
+    : queues{ queues },
+      granularity{ std::max<cl::size_type>(granularity, 1) },
+      min_chunk{ std::max<cl::size_type>(min_chunk, 1) },
+      depth{ std::max(depth, 1u) },
+      stats(queues.size(), Statistics{ 0, 0, 0.0, 0.0 })
+{
+    for (const auto& queue : queues)
+        profiling.push_back(
+            (queue.getInfo<CL_QUEUE_PROPERTIES>() & CL_QUEUE_PROFILING_ENABLE)
+            != 0);
+}
+
+void cl::sdk::DynamicScheduler::run(
+    cl::size_type size,
+    const std::function<cl::Event(std::size_t, cl::CommandQueue&,
+                                  const Chunk&)>& enqueue)
+{
+    using clock = std::chrono::steady_clock;
+    struct Dispatch
+    {
+        std::size_t queue;
+        Chunk chunk;
+        cl::Event event;
+        clock::time_point start;
+    };
+
+    state = std::make_shared<State>();
+    // throughput is kept from previous runs
+    for (auto& stat : stats)
+    {
+        stat.chunks = 0;
+        stat.items = 0;
+        stat.seconds = 0.0;
+    }
+
+    std::vector<Dispatch> dispatches;
+    std::vector<clock::time_point> last_completion(queues.size(),
+                                                   clock::now());
+    cl::size_type next = 0;
+    std::size_t pending = 0;
+    cl_int error = CL_SUCCESS;
+
+    auto dispatch = [&](std::size_t queue) {
+        const Chunk chunk{ next, chunk_size(queue, size - next) };
+        next += chunk.count;
+
+        cl::Event event = enqueue(queue, queues[queue], chunk);
+        dispatches.push_back(Dispatch{ queue, chunk, event, clock::now() });
+        event.setCallback(CL_COMPLETE, on_complete,
+                          new CallbackData{ state, dispatches.size() - 1 });
+        queues[queue].flush();
+        ++pending;
+    };
+
+    for (unsigned d = 0; d < depth; ++d)
+        for (std::size_t q = 0; q < queues.size() && next < size; ++q)
+            dispatch(q);
+
+    while (pending != 0)
+    {
+        State::Completion completion;
+        {
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->cv.wait(lock,
+                           [&]() { return !state->completions.empty(); });
+            completion = state->completions.front();
+            state->completions.pop_front();
+        }
+        --pending;
+
+        const auto& done = dispatches[completion.dispatch];
+        if (completion.status < 0)
+        {
+            // stop handing out chunks, but let the ones in flight finish
+            error = completion.status;
+            next = size;
+            continue;
+        }
+
+        // Chunks in flight on the same queue wait for each other, so host
+        // time is only counted from the previous completion.
+        double seconds;
+        const auto now = clock::now();
+        if (profiling[done.queue])
+            seconds = (done.event.getProfilingInfo<CL_PROFILING_COMMAND_END>()
+                       - done.event
+                             .getProfilingInfo<CL_PROFILING_COMMAND_START>())
+                * 1e-9;
+        else
+            seconds = std::chrono::duration<double>(
+                          now
+                          - std::max(done.start,
+                                     last_completion[done.queue]))
+                          .count();
+        last_completion[done.queue] = now;
+
+        auto& stat = stats[done.queue];
+        ++stat.chunks;
+        stat.items += done.chunk.count;
+        stat.seconds += seconds;
+        if (seconds > 0.0)
+        {
+            const double throughput = done.chunk.count / seconds;
+            stat.throughput = stat.throughput == 0.0
+                ? throughput
+                : 0.5 * (stat.throughput + throughput);
+        }
+
+        if (next < size) dispatch(done.queue);
+    }
+
+    if (error != CL_SUCCESS)
+        cl::util::detail::errHandler(error, nullptr,
+                                     "DynamicScheduler::run() chunk failed.");
+}
+
+cl::size_type
+cl::sdk::DynamicScheduler::chunk_size(std::size_t queue,
+                                      cl::size_type remaining) const
+{
+    double total = 0.0;
+    std::size_t measured = 0;
+    for (const auto& stat : stats)
+        if (stat.throughput > 0.0)
+        {
+            total += stat.throughput;
+            ++measured;
+        }
+
+    // Until throughput is known, small chunks probe the devices. Afterwards
+    // every queue gets its share of the remaining range, divided among the
+    // chunks it keeps in flight, so that chunks shrink towards the end and
+    // devices finish at the same time.
+    double count;
+    if (measured == 0)
+        count = static_cast<double>(remaining) / (queues.size() * depth * 4);
+    else
+    {
+        const double average = total / measured;
+        const double own = stats[queue].throughput > 0.0
+            ? stats[queue].throughput
+            : average;
+        total += (queues.size() - measured) * average;
+        count = remaining * own / total / depth;
+    }
+
+    auto items = std::max(static_cast<cl::size_type>(count), min_chunk);
+    items = (items + granularity - 1) / granularity * granularity;
+    return std::min(items, remaining);
+}
@@ -0,0 +1,194 @@
+// OpenCL SDK includes
+#include <CL/SDK/ImagePipeline.hpp>
+
+// OpenCL Utils includes
+#include <CL/Utils/Error.hpp>
+
+// STL includes
+#include <algorithm> // std::find
+#include <utility> // std::move
+
+cl::sdk::ImagePipeline::ImagePipeline(const cl::Context& context,
+                                      const cl::Device& device,
+                                      const cl::CommandQueue& queue)
+    : context{ context }, device{ device }, queue{ queue }
+{}
+
+cl::sdk::ImagePipeline&
+cl::sdk::ImagePipeline::add_kernel(const std::string& name, cl::Kernel kernel)
+{
+    stages.push_back(Stage{ StageType::Kernel, name, "", "", kernel });
+    return *this;
+}
+
+cl::sdk::ImagePipeline&
+cl::sdk::ImagePipeline::add_stencil(const std::string& name,
+                                    const std::string& source,
+                                    const std::string& function)
+{
+    stages.push_back(
+        Stage{ StageType::Stencil, name, source, function, cl::Kernel{} });
+    return *this;
+}
+
+cl::sdk::ImagePipeline&
+cl::sdk::ImagePipeline::add_point(const std::string& name,
+                                  const std::string& source,
+                                  const std::string& function)
+{
+    stages.push_back(
+        Stage{ StageType::Point, name, source, function, cl::Kernel{} });
+    return *this;
+}
+
+void cl::sdk::ImagePipeline::build(bool fuse, const std::string& options)
+{
+    groups.clear();
+
+    // Sources of stages are only pasted once, even if shared among stages.
+    std::vector<std::string> sources;
+    std::string kernels;
+    std::vector<std::pair<std::size_t, std::string>> generated;
+
+    // Stages of the kernel being generated: an optional stencil followed by
+    // any number of point stages.
+    const Stage* stencil = nullptr;
+    std::vector<const Stage*> points;
+    auto close_group = [&]() {
+        if (stencil == nullptr && points.empty()) return;
+
+        std::string name = stencil ? stencil->name : "";
+        std::string kernel_name =
+            "image_pipeline_pass_" + std::to_string(groups.size());
+        std::string body = stencil
+            ? "    float4 pixel = " + stencil->function
+                + "(input_image, coord);\n"
+            : "    float4 pixel = convert_float4(read_imageui(input_image, "
+              "coord));\n";
+        for (auto point : points)
+        {
+            name += (name.empty() ? "" : "+") + point->name;
+            body += "    pixel = " + point->function + "(pixel);\n";
+        }
+
+        kernels += "\nkernel void " + kernel_name
+            + "(read_only image2d_t input_image, write_only image2d_t "
+              "output_image)\n"
+              "{\n"
+              "    const int2 coord = { get_global_id(0), get_global_id(1) "
+              "};\n"
+              "    if ((coord.x >= get_image_width(output_image)) ||\n"
+              "        (coord.y >= get_image_height(output_image)))\n"
+              "        return;\n"
+            + body
+            + "    write_imageui(output_image, coord,\n"
+              "        convert_uint4_sat_rte(clamp(pixel, 0.f, 255.f)));\n"
+              "}\n";
+
+        generated.emplace_back(groups.size(), kernel_name);
+        groups.push_back(Group{ name, cl::Kernel{} });
+        stencil = nullptr;
+        points.clear();
+    };
+
+    for (const auto& stage : stages)
+    {
+        if (stage.type != StageType::Kernel
+            && std::find(sources.begin(), sources.end(), stage.source)
+                == sources.end())
+            sources.push_back(stage.source);
+
+        switch (stage.type)
+        {
+            case StageType::Kernel:
+                close_group();
+                groups.push_back(Group{ stage.name, stage.kernel });
+                break;
+            case StageType::Stencil:
+                // a stencil needs the neighbours of its input to be final,
+                // so it always starts a new kernel
+                close_group();
+                stencil = &stage;
+                break;
+            case StageType::Point:
+                if (!fuse) close_group();
+                points.push_back(&stage);
+                break;
+        }
+        if (!fuse) close_group();
+    }
+    close_group();
+
+    if (generated.empty()) return;
+
+    std::string source;
+    for (const auto& stage_source : sources) source += stage_source + "\n";
+    source += kernels;
+
+    program = cl::Program(context, source);
+    program.build(device, options.c_str());
+
+    for (const auto& gen : generated)
+        groups[gen.first].kernel = cl::Kernel(program, gen.second.c_str());
+}
+
+std::vector<cl::sdk::ImagePipeline::Pass>
+cl::sdk::ImagePipeline::run(const cl::Image2D& input, const cl::Image2D& output)
+{
+    if (groups.empty())
+    {
+        cl::util::detail::errHandler(
+            CL_INVALID_OPERATION, nullptr,
+            "ImagePipeline::run() called on an empty or not yet built "
+            "pipeline.");
+        return {};
+    }
+
+    const auto width = input.getImageInfo<CL_IMAGE_WIDTH>();
+    const auto height = input.getImageInfo<CL_IMAGE_HEIGHT>();
+    const auto format = input.getImageInfo<CL_IMAGE_FORMAT>();
+
+    // (Re)create intermediate images if the input changed. Passes alternate
+    // between two images, with only two passes one is enough.
+    for (std::size_t i = 0; i < std::min<std::size_t>(groups.size() - 1, 2);
+         ++i)
+    {
+        if (temp_images[i]() != nullptr)
+        {
+            const auto temp_format =
+                temp_images[i].getImageInfo<CL_IMAGE_FORMAT>();
+            if (temp_images[i].getImageInfo<CL_IMAGE_WIDTH>() == width
+                && temp_images[i].getImageInfo<CL_IMAGE_HEIGHT>() == height
+                && temp_format.image_channel_order
+                    == format.image_channel_order
+                && temp_format.image_channel_data_type
+                    == format.image_channel_data_type)
+                continue;
+        }
+        temp_images[i] = cl::Image2D(
+            context, (cl_mem_flags)(CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS),
+            format, width, height);
+    }
+
+    std::vector<Pass> passes;
+    const cl::Image2D* src = &input;
+    for (std::size_t i = 0; i < groups.size(); ++i)
+    {
+        const cl::Image2D* dst =
+            (i + 1 == groups.size()) ? &output : &temp_images[i % 2];
+
+        auto& kernel = groups[i].kernel;
+        kernel.setArg(0, *src);
+        kernel.setArg(1, *dst);
+
+        cl::Event event;
+        queue.enqueueNDRangeKernel(kernel, cl::NullRange,
+                                   cl::NDRange{ width, height },
+                                   cl::NullRange, nullptr, &event);
+        passes.push_back(Pass{ groups[i].name, std::move(event) });
+
+        src = dst;
+    }
+
+    return passes;
+}
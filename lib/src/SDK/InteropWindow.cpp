@@ -1,19 +1,69 @@
+// OpenGL includes
+//
+// Note: glew.h needs to be included before gl.h, which SFML includes.
+#include <GL/glew.h>
+
 // OpenCL SDK includes
 #include <CL/SDK/InteropWindow.hpp>
 #include <CL/SDK/InteropContext.hpp>
+#include <CL/SDK/Context.hpp>
+
+// STL includes
+#include <algorithm> // std::max
+#include <chrono>
+#include <memory> // std::make_unique
+#include <sstream>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+double milliseconds_since(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start)
+        .count();
+}
+}
 
 cl::sdk::InteropWindow::InteropWindow(sf::VideoMode mode,
                                       const sf::String& title, Style style,
                                       const sf::ContextSettings& settings,
                                       cl_uint platform_id, cl_uint device_id,
-                                      cl_bitfield device_type)
-    : sf::Window{ mode, title, static_cast<sf::Uint32>(style), settings },
-      plat_id{ platform_id }, dev_id{ device_id }, dev_type{ device_type }
-{}
+                                      cl_bitfield device_type,
+                                      const options::Headless& headless)
+    : plat_id{ platform_id }, dev_id{ device_id },
+      dev_type{ device_type }, headless_opts(headless),
+      headless_size{ mode.width, mode.height }, steps{ 0 }, seconds{ 0 },
+      title{ title }, steps_per_frame_{ 1 }, stalled{ 0 }
+{
+    if (!headless_opts.enabled)
+        window = std::make_unique<sf::Window>(
+            mode, title, static_cast<sf::Uint32>(style), settings);
+}
+
+sf::Vector2u cl::sdk::InteropWindow::getSize() const
+{
+    return window ? window->getSize() : headless_size;
+}
+
+void cl::sdk::InteropWindow::close()
+{
+    if (window) window->close();
+}
+
+void cl::sdk::InteropWindow::set_steps_per_frame(std::size_t steps)
+{
+    steps_per_frame_ = std::max<std::size_t>(steps, 1);
+}
 
 void cl::sdk::InteropWindow::run()
 {
-    setActive(true);
+    if (headless())
+    {
+        run_headless();
+        return;
+    }
+
+    window->setActive(true);
 
     initializeGL();
 
@@ -27,17 +77,130 @@ void cl::sdk::InteropWindow::run()
 
     initializeCL();
 
-    while (isOpen())
+    // Sums over the frames since the title was last updated
+    std::size_t frames = 0;
+    double simulating = 0, rendering = 0, stalling = 0;
+    auto reported = Clock::now();
+
+    while (window->isOpen())
     {
+        stalled = 0;
+        auto start = Clock::now();
         render();
+        rendering += milliseconds_since(start) - stalled;
+        stalling += stalled;
 
-        display();
-
+        stalled = 0;
+        start = Clock::now();
         updateScene();
+        simulating += milliseconds_since(start) - stalled;
+        stalling += stalled;
+
+        window->display();
+        ++frames;
+
+        if (milliseconds_since(reported) >= 1000)
+        {
+            std::ostringstream stats;
+            stats.precision(3);
+            stats << " - " << frames * 1000 / milliseconds_since(reported)
+                  << " fps, " << steps_per_frame_ << " steps/frame, sim "
+                  << simulating / frames << " ms, render "
+                  << rendering / frames << " ms, stall "
+                  << stalling / frames << " ms";
+            window->setTitle(title + stats.str());
+            frames = 0;
+            simulating = rendering = stalling = 0;
+            reported = Clock::now();
+        }
 
         sf::Event ev;
-        while (pollEvent(ev)) event(ev);
+        while (window->pollEvent(ev)) event(ev);
     }
 
-    setActive(false);
+    delete_fences(true);
+    window->setActive(false);
+}
+
+void cl::sdk::InteropWindow::run_headless()
+{
+    opencl_context =
+        get_context(options::DeviceTriplet{ plat_id, dev_id, dev_type });
+
+    // Nothing is shared with OpenGL.
+    cl_khr_gl_event_supported = false;
+
+    initializeCL();
+
+    const auto start = Clock::now();
+    auto elapsed = [&]() { return milliseconds_since(start) / 1000; };
+    steps = 0;
+    if (headless_opts.seconds > 0)
+        while (elapsed() < headless_opts.seconds)
+        {
+            updateScene();
+            steps += steps_per_frame_;
+        }
+    else
+        for (std::size_t i = 0; i < headless_opts.iterations; ++i)
+        {
+            updateScene();
+            steps += steps_per_frame_;
+        }
+    seconds = elapsed();
+}
+
+cl::vector<cl::Event> cl::sdk::InteropWindow::gl_fence()
+{
+    delete_fences(false);
+
+#if defined(cl_khr_gl_event)
+    if (cl_khr_gl_event_supported)
+    {
+        GLsync sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+        cl_int err = CL_SUCCESS;
+        cl::Event event{ clCreateEventFromGLsyncKHR(
+            opencl_context(), reinterpret_cast<cl_GLsync>(sync), &err) };
+        if (cl::util::detail::errHandler(
+                err, nullptr,
+                "Failed to create event from GL sync object in "
+                "cl::sdk::InteropWindow::gl_fence()")
+            != CL_SUCCESS)
+        {
+            glDeleteSync(sync);
+            return {};
+        }
+        fences.emplace_back(sync, event);
+        return { event };
+    }
+#endif
+
+    const auto start = Clock::now();
+    glFinish();
+    stalled += milliseconds_since(start);
+    return {};
+}
+
+void cl::sdk::InteropWindow::wait(const cl::Event& event)
+{
+    const auto start = Clock::now();
+    event.wait();
+    stalled += milliseconds_since(start);
+}
+
+void cl::sdk::InteropWindow::delete_fences(bool all)
+{
+    // A sync object may only be deleted once OpenCL is done waiting for it.
+    auto it = fences.begin();
+    for (; it != fences.end(); ++it)
+    {
+        if (all)
+            it->second.wait();
+        else if (it->second.getInfo<CL_EVENT_COMMAND_EXECUTION_STATUS>()
+                 > CL_COMPLETE)
+            break;
+        glDeleteSync(static_cast<GLsync>(it->first));
+    }
+    fences.erase(fences.begin(), it);
 }
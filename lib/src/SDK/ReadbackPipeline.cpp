@@ -0,0 +1,314 @@
+// OpenCL SDK includes
+#include <CL/SDK/ReadbackPipeline.hpp>
+
+// OpenCL Utils includes
+#include <CL/Utils/Error.hpp>
+
+// STL includes
+#include <algorithm> // std::max
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint> // std::intptr_t
+#include <exception>
+#include <mutex>
+
+namespace {
+// Bounded multi-producer multi-consumer queue of slot indices. Every cell
+// carries a sequence number telling whether it may be written or read in the
+// current lap, so pushing and popping need no lock.
+class SlotRing {
+public:
+    explicit SlotRing(std::size_t size)
+    {
+        std::size_t capacity = 1;
+        while (capacity < size) capacity *= 2;
+        cells.reset(new Cell[capacity]);
+        mask = capacity - 1;
+        for (std::size_t i = 0; i < capacity; ++i)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    bool try_push(std::size_t value)
+    {
+        Cell* cell;
+        std::size_t pos = tail.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &cells[pos & mask];
+            const std::size_t sequence =
+                cell->sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::intptr_t>(sequence)
+                - static_cast<std::intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (tail.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false; // full
+            else
+                pos = tail.load(std::memory_order_relaxed);
+        }
+        cell->value = value;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(std::size_t& value)
+    {
+        Cell* cell;
+        std::size_t pos = head.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &cells[pos & mask];
+            const std::size_t sequence =
+                cell->sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::intptr_t>(sequence)
+                - static_cast<std::intptr_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (head.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false; // empty
+            else
+                pos = head.load(std::memory_order_relaxed);
+        }
+        value = cell->value;
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<std::size_t> sequence;
+        std::size_t value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    std::size_t mask;
+    std::atomic<std::size_t> head{ 0 };
+    std::atomic<std::size_t> tail{ 0 };
+};
+}
+
+// Shared by the pipeline, its encoders and event callbacks. Slots move
+// between the rings without locking, the mutex only lets threads sleep while
+// the ring they wait on is empty.
+struct cl::sdk::ReadbackPipeline::State
+{
+    using clock = std::chrono::steady_clock;
+
+    State(std::size_t slots): free{ slots }, ready{ slots }, status(slots) {}
+
+    SlotRing free; // slots submit() may use
+    SlotRing ready; // slots read to the host, waiting for an encoder
+    std::vector<cl_int> status; // execution status of the read of a slot
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::atomic<bool> stop{ false };
+    std::atomic<std::size_t> encoded{ 0 };
+    std::atomic<cl_int> error{ CL_SUCCESS };
+    std::exception_ptr exception;
+
+    // only used by the thread calling submit()
+    std::size_t submitted = 0;
+    clock::time_point start, end;
+    double stall_seconds = 0.0;
+
+    void notify()
+    {
+        // Waiters check the rings while holding the mutex, taking it here
+        // makes sure none of them misses the notification.
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+        }
+        cv.notify_all();
+    }
+};
+
+struct cl::sdk::ReadbackPipeline::CallbackData
+{
+    std::shared_ptr<State> state;
+    std::size_t slot;
+};
+
+// Callbacks must return quickly and not call the OpenCL API, so they only
+// pass the slot on to the encoders.
+void CL_CALLBACK cl::sdk::ReadbackPipeline::on_read(cl_event, cl_int status,
+                                                     void* user_data)
+{
+    auto data = static_cast<CallbackData*>(user_data);
+    auto& state = *data->state;
+    if (status < 0)
+    {
+        cl_int expected = CL_SUCCESS;
+        state.error.compare_exchange_strong(expected, status);
+    }
+    state.status[data->slot] = status;
+    // cannot fail, there are never more slots than cells in the ring
+    state.ready.try_push(data->slot);
+    state.notify();
+    delete data;
+}
+
+cl::sdk::ReadbackPipeline::ReadbackPipeline(const cl::Context& context,
+                                            const cl::CommandQueue& read_queue,
+                                            cl::size_type frame_bytes,
+                                            Encoder encoder, std::size_t slots,
+                                            unsigned encoders)
+    : context{ context }, read_queue{ read_queue }, frame_bytes{ frame_bytes },
+      encoder{ std::move(encoder) }, staging{ context, read_queue },
+      state{ std::make_shared<State>(std::max<std::size_t>(slots, 1)) }
+{
+    // Reads to pinned host memory may be done by DMA, without staging
+    // through a pageable copy.
+    for (std::size_t i = 0; i < std::max<std::size_t>(slots, 1); ++i)
+    {
+        Slot slot;
+        slot.device = cl::Buffer{ context, CL_MEM_READ_WRITE, frame_bytes };
+        slot.host = staging.acquire(frame_bytes);
+        slot.frame = 0;
+        this->slots.push_back(std::move(slot));
+        state->free.try_push(i);
+    }
+
+    for (unsigned i = 0; i < std::max(encoders, 1u); ++i)
+        workers.emplace_back([this]() { encode(); });
+}
+
+cl::sdk::ReadbackPipeline::~ReadbackPipeline()
+{
+    try
+    {
+        finish();
+    } catch (...)
+    {
+        // errors should have been collected by calling finish()
+    }
+
+    state->stop = true;
+    state->notify();
+    for (auto& worker : workers) worker.join();
+}
+
+cl::Event cl::sdk::ReadbackPipeline::submit(
+    const std::function<cl::Event(const cl::Buffer&)>& enqueue_copy)
+{
+    using clock = State::clock;
+    if (state->submitted == 0) state->start = clock::now();
+
+    // Backpressure: with every slot waiting for a read or an encoder, the
+    // caller stalls instead of allocating more memory.
+    std::size_t index;
+    if (!state->free.try_pop(index))
+    {
+        const auto begin = clock::now();
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->cv.wait(lock, [&]() { return state->free.try_pop(index); });
+        state->stall_seconds +=
+            std::chrono::duration<double>(clock::now() - begin).count();
+    }
+
+    auto& slot = slots[index];
+    cl::Event copy_event, read_event;
+    try
+    {
+        copy_event = enqueue_copy(slot.device);
+        // The read waits for the copy from another queue, which is only
+        // guaranteed to make progress once that queue is flushed. Waiting
+        // for a slot or in finish() does not flush anything.
+        copy_event.getInfo<CL_EVENT_COMMAND_QUEUE>().flush();
+        const std::vector<cl::Event> copy_events{ copy_event };
+        read_queue.enqueueReadBuffer(slot.device, false, 0, frame_bytes,
+                                     slot.host.data(), &copy_events,
+                                     &read_event);
+    } catch (...)
+    {
+        state->free.try_push(index);
+        throw;
+    }
+
+    slot.frame = state->submitted++;
+    read_event.setCallback(CL_COMPLETE, on_read,
+                           new CallbackData{ state, index });
+    read_queue.flush();
+    return copy_event;
+}
+
+void cl::sdk::ReadbackPipeline::finish()
+{
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->cv.wait(lock,
+                       [&]() { return state->encoded == state->submitted; });
+    }
+    state->end = State::clock::now();
+
+    std::exception_ptr exception;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        std::swap(exception, state->exception);
+    }
+    if (exception) std::rethrow_exception(exception);
+
+    const cl_int error = state->error.exchange(CL_SUCCESS);
+    if (error != CL_SUCCESS)
+        cl::util::detail::errHandler(
+            error, nullptr, "ReadbackPipeline::finish() frame read failed.");
+}
+
+cl::sdk::ReadbackPipeline::Statistics
+cl::sdk::ReadbackPipeline::statistics() const
+{
+    const std::size_t frames = state->encoded;
+    const auto end = state->encoded == state->submitted
+        ? state->end
+        : State::clock::now();
+    const double seconds = frames == 0
+        ? 0.0
+        : std::chrono::duration<double>(end - state->start).count();
+    return Statistics{ frames, seconds, state->stall_seconds,
+                       seconds > 0.0 ? frames / seconds : 0.0 };
+}
+
+void cl::sdk::ReadbackPipeline::encode()
+{
+    for (;;)
+    {
+        std::size_t index;
+        bool popped = false;
+        {
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->cv.wait(lock, [&]() {
+                popped = state->ready.try_pop(index);
+                return popped || state->stop;
+            });
+        }
+        if (!popped) return;
+
+        const auto& slot = slots[index];
+        if (state->status[index] == CL_COMPLETE)
+        {
+            try
+            {
+                encoder(Frame{ slot.frame, slot.host.data(), frame_bytes });
+            } catch (...)
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (!state->exception)
+                    state->exception = std::current_exception();
+            }
+        }
+
+        state->free.try_push(index);
+        ++state->encoded;
+        state->notify();
+    }
+}
@@ -1,8 +1,15 @@
 // OpenCL SDK includes
 #include <CL/SDK/SDK.hpp>
 
+#include "Blas.cpp"
 #include "CLI.cpp"
+#include "Checkpoint.cpp"
+#include "CommandBuffer.cpp"
+#include "DomainDecomposition.cpp"
+#include "DynamicScheduler.cpp"
 #include "Image.cpp"
+#include "ImagePipeline.cpp"
+#include "ReadbackPipeline.cpp"
 #ifdef OPENCL_SDK_BUILD_OPENGL_SAMPLES
 #include "InteropContext.cpp"
 #include "InteropWindow.cpp"
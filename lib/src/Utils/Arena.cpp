@@ -0,0 +1,218 @@
+#include <CL/Utils/Arena.hpp>
+
+#include <algorithm>
+
+namespace {
+// Largest CL_DEVICE_MEM_BASE_ADDR_ALIGN of the devices of a context in bytes.
+cl::size_type base_addr_align(const cl::Context& context)
+{
+    cl::size_type result = 1;
+    for (const auto& device : context.getInfo<CL_CONTEXT_DEVICES>())
+        // the query returns the alignment in bits
+        result = std::max<cl::size_type>(
+            result, device.getInfo<CL_DEVICE_MEM_BASE_ADDR_ALIGN>() / 8);
+    return result;
+}
+
+cl::size_type align_up(cl::size_type value, cl::size_type alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Moves current and offset to where size bytes fit, trying the rest of the
+// current block and then the following ones. Returns false if a new block is
+// needed.
+bool find_fit(const std::vector<cl::size_type>& block_sizes,
+              std::size_t& current, cl::size_type& offset, cl::size_type size,
+              cl::size_type alignment)
+{
+    for (; current < block_sizes.size(); ++current, offset = 0)
+    {
+        offset = align_up(offset, alignment);
+        if (offset + size <= block_sizes[current]) return true;
+    }
+    return false;
+}
+
+void record_allocation(cl::util::ArenaStatistics& stats, cl::size_type size)
+{
+    ++stats.allocations;
+    stats.in_use += size;
+    stats.high_water = std::max(stats.high_water, stats.in_use);
+}
+}
+
+cl::util::BufferArena::BufferArena(const cl::Context& context,
+                                   cl::size_type block_size,
+                                   cl_mem_flags flags)
+    : context{ context }, block_size{ block_size }, flags{ flags },
+      align_bytes{ base_addr_align(context) }, current{ 0 }, offset{ 0 },
+      stats{ 0, 0, 0, 0, 0, 0 }
+{}
+
+cl::Buffer cl::util::BufferArena::allocate(cl::size_type size, cl_int* error)
+{
+    if (size == 0)
+    {
+        detail::errHandler(CL_INVALID_BUFFER_SIZE, error,
+                           "cl::util::BufferArena::allocate() size is zero");
+        return cl::Buffer{};
+    }
+
+    if (!find_fit(block_sizes, current, offset, size, align_bytes))
+    {
+        // Unlike the cl::Buffer constructor, the C API never throws, so that
+        // errors may be reported through error.
+        const cl::size_type bytes =
+            std::max(block_size, align_up(size, align_bytes));
+        cl_int err = CL_SUCCESS;
+        cl_mem mem = clCreateBuffer(context(), flags, bytes, nullptr, &err);
+        if (err != CL_SUCCESS)
+        {
+            detail::errHandler(err, error,
+                               "Failed to create backing buffer in "
+                               "cl::util::BufferArena::allocate()");
+            return cl::Buffer{};
+        }
+        blocks.push_back(cl::Buffer{ mem });
+        block_sizes.push_back(bytes);
+        stats.capacity += bytes;
+        current = blocks.size() - 1;
+        offset = 0;
+    }
+
+    cl_int err = CL_SUCCESS;
+    cl_buffer_region region = { offset, size };
+    cl_mem mem = clCreateSubBuffer(blocks[current](), 0,
+                                   CL_BUFFER_CREATE_TYPE_REGION, &region, &err);
+    if (err != CL_SUCCESS)
+    {
+        detail::errHandler(err, error,
+                           "Failed to create sub-buffer in "
+                           "cl::util::BufferArena::allocate()");
+        return cl::Buffer{};
+    }
+    cl::Buffer result{ mem };
+
+    offset += size;
+    record_allocation(stats, size);
+    live.push_back(result);
+    if (error != nullptr) *error = CL_SUCCESS;
+    return result;
+}
+
+void cl::util::BufferArena::reset()
+{
+    // The arena holds one reference to every sub-buffer it handed out, more
+    // references likely mean the application still holds on to it. The
+    // count is only a heuristic: CL_MEM_REFERENCE_COUNT is stale as soon as
+    // it is returned, and runtimes may hold references of their own, for
+    // eg. while releasing commands lazily.
+    for (const auto& buffer : live)
+    {
+        cl_uint references = 0;
+        if (clGetMemObjectInfo(buffer(), CL_MEM_REFERENCE_COUNT,
+                               sizeof(references), &references, nullptr)
+                == CL_SUCCESS
+            && references > 1)
+            ++stats.leaks;
+    }
+    live.clear();
+
+    current = 0;
+    offset = 0;
+    stats.in_use = 0;
+    stats.allocations = 0;
+    ++stats.resets;
+}
+
+#ifdef CL_VERSION_2_0
+cl::util::SVMArena::SVMArena(const cl::Context& context,
+                             cl::size_type block_size, cl_svm_mem_flags flags,
+                             cl_int* error)
+    : context{ context }, block_size{ block_size }, flags{ flags },
+      align_bytes{ sizeof(cl_long16) }, current{ 0 }, offset{ 0 },
+      stats{ 0, 0, 0, 0, 0, 0 }
+{
+    if (!supported(context, flags))
+        detail::errHandler(CL_INVALID_OPERATION, error,
+                           "Devices of the context do not support SVM "
+                           "allocations with the requested flags in "
+                           "cl::util::SVMArena::SVMArena()");
+    else if (error != nullptr)
+        *error = CL_SUCCESS;
+}
+
+cl::util::SVMArena::~SVMArena()
+{
+    for (auto block : blocks) clSVMFree(context(), block);
+}
+
+bool cl::util::SVMArena::supported(const cl::Context& context,
+                                   cl_svm_mem_flags flags)
+{
+    cl_device_svm_capabilities required = CL_DEVICE_SVM_COARSE_GRAIN_BUFFER;
+    if (flags & CL_MEM_SVM_FINE_GRAIN_BUFFER)
+        required |= CL_DEVICE_SVM_FINE_GRAIN_BUFFER;
+    if (flags & CL_MEM_SVM_ATOMICS) required |= CL_DEVICE_SVM_ATOMICS;
+
+    for (const auto& device : context.getInfo<CL_CONTEXT_DEVICES>())
+    {
+        // OpenCL 1.x devices reject the query, 3.0 devices without SVM
+        // report no capabilities.
+        cl_device_svm_capabilities caps = 0;
+        if (clGetDeviceInfo(device(), CL_DEVICE_SVM_CAPABILITIES, sizeof(caps),
+                            &caps, nullptr)
+                != CL_SUCCESS
+            || (caps & required) != required)
+            return false;
+    }
+    return true;
+}
+
+void* cl::util::SVMArena::allocate(cl::size_type size, cl_int* error)
+{
+    if (size == 0)
+    {
+        detail::errHandler(CL_INVALID_BUFFER_SIZE, error,
+                           "cl::util::SVMArena::allocate() size is zero");
+        return nullptr;
+    }
+
+    if (!find_fit(block_sizes, current, offset, size, align_bytes))
+    {
+        const cl::size_type bytes =
+            std::max(block_size, align_up(size, align_bytes));
+        // the default alignment is that of the largest data type, which is
+        // at least as large as sizeof(cl_long16)
+        void* block = clSVMAlloc(context(), flags, bytes, 0);
+        if (block == nullptr)
+        {
+            detail::errHandler(CL_MEM_OBJECT_ALLOCATION_FAILURE, error,
+                               "Failed to allocate SVM in "
+                               "cl::util::SVMArena::allocate()");
+            return nullptr;
+        }
+        blocks.push_back(static_cast<char*>(block));
+        block_sizes.push_back(bytes);
+        stats.capacity += bytes;
+        current = blocks.size() - 1;
+        offset = 0;
+    }
+
+    void* result = blocks[current] + offset;
+    offset += size;
+    record_allocation(stats, size);
+    if (error != nullptr) *error = CL_SUCCESS;
+    return result;
+}
+
+void cl::util::SVMArena::reset()
+{
+    current = 0;
+    offset = 0;
+    stats.in_use = 0;
+    stats.allocations = 0;
+    ++stats.resets;
+}
+#endif
@@ -1,6 +1,8 @@
 #include <CL/Utils/Device.hpp>
 
 #include <algorithm>
+#include <cmath>
+#include <numeric>
 
 bool cl::util::opencl_c_version_contains(const cl::Device& device,
                                          const cl::string& version_fragment)
@@ -29,3 +31,177 @@ bool cl::util::supports_feature(const cl::Device& device,
         != c_features.cend();
 }
 #endif
+
+#ifdef CL_VERSION_1_2
+namespace {
+// Unlike cl::Device::createSubDevices, never throws, so other partitioning
+// schemes may be tried if one fails.
+cl_int create_sub_devices(const cl::Device& device,
+                          const cl_device_partition_property* properties,
+                          cl::vector<cl::Device>& sub_devices)
+{
+    cl_uint count = 0;
+    cl_int err = clCreateSubDevices(device(), properties, 0, nullptr, &count);
+    if (err != CL_SUCCESS) return err;
+
+    std::vector<cl_device_id> ids(count);
+    err = clCreateSubDevices(device(), properties, count, ids.data(), nullptr);
+    if (err != CL_SUCCESS) return err;
+
+    sub_devices.clear();
+    for (auto id : ids) sub_devices.push_back(cl::Device(id));
+    return CL_SUCCESS;
+}
+}
+
+std::vector<cl::size_type>
+cl::util::Partition::split(cl::size_type size,
+                           cl::size_type granularity) const
+{
+    const double total = std::accumulate(weights.begin(), weights.end(), 0.0);
+
+    std::vector<cl::size_type> boundaries{ 0 };
+    double cumulative = 0.0;
+    for (std::size_t i = 0; i < weights.size(); ++i)
+    {
+        cumulative += weights[i];
+        cl::size_type boundary = size;
+        if (i + 1 < weights.size() && total > 0.0)
+        {
+            const auto ideal = static_cast<cl::size_type>(
+                std::llround(static_cast<double>(size) * cumulative / total));
+            boundary = std::min(
+                std::max((ideal + granularity / 2) / granularity * granularity,
+                         boundaries.back()),
+                size);
+        }
+        boundaries.push_back(boundary);
+    }
+    return boundaries;
+}
+
+cl::util::Partition cl::util::partition_device(const cl::Device& device,
+                                               cl_uint fallback_count,
+                                               cl_int* error)
+{
+    Partition result{ {}, 0, 0, {} };
+
+    const auto schemes = device.getInfo<CL_DEVICE_PARTITION_PROPERTIES>();
+    auto supports = [&](cl_device_partition_property scheme) {
+        return std::find(schemes.begin(), schemes.end(), scheme)
+            != schemes.end();
+    };
+
+    // Partitions of a single sub-device are no use for distributing work.
+    auto try_partition = [&](std::vector<cl_device_partition_property> props,
+                             cl_device_affinity_domain domain) {
+        cl::vector<cl::Device> sub_devices;
+        if (create_sub_devices(device, props.data(), sub_devices) != CL_SUCCESS
+            || sub_devices.size() < 2)
+            return false;
+        result.sub_devices = sub_devices;
+        result.scheme = props.front();
+        result.affinity_domain = domain;
+        return true;
+    };
+
+    bool done = false;
+    if (supports(CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN))
+    {
+        const auto domains =
+            device.getInfo<CL_DEVICE_PARTITION_AFFINITY_DOMAIN>();
+        for (cl_device_affinity_domain domain :
+             { CL_DEVICE_AFFINITY_DOMAIN_NUMA,
+               CL_DEVICE_AFFINITY_DOMAIN_L3_CACHE })
+            if (!done && (domains & domain))
+                done = try_partition(
+                    { CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN,
+                      static_cast<cl_device_partition_property>(domain), 0 },
+                    domain);
+    }
+
+    const cl_uint compute_units = device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+    if (!done && fallback_count != 0 && compute_units >= fallback_count)
+    {
+        if (supports(CL_DEVICE_PARTITION_EQUALLY))
+            done = try_partition(
+                { CL_DEVICE_PARTITION_EQUALLY,
+                  static_cast<cl_device_partition_property>(compute_units
+                                                            / fallback_count),
+                  0 },
+                0);
+        // by counts also assigns leftover compute units
+        if (!done && supports(CL_DEVICE_PARTITION_BY_COUNTS))
+        {
+            std::vector<cl_device_partition_property> props{
+                CL_DEVICE_PARTITION_BY_COUNTS
+            };
+            for (cl_uint i = 0; i < fallback_count; ++i)
+                props.push_back(static_cast<cl_device_partition_property>(
+                    compute_units / fallback_count
+                    + (i < compute_units % fallback_count ? 1 : 0)));
+            props.push_back(CL_DEVICE_PARTITION_BY_COUNTS_LIST_END);
+            props.push_back(0);
+            done = try_partition(props, 0);
+        }
+    }
+
+    if (!done)
+    {
+        detail::errHandler(CL_DEVICE_PARTITION_FAILED, error,
+                           "Device does not support partitioning into more "
+                           "than one sub-device in "
+                           "cl::util::partition_device()");
+        return result;
+    }
+
+    for (const auto& sub_device : result.sub_devices)
+        result.weights.push_back(
+            sub_device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>());
+    const double total =
+        std::accumulate(result.weights.begin(), result.weights.end(), 0.0);
+    for (auto& weight : result.weights) weight /= total;
+
+    return result;
+}
+
+void cl::util::first_touch(const cl::Buffer& buffer,
+                           const std::vector<cl::CommandQueue>& queues,
+                           const std::vector<cl::size_type>& boundaries,
+                           cl_int* error)
+{
+    if (boundaries.size() != queues.size() + 1)
+    {
+        detail::errHandler(CL_INVALID_VALUE, error,
+                           "cl::util::first_touch() expects one more boundary "
+                           "than queues");
+        return;
+    }
+
+    std::vector<cl::Event> fills;
+    for (std::size_t i = 0; i < queues.size(); ++i)
+    {
+        if (boundaries[i + 1] <= boundaries[i]) continue;
+
+        cl::Event fill;
+        cl::CommandQueue queue = queues[i];
+        cl_int err = queue.enqueueFillBuffer(
+            buffer, cl_uchar{ 0 }, boundaries[i],
+            boundaries[i + 1] - boundaries[i], nullptr, &fill);
+        if (err != CL_SUCCESS)
+        {
+            detail::errHandler(err, error,
+                               "Failed to fill buffer in "
+                               "cl::util::first_touch()");
+            return;
+        }
+        fills.push_back(fill);
+    }
+
+    if (!fills.empty())
+    {
+        cl_int err = cl::WaitForEvents(fills);
+        if (err != CL_SUCCESS) detail::errHandler(err, error);
+    }
+}
+#endif
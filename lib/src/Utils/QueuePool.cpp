@@ -0,0 +1,132 @@
+#include <CL/Utils/QueuePool.hpp>
+
+#include <algorithm>
+
+namespace {
+bool completed(const cl::Event& event)
+{
+    cl_int status = CL_COMPLETE;
+    if (event() != nullptr)
+        clGetEventInfo(event(), CL_EVENT_COMMAND_EXECUTION_STATUS,
+                       sizeof(status), &status, nullptr);
+    return status <= CL_COMPLETE;
+}
+}
+
+cl::util::QueuePool::QueuePool(const cl::Context& context,
+                               const cl::Device& device, Mode mode,
+                               std::size_t count,
+                               cl_command_queue_properties properties)
+    : mode_{ mode }, next{ 0 }
+{
+    if (mode_ == Mode::OutOfOrder)
+    {
+        // The query is named CL_DEVICE_QUEUE_ON_HOST_PROPERTIES since OpenCL
+        // 2.0, with the same value.
+        cl_command_queue_properties supported = 0;
+        clGetDeviceInfo(device(), CL_DEVICE_QUEUE_PROPERTIES,
+                        sizeof(supported), &supported, nullptr);
+        if (supported & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE)
+            queues_.emplace_back(
+                context, device,
+                properties | CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE);
+        else
+            mode_ = Mode::InOrder;
+    }
+    if (mode_ == Mode::InOrder)
+        for (std::size_t i = 0; i < std::max<std::size_t>(count, 1); ++i)
+            queues_.emplace_back(context, device, properties);
+}
+
+cl::Event cl::util::QueuePool::submit(const std::vector<cl::Memory>& reads,
+                                      const std::vector<cl::Memory>& writes,
+                                      const Enqueue& enqueue, cl_int* error)
+{
+    // Collect the commands this one depends on, dropping completed ones.
+    std::vector<Use> dependencies;
+    auto depend = [&](const Use& use) {
+        if (use.event() != nullptr && !completed(use.event))
+            dependencies.push_back(use);
+    };
+    for (const auto& memory : reads)
+    {
+        auto it = accesses.find(memory());
+        if (it != accesses.end()) depend(it->second.write);
+    }
+    for (const auto& memory : writes)
+    {
+        auto it = accesses.find(memory());
+        if (it == accesses.end()) continue;
+        depend(it->second.write);
+        for (const auto& read : it->second.reads) depend(read);
+    }
+
+    // A command depending on commands of a single in-order queue only is
+    // enqueued after them on the same queue, which orders them without
+    // events. Independent commands are spread over the queues.
+    std::size_t queue = 0;
+    if (mode_ == Mode::InOrder)
+    {
+        const bool same_queue = !dependencies.empty()
+            && std::all_of(dependencies.begin(), dependencies.end(),
+                           [&](const Use& use) {
+                               return use.queue == dependencies.front().queue;
+                           });
+        if (same_queue)
+            queue = dependencies.front().queue;
+        else
+        {
+            queue = next;
+            next = (next + 1) % queues_.size();
+        }
+    }
+
+    // Commands of other queues the command waits for are flushed, otherwise
+    // they may never be submitted to the device and the wait never ends.
+    std::vector<cl::Event> wait;
+    for (const auto& use : dependencies)
+        if (mode_ == Mode::OutOfOrder || use.queue != queue)
+        {
+            if (use.queue != queue) queues_[use.queue].flush();
+            wait.push_back(use.event);
+        }
+
+    cl::Event event = enqueue(queues_[queue], wait);
+    if (event() == nullptr)
+    {
+        detail::errHandler(CL_INVALID_EVENT, error,
+                           "cl::util::QueuePool::submit() enqueue did not "
+                           "return the event of the command");
+        return event;
+    }
+
+    const Use use{ event, queue };
+    for (const auto& memory : reads)
+    {
+        auto& reads_since = accesses[memory()].reads;
+        reads_since.erase(std::remove_if(reads_since.begin(),
+                                         reads_since.end(),
+                                         [](const Use& read) {
+                                             return completed(read.event);
+                                         }),
+                          reads_since.end());
+        reads_since.push_back(use);
+    }
+    // Commands reading memory written by this command wait for this
+    // command, which waited for the previous readers and writer.
+    for (const auto& memory : writes) accesses[memory()] = Access{ use, {} };
+
+    if (error != nullptr) *error = CL_SUCCESS;
+    return event;
+}
+
+void cl::util::QueuePool::flush()
+{
+    for (auto& queue : queues_) queue.flush();
+}
+
+void cl::util::QueuePool::finish()
+{
+    for (auto& queue : queues_) queue.finish();
+    accesses.clear();
+}
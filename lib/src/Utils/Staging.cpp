@@ -0,0 +1,157 @@
+#include <CL/Utils/Staging.hpp>
+
+#include <algorithm>
+
+namespace {
+// Smaller blocks are rounded up to a page, pinning less is not possible.
+constexpr cl::size_type min_size_class = 4096;
+}
+
+cl::util::StagingPool::Block::Block(StagingPool* pool,
+                                    std::unique_ptr<Entry> entry)
+    : pool{ pool }, entry{ std::move(entry) }
+{}
+
+cl::util::StagingPool::Block::Block(Block&& other) noexcept
+    : pool{ other.pool }, entry{ std::move(other.entry) }
+{}
+
+cl::util::StagingPool::Block&
+cl::util::StagingPool::Block::operator=(Block&& other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        pool = other.pool;
+        entry = std::move(other.entry);
+    }
+    return *this;
+}
+
+cl::util::StagingPool::Block::~Block() { release(); }
+
+void cl::util::StagingPool::Block::fence(const cl::Event& event)
+{
+    if (entry) entry->fence = event;
+}
+
+void cl::util::StagingPool::Block::release()
+{
+    if (entry) pool->recycle(std::move(entry));
+}
+
+cl::util::StagingPool::StagingPool(const cl::Context& context,
+                                   const cl::CommandQueue& queue)
+    : context{ context }, queue{ queue }, stats{ 0, 0, 0, 0 }
+{}
+
+cl::util::StagingPool::~StagingPool() { trim(); }
+
+cl::size_type cl::util::StagingPool::size_class(cl::size_type size)
+{
+    cl::size_type result = min_size_class;
+    while (result < size) result *= 2;
+    return result;
+}
+
+cl::util::StagingPool::Block cl::util::StagingPool::acquire(cl::size_type size,
+                                                            cl_int* error)
+{
+    const cl::size_type bytes = size_class(size);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto& entries = free_blocks[bytes];
+        // Prefer the most recently released block, its pages are likely to
+        // be cached. Blocks whose fence has not completed are skipped.
+        for (auto it = entries.rbegin(); it != entries.rend(); ++it)
+        {
+            cl_int status = CL_COMPLETE;
+            if ((*it)->fence() != nullptr)
+                clGetEventInfo((*it)->fence(),
+                               CL_EVENT_COMMAND_EXECUTION_STATUS,
+                               sizeof(status), &status, nullptr);
+            if (status > CL_COMPLETE) continue;
+
+            std::unique_ptr<Entry> entry = std::move(*it);
+            entries.erase(std::next(it).base());
+            entry->fence = cl::Event{};
+            ++stats.reuses;
+            if (error != nullptr) *error = CL_SUCCESS;
+            return Block{ this, std::move(entry) };
+        }
+    }
+
+    // Unlike the cl::Buffer constructor, the C API never throws, so that
+    // errors may be reported through error.
+    cl_int err = CL_SUCCESS;
+    cl_mem mem =
+        clCreateBuffer(context(), CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR,
+                       bytes, nullptr, &err);
+    if (err != CL_SUCCESS)
+    {
+        detail::errHandler(err, error,
+                           "Failed to create buffer in "
+                           "cl::util::StagingPool::acquire()");
+        return Block{};
+    }
+    cl::Buffer buffer{ mem };
+
+    void* data = clEnqueueMapBuffer(queue(), mem, CL_TRUE,
+                                    CL_MAP_READ | CL_MAP_WRITE, 0, bytes, 0,
+                                    nullptr, nullptr, &err);
+    if (err != CL_SUCCESS)
+    {
+        detail::errHandler(err, error,
+                           "Failed to map buffer in "
+                           "cl::util::StagingPool::acquire()");
+        return Block{};
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++stats.allocations;
+        stats.bytes += bytes;
+        stats.high_water = std::max(stats.high_water, stats.bytes);
+    }
+    if (error != nullptr) *error = CL_SUCCESS;
+    return Block{ this,
+                  std::unique_ptr<Entry>(
+                      new Entry{ buffer, data, bytes, cl::Event{} }) };
+}
+
+void cl::util::StagingPool::trim()
+{
+    std::map<cl::size_type, EntryList> entries;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::swap(entries, free_blocks);
+        for (const auto& bucket : entries)
+            stats.bytes -= bucket.first * bucket.second.size();
+    }
+
+    for (auto& bucket : entries) unmap(bucket.second);
+    clFinish(queue());
+}
+
+cl::util::StagingPool::Statistics cl::util::StagingPool::statistics() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void cl::util::StagingPool::recycle(std::unique_ptr<Entry> entry)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    free_blocks[entry->size].push_back(std::move(entry));
+}
+
+void cl::util::StagingPool::unmap(EntryList& entries)
+{
+    for (auto& entry : entries)
+    {
+        cl_event fence = entry->fence();
+        if (fence != nullptr) clWaitForEvents(1, &fence);
+        clEnqueueUnmapMemObject(queue(), entry->buffer(), entry->data, 0,
+                                nullptr, nullptr);
+    }
+}
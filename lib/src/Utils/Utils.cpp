@@ -6,3 +6,6 @@
 #include "Device.cpp"
 #include "Context.cpp"
 #include "File.cpp"
+#include "Staging.cpp"
+#include "Arena.cpp"
+#include "QueuePool.cpp"
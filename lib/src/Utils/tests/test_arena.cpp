@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2026 The Khronos Group Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// OpenCL Utils includes
+#include <CL/Utils/Arena.hpp>
+#include <CL/Utils/Context.hpp>
+
+// STL includes
+#include <cstdint> // std::uintptr_t
+#include <cstdlib> // EXIT_FAILURE
+#include <iostream>
+#include <stdexcept> // std::runtime_error
+#include <vector>
+
+namespace {
+void check(bool condition, const char* message)
+{
+    if (!condition) throw std::runtime_error{ message };
+}
+
+// Allocates sub-buffers of odd sizes, some larger than a block, fills every
+// one with its index and reads them back, so that overlapping allocations
+// are detected.
+void test_buffer_arena(const cl::Context& context, cl::CommandQueue& queue)
+{
+    const cl::size_type block_size = 64 * 1024;
+    cl::util::BufferArena arena{ context, block_size };
+    const cl::size_type alignment = arena.alignment();
+    check(alignment != 0 && (alignment & (alignment - 1)) == 0,
+          "alignment is not a power of two");
+
+    const std::vector<cl::size_type> sizes{ 4, 1000, 40'000, 100'000, 12 };
+    cl::size_type total = 0;
+    {
+        std::vector<cl::Buffer> buffers;
+        for (std::size_t i = 0; i < sizes.size(); ++i)
+        {
+            cl::Buffer buffer = arena.allocate(sizes[i]);
+            check(buffer.getInfo<CL_MEM_SIZE>() == sizes[i],
+                  "sub-buffer has the wrong size");
+            check(buffer.getInfo<CL_MEM_OFFSET>() % alignment == 0,
+                  "sub-buffer is misaligned");
+            queue.enqueueFillBuffer(buffer, static_cast<cl_uchar>(i + 1), 0,
+                                    sizes[i]);
+            buffers.push_back(buffer);
+            total += sizes[i];
+        }
+        for (std::size_t i = 0; i < sizes.size(); ++i)
+        {
+            std::vector<cl_uchar> data(sizes[i]);
+            queue.enqueueReadBuffer(buffers[i], CL_TRUE, 0, sizes[i],
+                                    data.data());
+            for (cl_uchar value : data)
+                check(value == i + 1, "sub-buffers overlap");
+        }
+    }
+
+    const cl::util::ArenaStatistics stats = arena.statistics();
+    check(stats.allocations == sizes.size(), "wrong number of allocations");
+    check(stats.in_use == total && stats.high_water == total,
+          "wrong number of bytes in use");
+    check(stats.capacity >= total + block_size, "capacity too small");
+
+    // After a reset the same allocations fit in the blocks already there.
+    arena.reset();
+    check(arena.statistics().in_use == 0 && arena.statistics().resets == 1,
+          "reset did not release the memory");
+    for (cl::size_type size : sizes) arena.allocate(size);
+    check(arena.statistics().capacity == stats.capacity,
+          "reset did not reuse the blocks");
+    check(arena.statistics().high_water == total, "wrong high-water mark");
+
+    // leaks is a heuristic based on reference counts, which runtimes may
+    // hold on their own, so it is not checked.
+    arena.reset();
+    check(arena.statistics().resets == 2, "second reset not counted");
+
+    bool rejected = false;
+    try
+    {
+        cl_int error = CL_SUCCESS;
+        arena.allocate(0, &error);
+        rejected = error == CL_INVALID_BUFFER_SIZE;
+    } catch (cl::util::Error& e)
+    {
+        rejected = e.err() == CL_INVALID_BUFFER_SIZE;
+    }
+    check(rejected, "empty allocation accepted");
+}
+
+#ifdef CL_VERSION_2_0
+void test_svm_arena(const cl::Context& context)
+{
+    if (!cl::util::SVMArena::supported(context))
+    {
+        std::cout << "SVM is not supported, skipping the SVM arena."
+                  << std::endl;
+        return;
+    }
+
+    cl::util::SVMArena arena{ context, 4096 };
+    const auto alignment = static_cast<std::uintptr_t>(arena.alignment());
+    char* first = static_cast<char*>(arena.allocate(3));
+    char* second = static_cast<char*>(arena.allocate(100));
+    char* large = static_cast<char*>(arena.allocate(10'000));
+    for (char* ptr : { first, second, large })
+        check(ptr != nullptr
+                  && reinterpret_cast<std::uintptr_t>(ptr) % alignment == 0,
+              "SVM allocation is misaligned");
+    check(second >= first + 3, "SVM allocations overlap");
+    check(arena.statistics().in_use == 10'103, "wrong number of bytes in use");
+
+    arena.reset();
+    check(arena.allocate(3) == first, "reset did not reuse the SVM blocks");
+}
+#endif
+}
+
+int main()
+{
+    try
+    {
+        cl::Context context =
+            cl::util::get_context(0, 0, CL_DEVICE_TYPE_DEFAULT);
+        cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>().at(0);
+        cl::CommandQueue queue{ context, device };
+
+        test_buffer_arena(context, queue);
+#ifdef CL_VERSION_2_0
+        test_svm_arena(context);
+#endif
+        std::cout << "Arena tests passed." << std::endl;
+        return 0;
+    } catch (cl::util::Error& e)
+    {
+        std::cerr << "OpenCL Utils error: " << e.what() << std::endl;
+    } catch (cl::Error& e)
+    {
+        std::cerr << "OpenCL runtime error: " << e.what() << std::endl;
+    } catch (std::exception& e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+    }
+    return EXIT_FAILURE;
+}
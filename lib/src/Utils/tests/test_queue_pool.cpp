@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2026 The Khronos Group Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// OpenCL Utils includes
+#include <CL/Utils/Context.hpp>
+#include <CL/Utils/QueuePool.hpp>
+
+// STL includes
+#include <cstdlib> // EXIT_FAILURE
+#include <iostream>
+#include <stdexcept> // std::runtime_error
+#include <vector>
+
+namespace {
+void check(bool condition, const char* message)
+{
+    if (!condition) throw std::runtime_error{ message };
+}
+
+// Fills a and b on different queues, copies b to a, which waits for both
+// fills, and reads a back. Only the pool flushes the queues, so in in-order
+// mode the copy waits for a command of a queue nothing else flushes. The
+// fills wait for a user event set once the copy is submitted, otherwise the
+// pool would drop them from the wait list of the copy if they completed.
+void test_chain(const cl::Context& context, const cl::Device& device,
+                cl::util::QueuePool::Mode mode)
+{
+    const cl::size_type count = 1024, bytes = count * sizeof(cl_int);
+    cl::Buffer a{ context, CL_MEM_READ_WRITE, bytes },
+        b{ context, CL_MEM_READ_WRITE, bytes };
+    cl::util::QueuePool pool{ context, device, mode, 2 };
+    cl::UserEvent gate{ context };
+
+    auto fill = [&](cl::Buffer& buffer, cl_int value) {
+        return pool.submit(
+            {}, { buffer },
+            [&](cl::CommandQueue& queue, const std::vector<cl::Event>& wait) {
+                std::vector<cl::Event> gated = wait;
+                gated.push_back(gate);
+                cl::Event event;
+                queue.enqueueFillBuffer(buffer, value, 0, bytes, &gated,
+                                        &event);
+                return event;
+            });
+    };
+    fill(a, 1);
+    fill(b, 2);
+
+    std::size_t copy_waits = 0;
+    pool.submit(
+        { b }, { a },
+        [&](cl::CommandQueue& queue, const std::vector<cl::Event>& wait) {
+            copy_waits = wait.size();
+            cl::Event event;
+            queue.enqueueCopyBuffer(b, a, 0, 0, bytes, &wait, &event);
+            return event;
+        });
+    gate.setStatus(CL_COMPLETE);
+    if (pool.mode() == cl::util::QueuePool::Mode::InOrder)
+        check(copy_waits == 1, "copy does not wait for the other queue");
+    else
+        check(copy_waits == 2, "copy does not wait for both fills");
+
+    std::vector<cl_int> result(count);
+    pool.submit({ a }, {},
+                [&](cl::CommandQueue& queue,
+                    const std::vector<cl::Event>& wait) {
+                    cl::Event event;
+                    queue.enqueueReadBuffer(a, CL_FALSE, 0, bytes,
+                                            result.data(), &wait, &event);
+                    return event;
+                })
+        .wait();
+    for (cl_int value : result)
+        check(value == 2, "copy did not follow both fills");
+
+    pool.finish();
+}
+}
+
+int main()
+{
+    try
+    {
+        cl::Context context =
+            cl::util::get_context(0, 0, CL_DEVICE_TYPE_DEFAULT);
+        cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>().at(0);
+
+        test_chain(context, device, cl::util::QueuePool::Mode::InOrder);
+        test_chain(context, device, cl::util::QueuePool::Mode::OutOfOrder);
+        std::cout << "Queue pool tests passed." << std::endl;
+        return 0;
+    } catch (cl::util::Error& e)
+    {
+        std::cerr << "OpenCL Utils error: " << e.what() << std::endl;
+    } catch (cl::Error& e)
+    {
+        std::cerr << "OpenCL runtime error: " << e.what() << std::endl;
+    } catch (std::exception& e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+    }
+    return EXIT_FAILURE;
+}
@@ -1,3 +1,7 @@
+// Image based kernels are only compiled for devices supporting images, the
+// buffer based ones at the end of the file are available everywhere.
+#if defined(__IMAGE_SUPPORT__)
+
 kernel void blur_box(
     read_only image2d_t input_image,
     write_only image2d_t output_image,
@@ -71,6 +75,92 @@ kernel void blur_box_vertical(
 }
 
 
+kernel void blur_box_horizontal_running_sum(
+    read_only image2d_t input_image,
+    write_only image2d_t output_image,
+    int size,
+    int segment
+)
+{
+    const int width = get_image_width(input_image);
+    const int height = get_image_height(input_image);
+    // rows are spread along dimension 0, segments of a row along dimension 1
+    const int y = get_global_id(0);
+    const int start = get_global_id(1) * segment;
+    const int end = min(start + segment, width);
+
+    if ((y >= height) || (start >= width))
+        return;
+
+    // sum up the window of the first pixel of the segment
+    uint4 sum = 0;
+    uint num = 0;
+    for (int x = max(start - size, 0); x <= min(start + size, width - 1); ++x) {
+        ++num;
+        sum += read_imageui(input_image, (int2)(x, y));
+    }
+
+    // slide the window: add the entering pixel and subtract the leaving one
+    for (int x = start; x < end; ++x) {
+        write_imageui(output_image, (int2)(x, y), (sum + num / 2) / num);
+
+        const int enter = x + size + 1;
+        const int leave = x - size;
+        if (enter < width) {
+            ++num;
+            sum += read_imageui(input_image, (int2)(enter, y));
+        }
+        if (leave >= 0) {
+            --num;
+            sum -= read_imageui(input_image, (int2)(leave, y));
+        }
+    }
+}
+
+kernel void blur_box_vertical_running_sum(
+    read_only image2d_t input_image,
+    write_only image2d_t output_image,
+    int size,
+    int segment
+)
+{
+    const int width = get_image_width(input_image);
+    const int height = get_image_height(input_image);
+    // columns are spread along dimension 0, segments of a column along
+    // dimension 1
+    const int x = get_global_id(0);
+    const int start = get_global_id(1) * segment;
+    const int end = min(start + segment, height);
+
+    if ((x >= width) || (start >= height))
+        return;
+
+    // sum up the window of the first pixel of the segment
+    uint4 sum = 0;
+    uint num = 0;
+    for (int y = max(start - size, 0); y <= min(start + size, height - 1); ++y) {
+        ++num;
+        sum += read_imageui(input_image, (int2)(x, y));
+    }
+
+    // slide the window: add the entering pixel and subtract the leaving one
+    for (int y = start; y < end; ++y) {
+        write_imageui(output_image, (int2)(x, y), (sum + num / 2) / num);
+
+        const int enter = y + size + 1;
+        const int leave = y - size;
+        if (enter < height) {
+            ++num;
+            sum += read_imageui(input_image, (int2)(x, enter));
+        }
+        if (leave >= 0) {
+            --num;
+            sum -= read_imageui(input_image, (int2)(x, leave));
+        }
+    }
+}
+
+
 kernel void blur_kernel_horizontal(
     read_only image2d_t input_image,
     write_only image2d_t output_image,
@@ -123,6 +213,122 @@ kernel void blur_kernel_vertical(
 }
 
 
+// Variants of the kernel blur keeping the intermediate result between the
+// passes unquantized, either in a floating point image (CL_HALF_FLOAT or
+// CL_FLOAT) or in a buffer of float planes, one per channel.
+
+kernel void blur_kernel_horizontal_to_float(
+    read_only image2d_t input_image,
+    write_only image2d_t temp_image,
+    int size,
+    constant float * kern
+)
+{
+    const int width = get_image_width(input_image);
+    const int height = get_image_height(input_image);
+    const int2 coord = { get_global_id(0), get_global_id(1) };
+
+    float4 sum = 0;
+    float weight = 0;
+    int2 shift = 0;
+    for (shift.x = -size; shift.x <= size; ++shift.x) {
+        int2 cur = coord + shift;
+        if ((0 <= cur.x) && (cur.x < width)) {
+            const float w = kern[size + shift.x];
+            weight += w;
+            sum += convert_float4(read_imageui(input_image, cur)) * w;
+        }
+    }
+    write_imagef(temp_image, coord, sum / weight);
+}
+
+kernel void blur_kernel_vertical_from_float(
+    read_only image2d_t temp_image,
+    write_only image2d_t output_image,
+    int size,
+    constant float * kern
+)
+{
+    const int width = get_image_width(temp_image);
+    const int height = get_image_height(temp_image);
+    const int2 coord = { get_global_id(0), get_global_id(1) };
+
+    float4 sum = 0;
+    float weight = 0;
+    int2 shift = 0;
+    for (shift.y = -size; shift.y <= size; ++shift.y) {
+        int2 cur = coord + shift;
+        if ((0 <= cur.y) && (cur.y < height)) {
+            const float w = kern[size + shift.y];
+            weight += w;
+            sum += read_imagef(temp_image, cur) * w;
+        }
+    }
+    write_imageui(output_image, coord, convert_uint4(round(sum / weight)));
+}
+
+kernel void blur_kernel_horizontal_to_planar(
+    read_only image2d_t input_image,
+    global float * planes,
+    int size,
+    constant float * kern
+)
+{
+    const int width = get_image_width(input_image);
+    const int height = get_image_height(input_image);
+    const int2 coord = { get_global_id(0), get_global_id(1) };
+
+    float4 sum = 0;
+    float weight = 0;
+    int2 shift = 0;
+    for (shift.x = -size; shift.x <= size; ++shift.x) {
+        int2 cur = coord + shift;
+        if ((0 <= cur.x) && (cur.x < width)) {
+            const float w = kern[size + shift.x];
+            weight += w;
+            sum += convert_float4(read_imageui(input_image, cur)) * w;
+        }
+    }
+    sum /= weight;
+
+    // every channel is stored in its own plane of width * height floats
+    const int plane = width * height;
+    const int pos = coord.y * width + coord.x;
+    planes[pos] = sum.x;
+    planes[plane + pos] = sum.y;
+    planes[2 * plane + pos] = sum.z;
+    planes[3 * plane + pos] = sum.w;
+}
+
+kernel void blur_kernel_vertical_from_planar(
+    global const float * planes,
+    write_only image2d_t output_image,
+    int size,
+    constant float * kern
+)
+{
+    const int width = get_image_width(output_image);
+    const int height = get_image_height(output_image);
+    const int2 coord = { get_global_id(0), get_global_id(1) };
+    const int plane = width * height;
+
+    float4 sum = 0;
+    float weight = 0;
+    int2 shift = 0;
+    for (shift.y = -size; shift.y <= size; ++shift.y) {
+        int2 cur = coord + shift;
+        if ((0 <= cur.y) && (cur.y < height)) {
+            const float w = kern[size + shift.y];
+            const int pos = cur.y * width + cur.x;
+            weight += w;
+            sum += (float4)(planes[pos], planes[plane + pos],
+                            planes[2 * plane + pos], planes[3 * plane + pos]) * w;
+        }
+    }
+    write_imageui(output_image, coord, convert_uint4(round(sum / weight)));
+}
+
+
 kernel void blur_box_horizontal_exchange(
     read_only image2d_t input_image,
     write_only image2d_t output_image,
@@ -509,3 +715,132 @@ kernel void blur_kernel_vertical_subgroup_exchange(
 }
 
 #endif // USE_SUBGROUP_EXCHANGE_RELATIVE || USE_SUBGROUP_EXCHANGE
+
+#endif // __IMAGE_SUPPORT__
+
+
+// Buffer based kernels. Pixels are stored as rows of tightly packed uchar4
+// values and the edges of the image are handled in code by clamping the
+// window to the image. Just like with the image kernels, pixels outside of
+// the image are left out of the average.
+
+kernel void blur_box_buffer(
+    global const uchar4 * input,
+    global uchar4 * output,
+    int width,
+    int height,
+    int size
+)
+{
+    const int2 coord = { get_global_id(0), get_global_id(1) };
+    if ((coord.x >= width) || (coord.y >= height))
+        return;
+
+    const int2 first = max(coord - size, 0);
+    const int2 last = min(coord + size, (int2)(width - 1, height - 1));
+
+    uint4 sum = 0;
+    for (int y = first.y; y <= last.y; ++y)
+        for (int x = first.x; x <= last.x; ++x)
+            sum += convert_uint4(input[y * width + x]);
+    const uint num = (last.x - first.x + 1) * (last.y - first.y + 1);
+    output[coord.y * width + coord.x] = convert_uchar4_sat((sum + num / 2) / num);
+}
+
+kernel void blur_box_horizontal_buffer(
+    global const uchar4 * input,
+    global uchar4 * output,
+    int width,
+    int height,
+    int size
+)
+{
+    const int2 coord = { get_global_id(0), get_global_id(1) };
+    if ((coord.x >= width) || (coord.y >= height))
+        return;
+
+    const int first = max(coord.x - size, 0);
+    const int last = min(coord.x + size, width - 1);
+    global const uchar4 * row = input + coord.y * width;
+
+    uint4 sum = 0;
+    for (int x = first; x <= last; ++x)
+        sum += convert_uint4(row[x]);
+    const uint num = last - first + 1;
+    output[coord.y * width + coord.x] = convert_uchar4_sat((sum + num / 2) / num);
+}
+
+kernel void blur_box_vertical_buffer(
+    global const uchar4 * input,
+    global uchar4 * output,
+    int width,
+    int height,
+    int size
+)
+{
+    const int2 coord = { get_global_id(0), get_global_id(1) };
+    if ((coord.x >= width) || (coord.y >= height))
+        return;
+
+    const int first = max(coord.y - size, 0);
+    const int last = min(coord.y + size, height - 1);
+
+    uint4 sum = 0;
+    for (int y = first; y <= last; ++y)
+        sum += convert_uint4(input[y * width + coord.x]);
+    const uint num = last - first + 1;
+    output[coord.y * width + coord.x] = convert_uchar4_sat((sum + num / 2) / num);
+}
+
+kernel void blur_kernel_horizontal_buffer(
+    global const uchar4 * input,
+    global uchar4 * output,
+    int width,
+    int height,
+    int size,
+    constant float * kern
+)
+{
+    const int2 coord = { get_global_id(0), get_global_id(1) };
+    if ((coord.x >= width) || (coord.y >= height))
+        return;
+
+    const int first = max(coord.x - size, 0);
+    const int last = min(coord.x + size, width - 1);
+    global const uchar4 * row = input + coord.y * width;
+
+    float4 sum = 0;
+    float weight = 0;
+    for (int x = first; x <= last; ++x) {
+        const float w = kern[size + x - coord.x];
+        weight += w;
+        sum += convert_float4(row[x]) * w;
+    }
+    output[coord.y * width + coord.x] = convert_uchar4_sat(round(sum / weight));
+}
+
+kernel void blur_kernel_vertical_buffer(
+    global const uchar4 * input,
+    global uchar4 * output,
+    int width,
+    int height,
+    int size,
+    constant float * kern
+)
+{
+    const int2 coord = { get_global_id(0), get_global_id(1) };
+    if ((coord.x >= width) || (coord.y >= height))
+        return;
+
+    const int first = max(coord.y - size, 0);
+    const int last = min(coord.y + size, height - 1);
+
+    float4 sum = 0;
+    float weight = 0;
+    for (int y = first; y <= last; ++y) {
+        const float w = kern[size + y - coord.y];
+        weight += w;
+        sum += convert_float4(input[y * width + coord.x]) * w;
+    }
+    output[coord.y * width + coord.x] = convert_uchar4_sat(round(sum / weight));
+}
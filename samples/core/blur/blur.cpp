@@ -18,10 +18,12 @@
 #include <CL/Utils/Utils.hpp>
 #include <CL/SDK/Context.hpp>
 #include <CL/SDK/CLI.hpp>
+#include <CL/SDK/ImagePipeline.hpp>
 
 // standard includes
 #include <algorithm>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <random>
 #include <sstream>
@@ -37,10 +39,18 @@
 #include "default_image.h"
 
 std::unique_ptr<TCLAP::ValuesConstraint<std::string>> valid_op_constraint;
+std::unique_ptr<TCLAP::ValuesConstraint<std::string>>
+    valid_intermediate_constraint;
 
 // Add option to CLI parsing SDK utility
 template <> auto cl::sdk::parse<BlurCppExample::BlurOptions>()
 {
+    std::vector<std::string> valid_intermediate_strings{ "uint8", "half",
+                                                         "float" };
+    valid_intermediate_constraint =
+        std::make_unique<TCLAP::ValuesConstraint<std::string>>(
+            valid_intermediate_strings);
+
     return std::make_tuple(
         std::make_shared<TCLAP::ValueArg<std::string>>(
             "i", "in", "Input image file", false, "", "name"),
@@ -50,8 +60,13 @@ template <> auto cl::sdk::parse<BlurCppExample::BlurOptions>()
                                                  "Size of blur kernel", false,
                                                  (float)1.0, "positive float"),
         std::make_shared<TCLAP::MultiArg<std::string>>(
-            "b", "blur", "Operation of blur to perform: box or gauss", false,
-            "box"));
+            "b", "blur",
+            "Operation of blur to perform: box, sliding, gauss, buffer or "
+            "pipeline", false, "box"),
+        std::make_shared<TCLAP::ValueArg<std::string>>(
+            "f", "intermediate",
+            "Storage of intermediate results between blur passes", false,
+            "uint8", valid_intermediate_constraint.get()));
 }
 
 template <>
@@ -59,11 +74,13 @@ BlurCppExample::BlurOptions cl::sdk::comprehend<BlurCppExample::BlurOptions>(
     std::shared_ptr<TCLAP::ValueArg<std::string>> in_arg,
     std::shared_ptr<TCLAP::ValueArg<std::string>> out_arg,
     std::shared_ptr<TCLAP::ValueArg<float>> size_arg,
-    std::shared_ptr<TCLAP::MultiArg<std::string>> op_arg)
+    std::shared_ptr<TCLAP::MultiArg<std::string>> op_arg,
+    std::shared_ptr<TCLAP::ValueArg<std::string>> intermediate_arg)
 {
     return BlurCppExample::BlurOptions{ in_arg->getValue(), out_arg->getValue(),
                                         size_arg->getValue(),
-                                        op_arg->getValue() };
+                                        op_arg->getValue(),
+                                        intermediate_arg->getValue() };
 }
 
 void BlurCppExample::single_pass_box_blur()
@@ -253,6 +270,104 @@ void BlurCppExample::dual_pass_subgroup_exchange_box_blur()
     finalize_blur();
 }
 
+void BlurCppExample::dual_pass_running_sum_box_blur()
+{
+    std::cout << "Dual-pass running-sum blur" << std::endl;
+    step++;
+
+    auto size = static_cast<cl_int>(blur_opts.size);
+    // Every work-item slides the window along a segment of a row or column.
+    // Priming the window costs 2*size+1 reads per segment, so segments are
+    // kept at least that long to amortize it over the pixels of the segment.
+    auto segment = std::max<cl_int>(2 * size + 1, 32);
+
+    // create kernels
+    auto blur1 = cl::KernelFunctor<cl::Memory, cl::Memory, cl_int, cl_int>(
+        program, "blur_box_horizontal_running_sum");
+    auto blur2 = cl::KernelFunctor<cl::Memory, cl::Memory, cl_int, cl_int>(
+        program, "blur_box_vertical_running_sum");
+
+    // blur
+    std::vector<cl::Event> passes;
+    auto start = std::chrono::high_resolution_clock::now();
+
+    cl::NDRange work_size1{ height, (width + segment - 1) / segment };
+    passes.push_back(blur1(cl::EnqueueArgs{ queue, work_size1 },
+                           input_image_buf, temp_image_buf, size, segment));
+
+    cl::NDRange work_size2{ width, (height + segment - 1) / segment };
+    passes.push_back(blur2(cl::EnqueueArgs{ queue, work_size2 },
+                           temp_image_buf, output_image_buf, size, segment));
+
+    cl::WaitForEvents(passes);
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    cl::enqueueReadImage(output_image_buf, CL_BLOCKING, origin, image_size, 0,
+                         0, output_image.pixels.data());
+
+    if (verbose) print_timings(end - start, passes);
+
+    // write output file
+    finalize_blur();
+}
+
+void BlurCppExample::pipeline_blur_sharpen_tone_map()
+{
+    auto size = static_cast<cl_int>(blur_opts.size);
+
+    // blur stages are the kernels of blur.cl, the pipeline sets their images
+    cl::Kernel blur1(program, "blur_box_horizontal");
+    cl::Kernel blur2(program, "blur_box_vertical");
+    blur1.setArg(2, size);
+    blur2.setArg(2, size);
+
+    // sharpen and tone map are functions composed into generated kernels
+    const std::string filters = cl::util::read_text_file("./filters.cl");
+
+    for (bool fuse : { false, true })
+    {
+        std::cout << (fuse ? "Fused" : "Unfused")
+                  << " pipeline of blur, sharpen and tone map" << std::endl;
+        step++;
+
+        cl::sdk::ImagePipeline pipeline(context, device, queue);
+        pipeline.add_kernel("blur horizontal", blur1)
+            .add_kernel("blur vertical", blur2)
+            .add_stencil("sharpen", filters, "sharpen")
+            .add_point("tone map", filters, "tone_map");
+        pipeline.build(fuse);
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        auto passes = pipeline.run(input_image_buf, output_image_buf);
+        std::vector<cl::Event> events;
+        for (auto& pass : passes) events.push_back(pass.event);
+        cl::WaitForEvents(events);
+
+        auto end = std::chrono::high_resolution_clock::now();
+
+        cl::enqueueReadImage(output_image_buf, CL_BLOCKING, origin,
+                             image_size, 0, 0, output_image.pixels.data());
+
+        if (verbose)
+        {
+            for (auto& pass : passes)
+                std::cout << "  - " << pass.name << ": "
+                          << cl::util::get_duration<CL_PROFILING_COMMAND_START,
+                                                    CL_PROFILING_COMMAND_END,
+                                                    std::chrono::microseconds>(
+                                 pass.event)
+                                 .count()
+                          << " us" << std::endl;
+            print_timings(end - start, events);
+        }
+
+        // write output file
+        finalize_blur();
+    }
+}
+
 void BlurCppExample::dual_pass_kernel_blur()
 {
     step++;
@@ -291,6 +406,159 @@ void BlurCppExample::dual_pass_kernel_blur()
     finalize_blur();
 }
 
+void BlurCppExample::dual_pass_box_blur_intermediate()
+{
+    if (blur_opts.intermediate == "uint8") return;
+
+    std::cout << "Dual-pass blur with " << blur_opts.intermediate
+              << " intermediate" << std::endl;
+
+    // box blur is a kernel blur with equal weights
+    auto size = static_cast<cl_int>(blur_opts.size);
+    dual_pass_intermediate_blur(std::vector<float>(2 * size + 1, 1.f), size);
+}
+
+void BlurCppExample::dual_pass_kernel_blur_intermediate()
+{
+    if (blur_opts.intermediate == "uint8") return;
+
+    std::cout << "Dual-pass Gaussian blur with " << blur_opts.intermediate
+              << " intermediate" << std::endl;
+
+    dual_pass_intermediate_blur(
+        std::vector<float>(gauss_kernel, gauss_kernel + 2 * gauss_size + 1),
+        gauss_size);
+}
+
+void BlurCppExample::dual_pass_intermediate_blur(
+    const std::vector<float>& weights, cl_int size)
+{
+    step++;
+
+    cl::Buffer kern(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                    sizeof(float) * weights.size(),
+                    const_cast<float*>(weights.data()));
+
+    // reference result without quantization between the passes
+    auto reference = reference_blur(weights, size);
+
+    // 1) current path: uint8 intermediate
+    auto blur1 = cl::KernelFunctor<cl::Memory, cl::Memory, cl_int, cl::Buffer>(
+        program, "blur_kernel_horizontal");
+    auto blur2 = cl::KernelFunctor<cl::Memory, cl::Memory, cl_int, cl::Buffer>(
+        program, "blur_kernel_vertical");
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<cl::Event> passes;
+
+    passes.push_back(
+        blur1(cl::EnqueueArgs{ queue, cl::NDRange{ width, height } },
+              input_image_buf, temp_image_buf, size, kern));
+
+    passes.push_back(
+        blur2(cl::EnqueueArgs{ queue, cl::NDRange{ width, height } },
+              temp_image_buf, output_image_buf, size, kern));
+
+    cl::WaitForEvents(passes);
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    cl::enqueueReadImage(output_image_buf, CL_BLOCKING, origin, image_size, 0,
+                         0, output_image.pixels.data());
+
+    std::cout << "uint8 intermediate:" << std::endl;
+    print_timings(end - start, passes);
+    print_psnr(reference);
+
+    // 2) selected path: half image or float planes
+    passes.clear();
+    // half images are read and written as float in kernels, so they don't
+    // depend on cl_khr_fp16, only on the image format being supported
+    const cl::ImageFormat half_format(CL_RGBA, CL_HALF_FLOAT);
+    cl::vector<cl::ImageFormat> formats;
+    context.getSupportedImageFormats(CL_MEM_READ_WRITE, CL_MEM_OBJECT_IMAGE2D,
+                                     &formats);
+    const bool half_supported =
+        std::any_of(formats.begin(), formats.end(),
+                    [&](const cl::ImageFormat& format) {
+                        return format.image_channel_order
+                            == half_format.image_channel_order
+                            && format.image_channel_data_type
+                            == half_format.image_channel_data_type;
+                    });
+    if (blur_opts.intermediate == "half" && !half_supported)
+    {
+        // the output of the uint8 path is still written
+        std::cout << "CL_RGBA, CL_HALF_FLOAT images are not supported on "
+                     "the device, skipping."
+                  << std::endl
+                  << std::endl;
+    }
+    else if (blur_opts.intermediate == "half")
+    {
+        cl::Image2D half_image_buf(
+            context, (cl_mem_flags)(CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS),
+            half_format, width, height);
+
+        auto half1 =
+            cl::KernelFunctor<cl::Memory, cl::Memory, cl_int, cl::Buffer>(
+                program, "blur_kernel_horizontal_to_float");
+        auto half2 =
+            cl::KernelFunctor<cl::Memory, cl::Memory, cl_int, cl::Buffer>(
+                program, "blur_kernel_vertical_from_float");
+
+        start = std::chrono::high_resolution_clock::now();
+
+        passes.push_back(
+            half1(cl::EnqueueArgs{ queue, cl::NDRange{ width, height } },
+                  input_image_buf, half_image_buf, size, kern));
+
+        passes.push_back(
+            half2(cl::EnqueueArgs{ queue, cl::NDRange{ width, height } },
+                  half_image_buf, output_image_buf, size, kern));
+    }
+    else
+    {
+        cl::Buffer planes(
+            context, (cl_mem_flags)(CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS),
+            4 * sizeof(cl_float) * width * height);
+
+        auto planar1 =
+            cl::KernelFunctor<cl::Memory, cl::Buffer, cl_int, cl::Buffer>(
+                program, "blur_kernel_horizontal_to_planar");
+        auto planar2 =
+            cl::KernelFunctor<cl::Buffer, cl::Memory, cl_int, cl::Buffer>(
+                program, "blur_kernel_vertical_from_planar");
+
+        start = std::chrono::high_resolution_clock::now();
+
+        passes.push_back(
+            planar1(cl::EnqueueArgs{ queue, cl::NDRange{ width, height } },
+                    input_image_buf, planes, size, kern));
+
+        passes.push_back(
+            planar2(cl::EnqueueArgs{ queue, cl::NDRange{ width, height } },
+                    planes, output_image_buf, size, kern));
+    }
+
+    if (!passes.empty())
+    {
+        cl::WaitForEvents(passes);
+
+        end = std::chrono::high_resolution_clock::now();
+
+        cl::enqueueReadImage(output_image_buf, CL_BLOCKING, origin, image_size,
+                             0, 0, output_image.pixels.data());
+
+        std::cout << blur_opts.intermediate << " intermediate:" << std::endl;
+        print_timings(end - start, passes);
+        print_psnr(reference);
+    }
+
+    // write output file
+    finalize_blur();
+}
+
 void BlurCppExample::dual_pass_local_memory_exchange_kernel_blur()
 {
     step++;
@@ -416,6 +684,119 @@ void BlurCppExample::dual_pass_subgroup_exchange_kernel_blur()
     finalize_blur();
 }
 
+void BlurCppExample::single_pass_box_blur_buffer()
+{
+    std::cout << "Single-pass buffer blur" << std::endl;
+    step++;
+
+    auto size = static_cast<cl_int>(blur_opts.size);
+    auto w = static_cast<cl_int>(width);
+    auto h = static_cast<cl_int>(height);
+    auto blur =
+        cl::KernelFunctor<cl::Buffer, cl::Buffer, cl_int, cl_int, cl_int>(
+            program, "blur_box_buffer");
+
+    // blur
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<cl::Event> passes;
+
+    passes.push_back(
+        blur(cl::EnqueueArgs{ queue, cl::NDRange{ width, height } },
+             input_pixel_buf, output_pixel_buf, w, h, size));
+
+    cl::WaitForEvents(passes);
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    read_output_pixels();
+
+    if (verbose) print_timings(end - start, passes);
+
+    // write output file
+    finalize_blur();
+}
+
+void BlurCppExample::dual_pass_box_blur_buffer()
+{
+    std::cout << "Dual-pass buffer blur" << std::endl;
+    step++;
+
+    auto size = static_cast<cl_int>(blur_opts.size);
+    auto w = static_cast<cl_int>(width);
+    auto h = static_cast<cl_int>(height);
+    auto blur1 =
+        cl::KernelFunctor<cl::Buffer, cl::Buffer, cl_int, cl_int, cl_int>(
+            program, "blur_box_horizontal_buffer");
+    auto blur2 =
+        cl::KernelFunctor<cl::Buffer, cl::Buffer, cl_int, cl_int, cl_int>(
+            program, "blur_box_vertical_buffer");
+
+    // blur
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<cl::Event> passes;
+
+    passes.push_back(
+        blur1(cl::EnqueueArgs{ queue, cl::NDRange{ width, height } },
+              input_pixel_buf, temp_pixel_buf, w, h, size));
+
+    passes.push_back(
+        blur2(cl::EnqueueArgs{ queue, cl::NDRange{ width, height } },
+              temp_pixel_buf, output_pixel_buf, w, h, size));
+
+    cl::WaitForEvents(passes);
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    read_output_pixels();
+
+    if (verbose) print_timings(end - start, passes);
+
+    // write output file
+    finalize_blur();
+}
+
+void BlurCppExample::dual_pass_kernel_blur_buffer()
+{
+    std::cout << "Dual-pass buffer Gaussian blur" << std::endl;
+    step++;
+
+    auto size = gauss_size;
+    auto& kern = gauss_kernel_buf;
+    auto w = static_cast<cl_int>(width);
+    auto h = static_cast<cl_int>(height);
+
+    // create kernels
+    auto blur1 = cl::KernelFunctor<cl::Buffer, cl::Buffer, cl_int, cl_int,
+                                   cl_int, cl::Buffer>(
+        program, "blur_kernel_horizontal_buffer");
+    auto blur2 = cl::KernelFunctor<cl::Buffer, cl::Buffer, cl_int, cl_int,
+                                   cl_int, cl::Buffer>(
+        program, "blur_kernel_vertical_buffer");
+
+    // blur
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<cl::Event> passes;
+
+    passes.push_back(
+        blur1(cl::EnqueueArgs{ queue, cl::NDRange{ width, height } },
+              input_pixel_buf, temp_pixel_buf, w, h, size, kern));
+
+    passes.push_back(
+        blur2(cl::EnqueueArgs{ queue, cl::NDRange{ width, height } },
+              temp_pixel_buf, output_pixel_buf, w, h, size, kern));
+
+    cl::WaitForEvents(passes);
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    read_output_pixels();
+
+    if (verbose) print_timings(end - start, passes);
+
+    // write output file
+    finalize_blur();
+}
+
 void BlurCppExample::load_device()
 {
     // Create context
@@ -493,15 +874,17 @@ bool opencl_version_contains(const cl::string& dev_version,
 
 std::tuple<bool, bool, bool, std::string> BlurCppExample::query_capabilities()
 {
-    // 1) query image support
-    if (!device.getInfo<CL_DEVICE_IMAGE_SUPPORT>())
+    // 1) query image support, without it only buffer based blurs are possible
+    image_support = device.getInfo<CL_DEVICE_IMAGE_SUPPORT>();
+    if (!image_support && !diag_opts.quiet)
     {
-        cl::util::detail::errHandler(CL_INVALID_DEVICE, nullptr,
-                                     "No image support on device!");
+        std::cout << "No image support on device, only buffer based blurs "
+                     "will be performed."
+                  << std::endl;
     }
 
     // 2) query if the image format is supported and change image if not
-    format = set_image_format();
+    if (image_support) format = set_image_format();
 
     // 3) query if device have local memory
     bool use_local_mem =
@@ -559,6 +942,33 @@ void BlurCppExample::create_image_buffers()
                           0, 0, input_image.pixels.data());
 }
 
+void BlurCppExample::create_pixel_buffers()
+{
+    // Buffer kernels always operate on 4 channels of uint8_t, the missing
+    // channels are filled with zeros.
+    const std::size_t pixels = width * height,
+                      pixel_size = input_image.pixel_size;
+    rgba_pixels.assign(4 * pixels, 0);
+    for (std::size_t i = 0; i < pixels; ++i)
+        memcpy(rgba_pixels.data() + 4 * i,
+               input_image.pixels.data() + pixel_size * i, pixel_size);
+
+    input_pixel_buf = cl::Buffer(
+        context, (cl_mem_flags)(CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY),
+        rgba_pixels.size());
+
+    output_pixel_buf = cl::Buffer(
+        context, (cl_mem_flags)(CL_MEM_READ_WRITE | CL_MEM_HOST_READ_ONLY),
+        rgba_pixels.size());
+
+    temp_pixel_buf = cl::Buffer(
+        context, (cl_mem_flags)(CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS),
+        rgba_pixels.size());
+
+    queue.enqueueWriteBuffer(input_pixel_buf, CL_BLOCKING, 0,
+                             rgba_pixels.size(), rgba_pixels.data());
+}
+
 void BlurCppExample::build_program(std::string options)
 {
     // Open kernel stream if not already openned.
@@ -591,6 +1001,9 @@ void BlurCppExample::build_program(std::string options)
 
 void BlurCppExample::create_gaussian_kernel()
 {
+    // image and buffer based blurs share the same kernel
+    if (gauss_kernel != nullptr) return;
+
     // create gaussian convolution kernel
     create_gaussian_kernel_(blur_opts.size, &gauss_kernel, &gauss_size);
 
@@ -624,6 +1037,76 @@ float BlurCppExample::gaussian(float x, float radius)
     return expf(-x * x / (2 * radius * radius)) / (sqrtf(2 * pi) * radius);
 }
 
+std::vector<float>
+BlurCppExample::reference_blur(const std::vector<float>& weights, int size)
+{
+    // same layout as the pixels of input_image, pixels outside of the image
+    // are left out of the weighted average just like on the device
+    const int w = static_cast<int>(width), h = static_cast<int>(height),
+              channels = input_image.pixel_size;
+    std::vector<float> temp(w * h * channels), result(w * h * channels);
+
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x)
+            for (int c = 0; c < channels; ++c)
+            {
+                double sum = 0, weight = 0;
+                for (int i = std::max(x - size, 0);
+                     i <= std::min(x + size, w - 1); ++i)
+                {
+                    weight += weights[size + i - x];
+                    sum += weights[size + i - x]
+                        * input_image.pixels[(y * w + i) * channels + c];
+                }
+                temp[(y * w + x) * channels + c] =
+                    static_cast<float>(sum / weight);
+            }
+
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x)
+            for (int c = 0; c < channels; ++c)
+            {
+                double sum = 0, weight = 0;
+                for (int i = std::max(y - size, 0);
+                     i <= std::min(y + size, h - 1); ++i)
+                {
+                    weight += weights[size + i - y];
+                    sum += weights[size + i - y]
+                        * temp[(i * w + x) * channels + c];
+                }
+                result[(y * w + x) * channels + c] =
+                    static_cast<float>(sum / weight);
+            }
+
+    return result;
+}
+
+double BlurCppExample::psnr(const std::vector<float>& reference)
+{
+    // Nothing to compare, or no pixel differs
+    if (reference.empty()) return std::numeric_limits<double>::infinity();
+
+    double mse = 0;
+    for (std::size_t i = 0; i < reference.size(); ++i)
+    {
+        const double diff = output_image.pixels[i] - reference[i];
+        mse += diff * diff;
+    }
+    if (mse == 0) return std::numeric_limits<double>::infinity();
+    mse /= reference.size();
+
+    return 10 * log10(255. * 255. / mse);
+}
+
+void BlurCppExample::print_psnr(const std::vector<float>& reference)
+{
+    const double quality = psnr(reference);
+    if (quality == std::numeric_limits<double>::infinity())
+        std::cout << "PSNR: identical to the reference" << std::endl;
+    else
+        std::cout << "PSNR: " << quality << " dB" << std::endl;
+}
+
 void BlurCppExample::parse_command_line(int argc, char* argv[])
 {
     auto opts = cl::sdk::parse_cli<cl::sdk::options::Diagnostic,
@@ -638,7 +1121,8 @@ void BlurCppExample::parse_command_line(int argc, char* argv[])
     step = 0;
 
     if (blur_opts.op.empty())
-        std::cout << "No blur option passed: box and gauss will be performed."
+        std::cout << "No blur option passed: box, sliding, gauss, buffer and "
+                     "pipeline will be performed."
                   << std::endl;
 }
 
@@ -762,6 +1246,20 @@ cl::ImageFormat BlurCppExample::set_image_format()
     return res;
 }
 
+void BlurCppExample::read_output_pixels()
+{
+    queue.enqueueReadBuffer(output_pixel_buf, CL_BLOCKING, 0,
+                            rgba_pixels.size(), rgba_pixels.data());
+
+    // store pixels the same way the image based blurs read them back, so that
+    // finalize_blur() can restore the image type if needed
+    const std::size_t pixels = width * height,
+                      pixel_size = input_image.pixel_size;
+    for (std::size_t i = 0; i < pixels; ++i)
+        memcpy(output_image.pixels.data() + pixel_size * i,
+               rgba_pixels.data() + 4 * i, pixel_size);
+}
+
 void BlurCppExample::finalize_blur()
 {
     // restore image type if needed
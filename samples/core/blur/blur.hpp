@@ -12,7 +12,7 @@
 class BlurCppExample {
 public:
     BlurCppExample(int argc, char* argv[])
-        : origin({ 0, 0 }), gauss_kernel(nullptr)
+        : image_support(false), origin({ 0, 0 }), gauss_kernel(nullptr)
     {
         parse_command_line(argc, argv);
     }
@@ -27,12 +27,31 @@ public:
 
     void dual_pass_subgroup_exchange_box_blur();
 
+    void dual_pass_running_sum_box_blur();
+
+    // Blur, sharpen and tone map the image with cl::sdk::ImagePipeline, once
+    // with every filter in its own kernel and once with filters fused.
+    void pipeline_blur_sharpen_tone_map();
+
     void dual_pass_kernel_blur();
 
+    // Repeat the dual-pass blurs keeping intermediate results in the storage
+    // selected with "-f" and compare them to the uint8 intermediate. They do
+    // nothing if the default uint8 storage is selected.
+    void dual_pass_box_blur_intermediate();
+
+    void dual_pass_kernel_blur_intermediate();
+
     void dual_pass_local_memory_exchange_kernel_blur();
 
     void dual_pass_subgroup_exchange_kernel_blur();
 
+    void single_pass_box_blur_buffer();
+
+    void dual_pass_box_blur_buffer();
+
+    void dual_pass_kernel_blur_buffer();
+
     void load_device();
 
     void read_input_image();
@@ -42,8 +61,15 @@ public:
     // Query device and runtime capabilities
     std::tuple<bool, bool, bool, std::string> query_capabilities();
 
+    // Tells whether image based blurs can be performed on the device. Only
+    // valid after query_capabilities().
+    bool has_image_support() const { return image_support; }
+
     void create_image_buffers();
 
+    // Buffer based blurs operate on plain buffers of uchar4 pixels
+    void create_pixel_buffers();
+
     void build_program(std::string kernel_op);
 
     void create_gaussian_kernel();
@@ -60,6 +86,7 @@ public:
         float size;
         std::vector<std::string>
             op; // This is a vector because MultiArg method is used
+        std::string intermediate;
     };
 
 private:
@@ -74,6 +101,11 @@ private:
     cl::sdk::Image output_image;
     cl::Image2D output_image_buf;
     cl::Image2D temp_image_buf;
+    cl::Buffer input_pixel_buf;
+    cl::Buffer output_pixel_buf;
+    cl::Buffer temp_pixel_buf;
+    std::vector<cl_uchar> rgba_pixels;
+    bool image_support;
     cl::ImageFormat format;
     std::array<cl::size_type, 2> origin;
     std::array<cl::size_type, 2> image_size;
@@ -95,6 +127,15 @@ private:
     void parse_command_line(int argc, char* argv[]);
     void show_format(cl::ImageFormat* format);
     cl::ImageFormat set_image_format();
+    void read_output_pixels();
+    void dual_pass_intermediate_blur(const std::vector<float>& weights,
+                                     cl_int size);
+    // host-side blur without quantization of the intermediate result
+    std::vector<float> reference_blur(const std::vector<float>& weights,
+                                      int size);
+    // infinity if the output equals the reference
+    double psnr(const std::vector<float>& reference);
+    void print_psnr(const std::vector<float>& reference);
     void finalize_blur();
 
     // note that the kernel is not normalized and has size of 2*(*size)+1
@@ -0,0 +1,34 @@
+// Stencil and point filters composed with the blur kernels by
+// cl::sdk::ImagePipeline. Pixels are float4 values in the 0-255 range of the
+// 8-bit images used by the sample.
+
+// Sharpening by subtracting the 4-neighbour Laplacian. Pixels outside of the
+// image are clamped to the edge, alpha is left untouched.
+float4 sharpen(read_only image2d_t image, int2 coord)
+{
+    const int2 first = (int2)(0, 0);
+    const int2 last = (int2)(get_image_width(image) - 1,
+                             get_image_height(image) - 1);
+
+    const float4 center = convert_float4(read_imageui(image, coord));
+    const float4 neighbours =
+        convert_float4(read_imageui(image, clamp(coord + (int2)(-1, 0), first, last))) +
+        convert_float4(read_imageui(image, clamp(coord + (int2)(1, 0), first, last))) +
+        convert_float4(read_imageui(image, clamp(coord + (int2)(0, -1), first, last))) +
+        convert_float4(read_imageui(image, clamp(coord + (int2)(0, 1), first, last)));
+
+    return (float4)(5.f * center.xyz - neighbours.xyz, center.w);
+}
+
+// Extended Reinhard tone mapping of every color channel. The exposure is
+// chosen as white point, so that the brightest input stays the brightest
+// output while darker tones get lifted.
+float4 tone_map(float4 pixel)
+{
+    const float exposure = 1.5f;
+
+    const float3 c = clamp(pixel.xyz, 0.f, 255.f) / 255.f * exposure;
+    const float3 mapped = c * (1.f + c / (exposure * exposure)) / (1.f + c);
+
+    return (float4)(mapped * 255.f, pixel.w);
+}
@@ -24,9 +24,10 @@ int main(int argc, char* argv[])
     try
     {
         // Parse command line arguments and store the parameters in blur class.
-        // You can pass '-b box' or '-b gauss' to select conversion type.
-        // You can pass both options with "-b box -b gauss" or don't pass
-        // anything. If you don't pass a parameter both conversions will be
+        // You can pass '-b box', '-b sliding', '-b gauss', '-b buffer' or
+        // '-b pipeline' to select conversion type.
+        // You can pass several options like "-b box -b gauss" or don't pass
+        // anything. If you don't pass a parameter all conversions will be
         // performed.
         BlurCppExample blur(argc, argv);
 
@@ -51,12 +52,17 @@ int main(int argc, char* argv[])
                  use_subgroup_exchange_relative, compiler_options) =
             blur.query_capabilities();
 
+        // Image based blurs are skipped on devices without image support,
+        // buffer based blurs are performed on them instead.
+        bool use_images = blur.has_image_support();
+        bool use_buffers = !use_images || blur.option_active("buffer");
+
         // Create image buffers used for operation. In this example input,
         // output and temporary image buffers are used. Temporary buffer is used
         // when 2 blur operations in the row are performed. Result of the first
         // operation is stored in temporary buffer and temporary buffer is used
         // as input for 2nd operation.
-        blur.create_image_buffers();
+        if (use_images) blur.create_image_buffers();
 
         // Create kernel and build program for selected device and blur.cl file
         // without any options. If this function fails, ensure that the blur.cl
@@ -65,7 +71,7 @@ int main(int argc, char* argv[])
 
         // The box blur operation will be performed if you pass "-b box" or
         // don't select any option.
-        if (blur.option_active("box"))
+        if (use_images && blur.option_active("box"))
         {
             // Basic blur operation using a kernel functor. Using kernel
             // functors is more convenient than creating a kernel class object
@@ -77,6 +83,12 @@ int main(int argc, char* argv[])
             // and used for the second operation.
             blur.dual_pass_box_blur();
 
+            // When "-f half" or "-f float" is passed, the dual pass blur is
+            // repeated keeping the result of the first pass in a half float
+            // image or in float planes instead of an 8-bit image, and the
+            // throughput and PSNR of both are printed.
+            blur.dual_pass_box_blur_intermediate();
+
             // Comparison with other examples shows the classic approach to
             // working with local memory. Kernels for blur operations are
             // created separately, and their parameters are set with setArg
@@ -110,10 +122,28 @@ int main(int argc, char* argv[])
         // Build default program with no kernel arguments.
         blur.build_program(compiler_options);
 
+        // The running-sum box blur is performed when the "-b sliding" option
+        // or no option is passed. Instead of summing the whole window for
+        // every pixel, each work-item walks a segment of a row or column
+        // adding the pixel entering the window and subtracting the one
+        // leaving it, which makes the cost per pixel independent of the
+        // blur radius.
+        if (use_images && blur.option_active("sliding"))
+            blur.dual_pass_running_sum_box_blur();
+
+        // The filter pipeline is performed when the "-b pipeline" option or no
+        // option is passed. It chains the dual-pass box blur with a sharpen
+        // stencil and a tone mapping point filter from filters.cl, keeping all
+        // intermediate images on the device. It runs once with every filter in
+        // its own kernel and once with sharpen and tone map fused into a
+        // single kernel, saving a full write and read of the image.
+        if (use_images && blur.option_active("pipeline"))
+            blur.pipeline_blur_sharpen_tone_map();
+
         // The gauss blur operation is performed when the "-b gauss" option or
         // no option is passed. The following examples use a manually created
         // gaussian kernel passed as an argument to functions from blur.cl
-        if (blur.option_active("gauss"))
+        if (use_images && blur.option_active("gauss"))
         {
             std::cout << "Dual-pass Gaussian blur" << std::endl;
             // Create a gaussian kernel to be used for the next blurs.
@@ -122,6 +152,9 @@ int main(int argc, char* argv[])
             // Basic blur operation using kernel functor and gaussian kernel.
             blur.dual_pass_kernel_blur();
 
+            // Same as dual_pass_box_blur_intermediate but with a gauss kernel.
+            blur.dual_pass_kernel_blur_intermediate();
+
             // Local memory exchange Gaussian blur with kernel functors. Note
             // that the variable type cl::Local is used for local memory
             // arguments in kernel functor calls.
@@ -155,6 +188,26 @@ int main(int argc, char* argv[])
                 blur.dual_pass_subgroup_exchange_kernel_blur();
             }
         } // Gaussian blur
+
+        // The buffer based blurs are performed when the "-b buffer" option or
+        // no option is passed, or when the device has no image support. They
+        // implement the box and Gaussian blurs on plain buffers holding uchar4
+        // pixels instead of images, which is often faster on CPU runtimes
+        // emulating images. Passing "-v" prints their timings alongside the
+        // image based variants for comparison on the same device.
+        if (use_buffers)
+        {
+            // Pixels are always stored on 4 channels in buffers, the missing
+            // ones are added and removed on the host.
+            blur.create_pixel_buffers();
+            blur.create_gaussian_kernel();
+
+            blur.single_pass_box_blur_buffer();
+
+            blur.dual_pass_box_blur_buffer();
+
+            blur.dual_pass_kernel_blur_buffer();
+        } // Buffer blur
     } catch (cl::Error& e)
     {
         std::cerr << "OpenCL runtime error: " << e.what() << std::endl;
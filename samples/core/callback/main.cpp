@@ -16,18 +16,22 @@
 
 // OpenCL SDK includes
 #include <CL/SDK/CLI.hpp>
+#include <CL/SDK/Checkpoint.hpp>
+#include <CL/SDK/CommandBuffer.hpp>
 #include <CL/SDK/Context.hpp>
 #include <CL/SDK/Image.hpp>
 #include <CL/SDK/Options.hpp>
+#include <CL/SDK/ReadbackPipeline.hpp>
 #include <CL/Utils/Context.hpp>
 
 // standard header includes
-#include <cassert>
+#include <algorithm> // std::min, std::max
+#include <chrono>
+#include <cmath> // std::abs
 #include <fstream>
-#include <future>
 #include <iostream>
-#include <map>
-#include <mutex>
+#include <memory> // std::unique_ptr
+#include <string> // std::to_string
 #include <tuple> // std::make_tuple
 #include <vector>
 
@@ -36,16 +40,6 @@
 
 namespace {
 
-struct ReadJob
-{
-    std::vector<cl_uchar> data;
-    std::size_t side;
-};
-
-std::mutex read_mutex;
-std::map<std::intptr_t, ReadJob> read_jobs;
-std::vector<std::future<void>> image_write_tasks;
-
 template <typename T> struct DoubleBuffer
 {
     T read, write;
@@ -53,53 +47,94 @@ template <typename T> struct DoubleBuffer
     void swap() { std::swap(read, write); }
 };
 
-void CL_CALLBACK read_complete_callback(cl_event, cl_int, void* user_data)
-{
-    // Acquire the job associated with the received ID and remove it from the
-    // map. These operations have to be protected, because the main thread or
-    // other callbacks might modify the map concurrently.
-    const auto job_id = reinterpret_cast<std::intptr_t>(user_data);
-    ReadJob job;
-    {
-        std::lock_guard<std::mutex> copy_lock(read_mutex);
-        const auto iter = read_jobs.find(job_id);
-        job = std::move(iter->second);
-        read_jobs.erase(iter);
-    }
-
-    // Launch an asynchronous task (on the CPU) which writes the read contents
-    // of the buffer to a PNG file. Notice, how the relevant members of the job
-    // are moved to the closure.
-    // Since no std::launch is passed, the task will either run deferred (on the
-    // main thread calling .wait()), or truly asynchronously on a different
-    // thread. The main point is that it is not running on the OpenCL runtime's
-    // thread.
-    image_write_tasks[static_cast<std::size_t>(job_id)] =
-        std::async([pixels = std::move(job.data), side = job.side, job_id] {
-            const cl::sdk::Image image{
-                static_cast<int>(side),
-                static_cast<int>(side),
-                static_cast<int>(sizeof(cl_uchar4)),
-                std::move(pixels),
-            };
-            const std::string filename =
-                "callbackcpp_out" + std::to_string(job_id) + ".png";
-            cl::sdk::write_image(filename.c_str(), image);
-            std::cout << "Written image to " << filename << '\n';
-        });
-}
-
 struct CallbackOptions
 {
     std::size_t side;
     std::size_t iterations;
     std::size_t write_iter;
+    std::size_t slots;
+    unsigned encoders;
+    std::size_t generations;
+    std::string checkpoint;
+    std::string format;
+    bool compare_formats;
+};
+
+// Storage formats of the state. U is stored in the R channel, V in the G
+// channel. The first one is the reference of compare_formats().
+struct StateFormat
+{
+    std::string name;
+    cl::ImageFormat format;
+    std::size_t texel_size;
 };
 
+std::vector<StateFormat> state_formats()
+{
+    return { { "rgba32f", cl::ImageFormat{ CL_RGBA, CL_FLOAT }, 16 },
+             { "rgba8", cl::ImageFormat{ CL_RGBA, CL_UNORM_INT8 }, 4 },
+             { "rg32f", cl::ImageFormat{ CL_RG, CL_FLOAT }, 8 },
+             { "rg16f", cl::ImageFormat{ CL_RG, CL_HALF_FLOAT }, 4 } };
+}
+
+bool is_supported(const cl::Context& context, const cl::ImageFormat& format)
+{
+    std::vector<cl::ImageFormat> supported_formats;
+    context.getSupportedImageFormats(CL_MEM_READ_WRITE, CL_MEM_OBJECT_IMAGE2D,
+                                     &supported_formats);
+    return std::any_of(
+        supported_formats.begin(), supported_formats.end(),
+        [&](const cl::ImageFormat& supported) {
+            return supported.image_channel_order == format.image_channel_order
+                && supported.image_channel_data_type
+                == format.image_channel_data_type;
+        });
+}
+
+// Returns the storage format named name, where rg picks half floats if the
+// device supports them and floats otherwise.
+StateFormat find_format(const cl::Context& context, const std::string& name)
+{
+    const auto formats = state_formats();
+    auto named = [&](const std::string& wanted) {
+        return *std::find_if(
+            formats.begin(), formats.end(),
+            [&](const StateFormat& format) { return format.name == wanted; });
+    };
+    const StateFormat format = name != "rg" ? named(name)
+        : is_supported(context, named("rg16f").format) ? named("rg16f")
+                                                        : named("rg32f");
+    if (!is_supported(context, format.format))
+        throw std::runtime_error("Required image format is not supported "
+                                 "on the selected runtime");
+    return format;
+}
+
+// Fills the image with chemical U (the source component of the reaction),
+// and a small rectangle in the middle with chemical V (the result of the
+// reaction).
+void initialize(cl::CommandQueue& queue, const cl::Image2D& image,
+                std::size_t side)
+{
+    queue.enqueueFillImage(image, cl_float4{ { 1.F, 0.F, 0.F, 1.F } },
+                           { 0, 0 }, { side, side, 1 });
+    queue.enqueueFillImage(image, cl_float4{ { 1.F, 1.F, 0.F, 1.F } },
+                           { side / 2, side / 2 },
+                           { side / 100, side / 100, 1 });
+}
+
 } // namespace
 
+std::unique_ptr<TCLAP::ValuesConstraint<std::string>> valid_format_constraint;
+
 template <> auto cl::sdk::parse<CallbackOptions>()
 {
+    std::vector<std::string> valid_format_strings{ "rgba8", "rgba32f",
+                                                   "rg16f", "rg32f", "rg" };
+    valid_format_constraint =
+        std::make_unique<TCLAP::ValuesConstraint<std::string>>(
+            valid_format_strings);
+
     return std::make_tuple(
         std::make_shared<TCLAP::ValueArg<std::size_t>>(
             "s", "side", "Side length of the generated image in pixels", false,
@@ -111,17 +146,133 @@ template <> auto cl::sdk::parse<CallbackOptions>()
             "w", "write_iter",
             "Controls after how many iterations the intermediate result is "
             "written to file",
-            false, 1000, "positive integral"));
+            false, 1000, "positive integral"),
+        std::make_shared<TCLAP::ValueArg<std::size_t>>(
+            "b", "buffers",
+            "Number of frames read back or written to file concurrently", false,
+            4, "positive integral"),
+        std::make_shared<TCLAP::ValueArg<unsigned>>(
+            "e", "encoders", "Number of threads writing image files", false, 2,
+            "positive integral"),
+        std::make_shared<TCLAP::ValueArg<std::size_t>>(
+            "g", "generations",
+            "Number of iterations per kernel launch, staged in local memory "
+            "if more than 1",
+            false, 1, "positive integral"),
+        std::make_shared<TCLAP::ValueArg<std::string>>(
+            "c", "checkpoint",
+            "Checkpoint file to resume from if it exists, and to write with "
+            "every frame",
+            false, "", "path"),
+        std::make_shared<TCLAP::ValueArg<std::string>>(
+            "f", "format",
+            "Storage format of the state: 8-bit or float RGBA, half or float "
+            "RG, rg picks half if supported",
+            false, "rgba8", valid_format_constraint.get()),
+        std::make_shared<TCLAP::SwitchArg>(
+            "C", "compare-formats",
+            "Run the steps with every supported format, report the "
+            "throughput and the deviation from float RGBA, and exit",
+            false));
 }
 
 template <>
 CallbackOptions cl::sdk::comprehend<CallbackOptions>(
     std::shared_ptr<TCLAP::ValueArg<size_t>> side_arg,
     std::shared_ptr<TCLAP::ValueArg<size_t>> iter_arg,
-    std::shared_ptr<TCLAP::ValueArg<size_t>> write_iter_arg)
+    std::shared_ptr<TCLAP::ValueArg<size_t>> write_iter_arg,
+    std::shared_ptr<TCLAP::ValueArg<size_t>> slots_arg,
+    std::shared_ptr<TCLAP::ValueArg<unsigned>> encoders_arg,
+    std::shared_ptr<TCLAP::ValueArg<size_t>> generations_arg,
+    std::shared_ptr<TCLAP::ValueArg<std::string>> checkpoint_arg,
+    std::shared_ptr<TCLAP::ValueArg<std::string>> format_arg,
+    std::shared_ptr<TCLAP::SwitchArg> compare_formats_arg)
 {
-    return CallbackOptions{ side_arg->getValue(), iter_arg->getValue(),
-                            write_iter_arg->getValue() };
+    return CallbackOptions{ side_arg->getValue(),       iter_arg->getValue(),
+                            write_iter_arg->getValue(), slots_arg->getValue(),
+                            encoders_arg->getValue(),
+                            generations_arg->getValue(),
+                            checkpoint_arg->getValue(),
+                            format_arg->getValue(),
+                            compare_formats_arg->getValue() };
+}
+
+// Runs iterations steps from the initial state in every storage format the
+// device supports, and reports their throughput and how far the result
+// drifts from that of float RGBA.
+void compare_formats(const cl::Context& context, cl::CommandQueue& queue,
+                     const cl::Program& program, std::size_t side,
+                     std::size_t iterations)
+{
+    cl::Kernel step(program, "reaction_diffusion_step");
+    cl::Kernel read_state(program, "read_state");
+    const cl::size_type state_bytes = side * side * sizeof(cl_float2);
+    cl::Buffer state_buffer{ context, CL_MEM_WRITE_ONLY, state_bytes };
+
+    // The first supported format is the reference, rgba32f if available.
+    std::vector<cl_float2> reference;
+    std::string reference_name;
+    for (const auto& format : state_formats())
+    {
+        if (!is_supported(context, format.format))
+        {
+            std::cout << format.name << ": not supported" << std::endl;
+            continue;
+        }
+
+        DoubleBuffer<cl::Image2D> images{
+            cl::Image2D(context, CL_MEM_READ_WRITE, format.format, side, side),
+            cl::Image2D(context, CL_MEM_READ_WRITE, format.format, side, side)
+        };
+        initialize(queue, images.read, side);
+        queue.finish();
+
+        const auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < iterations; ++i)
+        {
+            step.setArg(0, images.read);
+            step.setArg(1, images.write);
+            queue.enqueueNDRangeKernel(step, cl::NullRange,
+                                       cl::NDRange(side, side));
+            images.swap();
+        }
+        queue.finish();
+        const double seconds = std::chrono::duration<double>(
+                                   std::chrono::steady_clock::now() - start)
+                                   .count();
+
+        std::vector<cl_float2> state(side * side);
+        read_state.setArg(0, images.read);
+        read_state.setArg(1, state_buffer);
+        queue.enqueueNDRangeKernel(read_state, cl::NullRange,
+                                   cl::NDRange(side, side));
+        queue.enqueueReadBuffer(state_buffer, CL_TRUE, 0, state_bytes,
+                                state.data());
+        if (reference.empty())
+        {
+            reference = state;
+            reference_name = format.name;
+        }
+
+        float drift_u = 0.F, drift_v = 0.F;
+        for (std::size_t i = 0; i < state.size(); ++i)
+        {
+            drift_u = std::max(drift_u,
+                               std::abs(state[i].s[0] - reference[i].s[0]));
+            drift_v = std::max(drift_v,
+                               std::abs(state[i].s[1] - reference[i].s[1]));
+        }
+
+        // Every step reads the image and writes the other one, assuming
+        // neighbors are read from the cache.
+        const double bytes_per_second =
+            2.0 * side * side * format.texel_size * iterations / seconds;
+        std::cout << format.name << ": " << iterations / seconds
+                  << " steps/s, " << bytes_per_second / 1e9
+                  << " GB/s, largest deviation from " << reference_name
+                  << ": U " << drift_u
+                  << ", V " << drift_v << std::endl;
+    }
 }
 
 int main(int argc, char* argv[])
@@ -169,142 +320,260 @@ int main(int argc, char* argv[])
                              std::string{ std::istreambuf_iterator<char>{
                                               kernel_stream },
                                           std::istreambuf_iterator<char>{} } };
-        program.build(device);
-        cl::KernelFunctor<cl::Image2D, cl::Image2D> reaction_diffusion_step(
-            program, "reaction_diffusion_step");
-
-        // Check if the used image format is supported on the device
-        const cl::ImageFormat required_image_format(CL_RGBA, CL_UNORM_INT8);
-        std::vector<cl::ImageFormat> supported_formats;
-        context.getSupportedImageFormats(
-            CL_MEM_READ_WRITE, CL_MEM_OBJECT_IMAGE2D, &supported_formats);
-        auto found_format = std::find_if(
-            supported_formats.begin(), supported_formats.end(),
-            [&](const cl::ImageFormat& format) {
-                return format.image_channel_order
-                    == required_image_format.image_channel_order
-                    && format.image_channel_data_type
-                    == required_image_format.image_channel_data_type;
-            });
-        if (found_format == supported_formats.end())
-        {
-            throw std::runtime_error("Required image format is not supported "
-                                     "on the selected runtime");
-        }
+        const std::size_t generations = std::max<std::size_t>(
+            alg_opts.generations, 1);
+        program.build(
+            device, ("-DGENERATIONS=" + std::to_string(generations)).c_str());
+        cl::Kernel reaction_diffusion_step(program, "reaction_diffusion_step");
+        cl::Kernel reaction_diffusion_blocked(program,
+                                              "reaction_diffusion_blocked");
+        cl::Kernel to_rgba8(program, "to_rgba8");
 
         // Options provided on the command line
         const std::size_t side = alg_opts.side;
         const std::size_t iterations = alg_opts.iterations;
         const std::size_t save_at_every = alg_opts.write_iter;
 
+        if (alg_opts.compare_formats)
+        {
+            compare_formats(context, compute_queue, program, side, iterations);
+            return 0;
+        }
+
+        // Check if the storage format is supported on the device
+        const StateFormat format = find_format(context, alg_opts.format);
+
+        // The blocked kernel runs work-groups of up to 16x16 pixels, as many
+        // as the device runs, each staging two tiles with a halo of
+        // generations pixels in local memory.
+        std::size_t local_x = 16, local_y = 16;
+        const std::size_t max_group =
+            reaction_diffusion_blocked
+                .getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device);
+        while (local_x * local_y > max_group)
+        {
+            if (local_y >= local_x)
+                local_y /= 2;
+            else
+                local_x /= 2;
+        }
+        const cl::NDRange blocked_local{ local_x, local_y };
+        const cl::NDRange blocked_global{
+            (side + local_x - 1) / local_x * local_x,
+            (side + local_y - 1) / local_y * local_y
+        };
+        const std::size_t tiles_size = 2 * (local_x + 2 * generations)
+            * (local_y + 2 * generations) * sizeof(cl_float2);
+        if (generations > 1
+            && tiles_size > device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>())
+            throw std::runtime_error{ "The tiles of the blocked kernel exceed "
+                                      "the local memory, run fewer "
+                                      "generations per launch." };
+
         // Create two equivalent images. In a single iteration one serves as the
         // source, the other as the destination, and then the roles are swapped.
         DoubleBuffer<cl::Image2D> images{
-            cl::Image2D(context, CL_MEM_READ_WRITE, required_image_format, side,
-                        side),
-            cl::Image2D(context, CL_MEM_READ_WRITE, required_image_format, side,
-                        side),
+            cl::Image2D(context, CL_MEM_READ_WRITE, format.format, side, side),
+            cl::Image2D(context, CL_MEM_READ_WRITE, format.format, side, side),
         };
 
         // In each pixel of the images, the concentration of the
         //   - U (reaction source) component is stored in the R channel,
         //   - V (reaction result) component is stored in the G channel.
-        // The B channel is unused, and the A (alpha) channel must be set to 1,
-        // so the resulting image is visible in the image viewer.
-        //
-        // First, fill the source image with chemical U (the source component of
-        // the reaction)
-        compute_queue.enqueueFillImage(images.read,
-                                       cl_float4{ { 1.F, 0.F, 0.F, 1.F } },
-                                       { 0, 0 }, { side, side, 1 });
-
-        // In addition, fill a small rectangle in the middle of the source image
-        // with chemical V (the result of the reaction)
-        compute_queue.enqueueFillImage(
-            images.read, cl_float4{ { 1.F, 1.F, 0.F, 1.F } },
-            { side / 2, side / 2 }, { side / 100, side / 100, 1 });
-
-        // The copy_event is initialized with a completed user event,
-        // so it doesn't block the first kernel launch.
-        cl::UserEvent completed_event(context);
-        completed_event.setStatus(CL_COMPLETE);
-        cl::Event copy_event = completed_event;
-        cl::Event prev_compute_event = completed_event;
-
-        const std::size_t num_images_writes =
-            (iterations + save_at_every - 1) / save_at_every;
-        image_write_tasks.resize(num_images_writes);
-        std::intptr_t copy_job_id{};
-        for (std::size_t iter = 0; iter < iterations; ++iter)
+        // In RGBA formats the B channel is unused, and the A (alpha) channel
+        // must be set to 1, so the resulting image is visible in the image
+        // viewer.
+        initialize(compute_queue, images.read, side);
+
+        // If a checkpoint exists, the simulation resumes from the state and
+        // step it holds instead.
+        const cl::size_type state_size = side * side * format.texel_size;
+        const std::string state_section = "state/" + format.name;
+        std::size_t first_iter = 0;
+        if (!alg_opts.checkpoint.empty()
+            && std::ifstream{ alg_opts.checkpoint }.good())
+        {
+            const cl::sdk::Checkpoint checkpoint =
+                cl::sdk::read_checkpoint(alg_opts.checkpoint);
+            const auto state = checkpoint.find(state_section);
+            if (state == nullptr || state->data.size() != state_size)
+                throw std::runtime_error{ "Checkpoint does not match the "
+                                          "size and format of the "
+                                          "simulation" };
+            compute_queue.enqueueWriteImage(images.read, CL_TRUE, { 0, 0, 0 },
+                                            { side, side, 1 }, 0, 0,
+                                            state->data.data());
+            first_iter = static_cast<std::size_t>(checkpoint.step);
+            if (!diag_opts.quiet)
+                std::cout << "Resuming from iteration " << first_iter
+                          << " of " << alg_opts.checkpoint << std::endl;
+        }
+        // Frames written before resuming keep their file names.
+        const std::size_t first_frame = first_iter / save_at_every;
+
+        // Frames are read back to the host and written to file by a pipeline
+        // of a fixed number of device buffers and pinned host arrays. The
+        // device->host reads are enqueued on the read queue, their completion
+        // callbacks hand the frames to encoder threads writing the PNG files.
+        // If the encoders fall behind, submitting a frame blocks until one of
+        // them is done, so memory use stays bounded however long the
+        // simulation runs.
+        cl::sdk::ReadbackPipeline readback(
+            context, read_queue, side * side * sizeof(cl_uchar4),
+            [side, first_frame](const cl::sdk::ReadbackPipeline::Frame& frame) {
+                // Every encoder thread reuses its own image.
+                thread_local cl::sdk::Image image;
+                const auto pixels = static_cast<const cl_uchar*>(frame.data);
+                image.width = static_cast<int>(side);
+                image.height = static_cast<int>(side);
+                image.pixel_size = static_cast<int>(sizeof(cl_uchar4));
+                image.pixels.assign(pixels, pixels + frame.size);
+
+                const std::string filename = "callbackcpp_out"
+                    + std::to_string(first_frame + frame.index) + ".png";
+                cl::sdk::write_image(filename.c_str(), image);
+                std::cout << "Written image to " << filename << '\n';
+            },
+            alg_opts.slots, alg_opts.encoders);
+
+        // The steps between two frames are recorded once as a command
+        // buffer, where cl_khr_command_buffer is supported, and replayed with
+        // a single enqueue instead of launching every step. Launch i reads the
+        // image written by launch i - 1, so the images alternate as source and
+        // destination within the recording. With more than one generation per
+        // launch, blocked launches advance as many steps as fit, and single
+        // steps make up the rest.
+        auto bind = [&](cl::sdk::CommandBuffer& steps) {
+            for (std::size_t i = 0; i < steps.size(); ++i)
+            {
+                steps.set_arg(i, 0, i % 2 == 0 ? images.read : images.write);
+                steps.set_arg(i, 1, i % 2 == 0 ? images.write : images.read);
+            }
+        };
+        auto record = [&](std::size_t count) {
+            cl::sdk::CommandBuffer steps{ compute_queue };
+            const std::size_t blocked =
+                generations > 1 ? count / generations : 0;
+            for (std::size_t i = 0; i < blocked; ++i)
+                steps.add(reaction_diffusion_blocked, blocked_global,
+                          blocked_local, images.read, images.write,
+                          cl::Local(tiles_size));
+            for (std::size_t i = blocked * generations; i < count; ++i)
+                steps.add(reaction_diffusion_step, cl::NDRange(side, side),
+                          cl::NullRange, images.read, images.write);
+            bind(steps);
+            steps.finalize();
+            return steps;
+        };
+        std::size_t frame_steps = std::min(save_at_every, iterations);
+        cl::sdk::CommandBuffer steps = record(frame_steps);
+
+        if (!diag_opts.quiet)
         {
-            // Enqueue the next step of the iteration and swap the source and
-            // destination images. This synchronizes with the previous copy of
-            // the input image, ensuring that the copy is finished before the
-            // current kernel overwrites the data.
-            auto compute_event = reaction_diffusion_step(
-                cl::EnqueueArgs(compute_queue, copy_event,
-                                cl::NDRange(side, side)),
-                images.read, images.write);
-
-            // For every Nth iteration, the current state of the simulation is
-            // written to a PNG file
-            if (iter % save_at_every == 0)
+            std::cout << "Steps are "
+                      << (steps.mode() == cl::sdk::CommandBuffer::Mode::Direct
+                              ? "enqueued one by one."
+                              : "replayed from a command buffer.")
+                      << std::endl;
+        }
+
+        // With every frame, the state is also written to the checkpoint
+        // file in the background, through the same copy and read queues.
+        std::unique_ptr<cl::sdk::CheckpointWriter> checkpoints;
+        if (!alg_opts.checkpoint.empty())
+            checkpoints = std::make_unique<cl::sdk::CheckpointWriter>(
+                context, read_queue, alg_opts.checkpoint,
+                std::vector<std::pair<std::string, cl::size_type>>{
+                    { state_section, state_size } });
+
+        cl::Event compute_event;
+        auto copy_state = [&](const cl::Buffer& buffer, cl::size_type offset) {
+            std::vector<cl::Event> compute_events;
+            if (compute_event() != nullptr)
+                compute_events.push_back(compute_event);
+            cl::Event event;
+            copy_queue.enqueueCopyImageToBuffer(images.read, buffer, { 0, 0 },
+                                                { side, side, 1 }, offset,
+                                                &compute_events, &event);
+            return event;
+        };
+        // Image files are written from 8-bit RGBA pixels, which other
+        // storage formats are converted to on the copy queue.
+        auto copy_frame = [&](const cl::Buffer& buffer) {
+            if (format.name == "rgba8") return copy_state(buffer, 0);
+            std::vector<cl::Event> compute_events;
+            if (compute_event() != nullptr)
+                compute_events.push_back(compute_event);
+            to_rgba8.setArg(0, images.read);
+            to_rgba8.setArg(1, buffer);
+            cl::Event event;
+            copy_queue.enqueueNDRangeKernel(to_rgba8, cl::NullRange,
+                                            cl::NDRange(side, side),
+                                            cl::NullRange, &compute_events,
+                                            &event);
+            return event;
+        };
+        for (std::size_t iter = first_iter; iter < iterations;
+             iter += frame_steps)
+        {
+            // Every Nth state of the simulation is written to a PNG file.
+            // Enqueue the copy of the current source image to a buffer of
+            // the pipeline. This is a device->device copy, which is probably
+            // faster than a device->host copy. The copy synchronizes with the
+            // previous steps. The pipeline enqueues the device->host read of
+            // the buffer after the copy.
+            std::vector<cl::Event> copy_events{ readback.submit(copy_frame) };
+            if (checkpoints)
+                copy_events.push_back(checkpoints->submit(
+                    iter, [&](const cl::Buffer& buffer) {
+                        return copy_state(buffer, checkpoints->offset(0));
+                    }));
+
+            // The last frame may be followed by fewer steps.
+            if (iterations - iter < frame_steps)
             {
-                // Add a new entry to the job map, protected by a mutex.
-                // The job is associated with a job ID.
-                auto& job = [&]() -> ReadJob& {
-                    std::lock_guard<std::mutex> lock(read_mutex);
-                    return read_jobs[copy_job_id] = {};
-                }();
-                // We should allocate outside of the critical section
-                cl::Buffer copy_buffer(context, CL_MEM_READ_WRITE,
-                                       side * side * sizeof(cl_uchar4));
-                job.data = std::vector<cl_uchar>(side * side * 4);
-                job.side = side;
-
-                // Enqueue the copy of the last destination image to a buffer.
-                // This is a device->device copy, which is probably faster than
-                // a device->host copy. The copy synchronizes with the previous
-                // kernel launch, however, the next kernel can be launched,
-                // while the copy is in progress, because both read only from
-                // images.front.
-                const std::vector<cl::Event> compute_events{
-                    prev_compute_event
-                };
-                copy_queue.enqueueCopyImageToBuffer(
-                    images.read, copy_buffer, { 0, 0 }, { side, side, 1 }, 0,
-                    &compute_events, &copy_event);
-
-                // When the device->device copy is finished, a device->host read
-                // can start. The resulting data on the host is accessible
-                // through the job object.
-                const std::vector<cl::Event> copy_events{ copy_event };
-                cl::Event read_event;
-                read_queue.enqueueReadBuffer(
-                    copy_buffer, false, 0, side * side * sizeof(cl_uchar4),
-                    job.data.data(), &copy_events, &read_event);
-
-                // When the device->host read is finished, a callback is called.
-                // It spawns an asynchronous CPU job that writes the data to
-                // file. We use the pointer-sized user-data argument to identify
-                // the job in the callback.
-                read_event.setCallback(CL_COMPLETE, read_complete_callback,
-                                       reinterpret_cast<void*>(copy_job_id));
-                ++copy_job_id;
+                frame_steps = iterations - iter;
+                steps = record(frame_steps);
+            }
+
+            // Enqueue the steps up to the next frame. They synchronize with
+            // the copies, ensuring that they are finished before the second
+            // step overwrites the source image.
+            compute_event = steps.enqueue(copy_events);
+            // The copies of the next frame wait for the steps from another
+            // queue, which must be flushed to guarantee progress.
+            compute_queue.flush();
+
+            // After an odd number of launches the images swapped roles.
+            if (steps.size() % 2 != 0)
+            {
+                images.swap();
+                bind(steps);
             }
-            prev_compute_event = compute_event;
-            images.swap();
         }
-        // Wait for every read finished callback to fire.
-        read_queue.finish();
+        // Wait for every frame to be read and written to file.
+        readback.finish();
+        if (checkpoints) checkpoints->finish();
 
-        // Eventually, wait for each image file writing job to finish.
-        for (const auto& task : image_write_tasks)
+        if (!diag_opts.quiet)
         {
-            task.wait();
+            const auto stats = readback.statistics();
+            std::cout << "Written " << stats.frames << " frames at "
+                      << stats.frames_per_second << " frames/s, simulation "
+                      << "stalled for " << stats.stall_seconds
+                      << " s waiting for free buffers." << std::endl;
+            if (checkpoints)
+            {
+                const auto checkpoint_stats = checkpoints->statistics();
+                const double ratio = checkpoint_stats.bytes != 0
+                    ? 100.0 * checkpoint_stats.stored_bytes
+                        / checkpoint_stats.bytes
+                    : 100.0;
+                std::cout << "Written " << checkpoint_stats.checkpoints
+                          << " checkpoints, compressed to " << ratio
+                          << "% of their size." << std::endl;
+            }
         }
-        // We can expect that all jobs have been consumed at this point.
-        assert(read_jobs.empty());
     } catch (cl::util::Error& e)
     {
         std::cerr << "OpenCL Utils error: " << e.what() << std::endl;
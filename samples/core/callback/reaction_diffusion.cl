@@ -1,18 +1,26 @@
-kernel void reaction_diffusion_step(read_only image2d_t in_data,
-                                    write_only image2d_t out_data)
+// Next concentrations of U and V, given the current ones and the weighted sum
+// of the neighborhood.
+float2 react(float2 uv, float2 diffuse)
 {
     const float DU = 1.F;
     const float DV = 0.3F;
     const float f = 0.055F;
     const float k = 0.062F;
 
+    const float u = uv.x;
+    const float v = uv.y;
+    return (float2){ u + DU * diffuse.x - u * v * v + f * (1 - u),
+                     v + DV * diffuse.y + u * v * v - (k + f) * v };
+}
+
+kernel void reaction_diffusion_step(read_only image2d_t in_data,
+                                    write_only image2d_t out_data)
+{
     const sampler_t smplr = CLK_NORMALIZED_COORDS_FALSE | CLK_FILTER_NEAREST
         | CLK_ADDRESS_CLAMP_TO_EDGE;
     const size_t x = get_global_id(0);
     const size_t y = get_global_id(1);
     const float2 uv = read_imagef(in_data, smplr, (int2){ x, y }).xy;
-    const float u = uv.x;
-    const float v = uv.y;
 
     float u_diffuse = 0.F;
     float v_diffuse = 0.F;
@@ -43,8 +51,114 @@ kernel void reaction_diffusion_step(read_only image2d_t in_data,
         }
     }
 
-    const float u_new = u + DU * u_diffuse - u * v * v + f * (1 - u);
-    const float v_new = v + DV * v_diffuse + u * v * v - (k + f) * v;
+    const float2 uv_new = react(uv, (float2){ u_diffuse, v_diffuse });
+
+    write_imagef(out_data, (int2){ x, y }, (float4){ uv_new, 0, 1 });
+}
+
+// Temporally blocked variant of reaction_diffusion_step, advancing GENERATIONS
+// steps per launch. The work-group stages its pixels with a halo of
+// GENERATIONS pixels, then steps between two tiles in local memory and writes
+// its pixels once. Every step only updates the pixels the result still
+// depends on, which shrink by one from each side every step. Neighbors outside
+// the image are read from the nearest edge pixel of the tile, as the sampler
+// clamps to the edge.
+#ifndef GENERATIONS
+#define GENERATIONS 4
+#endif
+
+// tiles holds two tiles of (sx + 2 * GENERATIONS) * (sy + 2 * GENERATIONS)
+// pixels.
+kernel void reaction_diffusion_blocked(read_only image2d_t in_data,
+                                       write_only image2d_t out_data,
+                                       local float2* tiles)
+{
+    const sampler_t smplr = CLK_NORMALIZED_COORDS_FALSE | CLK_FILTER_NEAREST
+        | CLK_ADDRESS_CLAMP_TO_EDGE;
+    const int width = get_image_width(in_data);
+    const int height = get_image_height(in_data);
+    const int lx = get_local_id(0);
+    const int ly = get_local_id(1);
+    const int sx = get_local_size(0);
+    const int sy = get_local_size(1);
+    const int pitch = sx + 2 * GENERATIONS;
+    const int rows = sy + 2 * GENERATIONS;
+    const int size = pitch * rows;
+    const int x0 = get_group_id(0) * sx - GENERATIONS;
+    const int y0 = get_group_id(1) * sy - GENERATIONS;
 
-    write_imagef(out_data, (int2){ x, y }, (float4){ u_new, v_new, 0, 1 });
+    for (int i = ly * sx + lx; i < size; i += sx * sy)
+        tiles[i] = read_imagef(in_data, smplr,
+                               (int2){ x0 + i % pitch, y0 + i / pitch })
+                       .xy;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    local float2* in = tiles;
+    local float2* out = tiles + size;
+    for (int g = 0; g < GENERATIONS; ++g)
+    {
+        const int inner = pitch - 2 * (g + 1);
+        const int count = inner * (rows - 2 * (g + 1));
+        for (int i = ly * sx + lx; i < count; i += sx * sy)
+        {
+            const int tx = g + 1 + i % inner;
+            const int ty = g + 1 + i / inner;
+            // Pixels outside the image are never read.
+            if (x0 + tx < 0 || x0 + tx >= width || y0 + ty < 0
+                || y0 + ty >= height)
+                continue;
+
+            float2 diffuse = 0.F;
+            for (int dy = -1; dy <= 1; ++dy)
+            {
+                const int ny = clamp(y0 + ty + dy, 0, height - 1) - y0;
+                for (int dx = -1; dx <= 1; ++dx)
+                {
+                    const int nx = clamp(x0 + tx + dx, 0, width - 1) - x0;
+                    const float2 _uv = in[ny * pitch + nx];
+
+                    if (abs(dx) + abs(dy) == 0)
+                        diffuse += _uv * -1.F;
+                    else if (abs(dx) + abs(dy) == 1)
+                        diffuse += _uv * 0.2F;
+                    else
+                        diffuse += _uv * 0.05F;
+                }
+            }
+            out[ty * pitch + tx] = react(in[ty * pitch + tx], diffuse);
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        local float2* t = in;
+        in = out;
+        out = t;
+    }
+
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+    if (x >= width || y >= height) return;
+
+    write_imagef(out_data, (int2){ x, y },
+                 (float4){ in[(ly + GENERATIONS) * pitch + lx + GENERATIONS],
+                           0, 1 });
+}
+
+// Converts the state to 8-bit RGBA pixels for the image files, for storage
+// formats other than 8-bit RGBA.
+kernel void to_rgba8(read_only image2d_t in_data, global uchar4* pixels)
+{
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+    const float2 uv = read_imagef(in_data, (int2){ x, y }).xy;
+    pixels[y * get_image_width(in_data) + x] =
+        convert_uchar4_sat_rte((float4){ uv, 0, 1 } * 255.F);
+}
+
+// Copies the concentrations of U and V to a buffer, to compare the results of
+// storage formats.
+kernel void read_state(read_only image2d_t in_data, global float2* state)
+{
+    const int x = get_global_id(0);
+    const int y = get_global_id(1);
+    state[y * get_image_width(in_data) + x] =
+        read_imagef(in_data, (int2){ x, y }).xy;
 }
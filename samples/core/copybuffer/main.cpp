@@ -16,6 +16,11 @@
 
 #include <CL/opencl.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
 struct Sample
 {
     cl::CommandQueue commandQueue;
@@ -46,7 +51,7 @@ static void go(Sample& sample)
                                           bufferSize * sizeof(cl_uint));
 }
 
-static void checkResults(Sample& sample)
+static void checkResults(Sample& sample, FILE* info)
 {
     const cl_uint* pDst = (const cl_uint*)sample.commandQueue.enqueueMapBuffer(
         sample.deviceMemDst, CL_TRUE, CL_MAP_READ, 0,
@@ -74,7 +79,7 @@ static void checkResults(Sample& sample)
     }
     else
     {
-        printf("Success.\n");
+        fprintf(info, "Success.\n");
     }
 
     sample.commandQueue.enqueueUnmapMemObject(sample.deviceMemDst, (void*)pDst);
@@ -83,11 +88,118 @@ static void checkResults(Sample& sample)
     sample.commandQueue.finish();
 }
 
+struct Sweep
+{
+    size_t minSize;
+    size_t maxSize;
+    cl_uint iterations;
+    FILE* out;
+};
+
+// Runs op once to warm up, then iterations times, waiting for every run, and
+// writes a line of results for every size of the sweep, doubling from
+// minSize to maxSize. The bandwidth is the size per mean time.
+template <typename Op>
+static void measure(Sample& sample, const Sweep& sweep, const char* test,
+                    const char* memory, Op op)
+{
+    for (size_t size = sweep.minSize; size <= sweep.maxSize; size *= 2)
+    {
+        op(size);
+        sample.commandQueue.finish();
+
+        double total = 0.0;
+        double best = HUGE_VAL;
+        for (cl_uint i = 0; i < sweep.iterations; i++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            op(size);
+            sample.commandQueue.finish();
+            double seconds = std::chrono::duration<double>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count();
+            total += seconds;
+            best = std::min(best, seconds);
+        }
+
+        double mean = total / sweep.iterations;
+        fprintf(sweep.out, "%s,%s,%llu,%u,%.3f,%.3f,%.3f\n", test, memory,
+                (unsigned long long)size, sweep.iterations, mean * 1e6,
+                best * 1e6, size / mean / 1e9);
+        fflush(sweep.out);
+    }
+}
+
+static void benchmark(Sample& sample, const Sweep& sweep)
+{
+    cl::CommandQueue& queue = sample.commandQueue;
+    cl::Context context = queue.getInfo<CL_QUEUE_CONTEXT>();
+    const size_t maxSize = sweep.maxSize;
+
+    cl::Buffer src{ context, CL_MEM_READ_WRITE, maxSize };
+    cl::Buffer dst{ context, CL_MEM_READ_WRITE, maxSize };
+    // Many implementations back buffers allocated with CL_MEM_ALLOC_HOST_PTR
+    // with pinned host memory, mapping one is a common way to get some.
+    cl::Buffer pinned{ context, CL_MEM_ALLOC_HOST_PTR, maxSize };
+    std::vector<unsigned char> pageable(maxSize);
+    queue.enqueueFillBuffer(src, (cl_uchar)1, 0, maxSize);
+    queue.enqueueFillBuffer(dst, (cl_uchar)2, 0, maxSize);
+
+    fprintf(sweep.out, "test,memory,bytes,iterations,mean_us,min_us,gbps\n");
+
+    measure(sample, sweep, "copy", "device", [&](size_t size) {
+        queue.enqueueCopyBuffer(src, dst, 0, 0, size);
+    });
+
+    // Maps are timed before the pinned buffer is mapped for the transfers
+    // below, as a region must not be mapped for writing twice.
+    for (cl::Buffer* buffer : { &src, &pinned })
+    {
+        const char* memory = buffer == &src ? "device" : "pinned";
+        measure(sample, sweep, "map_read", memory, [&](size_t size) {
+            void* ptr = queue.enqueueMapBuffer(*buffer, CL_FALSE, CL_MAP_READ,
+                                               0, size);
+            queue.enqueueUnmapMemObject(*buffer, ptr);
+        });
+        measure(sample, sweep, "map_write", memory, [&](size_t size) {
+            void* ptr = queue.enqueueMapBuffer(
+                *buffer, CL_FALSE, CL_MAP_WRITE_INVALIDATE_REGION, 0, size);
+            queue.enqueueUnmapMemObject(*buffer, ptr);
+        });
+    }
+
+    void* pinnedPtr = queue.enqueueMapBuffer(
+        pinned, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, maxSize);
+    for (void* host : { (void*)pageable.data(), pinnedPtr })
+    {
+        const char* memory = host == pinnedPtr ? "pinned" : "pageable";
+        measure(sample, sweep, "write", memory, [&](size_t size) {
+            queue.enqueueWriteBuffer(src, CL_FALSE, 0, size, host);
+        });
+        measure(sample, sweep, "read", memory, [&](size_t size) {
+            queue.enqueueReadBuffer(src, CL_FALSE, 0, size, host);
+        });
+    }
+    queue.enqueueUnmapMemObject(pinned, pinnedPtr);
+    queue.finish();
+}
+
+// Largest size of the sweep the device can allocate three buffers of.
+static size_t clampSize(const cl::Device& device, size_t maxSize)
+{
+    cl_ulong limit = std::min(device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>(),
+                              device.getInfo<CL_DEVICE_GLOBAL_MEM_SIZE>() / 4);
+    return static_cast<size_t>(std::min<cl_ulong>(maxSize, limit));
+}
+
 int main(int argc, char** argv)
 {
     bool printUsage = false;
     cl_uint platformIndex = 0;
     cl_uint deviceIndex = 0;
+    bool runBenchmark = false;
+    Sweep sweep{ 4 * 1024, 1024 * 1024 * 1024, 20, stdout };
+    const char* outFileName = NULL;
 
     if (argc < 1)
     {
@@ -115,23 +227,70 @@ int main(int argc, char** argv)
                         static_cast<cl_uint>(strtoul(argv[i], NULL, 10));
                 }
             }
+            else if (!strcmp(argv[i], "-b"))
+            {
+                runBenchmark = true;
+            }
+            else if (!strcmp(argv[i], "-s") || !strcmp(argv[i], "-S"))
+            {
+                size_t& size =
+                    argv[i][1] == 's' ? sweep.minSize : sweep.maxSize;
+                ++i;
+                if (i < argc)
+                {
+                    size = static_cast<size_t>(strtoull(argv[i], NULL, 10));
+                }
+            }
+            else if (!strcmp(argv[i], "-i"))
+            {
+                ++i;
+                if (i < argc)
+                {
+                    sweep.iterations =
+                        static_cast<cl_uint>(strtoul(argv[i], NULL, 10));
+                }
+            }
+            else if (!strcmp(argv[i], "-o"))
+            {
+                ++i;
+                if (i < argc)
+                {
+                    outFileName = argv[i];
+                }
+            }
             else
             {
                 printUsage = true;
             }
         }
     }
+    if (sweep.minSize == 0 || sweep.minSize > sweep.maxSize
+        || sweep.iterations == 0)
+    {
+        printUsage = true;
+    }
     if (printUsage)
     {
         fprintf(stderr,
                 "Usage: copybuffer      [options]\n"
                 "Options:\n"
                 "      -d: Device Index (default = 0)\n"
-                "      -p: Platform Index (default = 0)\n");
+                "      -p: Platform Index (default = 0)\n"
+                "      -b: Benchmark copies, reads, writes and maps\n"
+                "      -s: Smallest size of the benchmark in bytes "
+                "(default = 4096)\n"
+                "      -S: Largest size of the benchmark in bytes "
+                "(default = 1073741824)\n"
+                "      -i: Iterations per size (default = 20)\n"
+                "      -o: CSV file of the benchmark (default = stdout)\n");
 
         return -1;
     }
 
+    // Status messages go to stderr when the CSV is written to stdout, so
+    // that the output can be redirected to a file as is.
+    FILE* info = runBenchmark && outFileName == NULL ? stderr : stdout;
+
     try
     {
         Sample sample;
@@ -139,14 +298,14 @@ int main(int argc, char** argv)
         std::vector<cl::Platform> platforms;
         cl::Platform::get(&platforms);
 
-        printf("Running on platform: %s\n",
-               platforms[platformIndex].getInfo<CL_PLATFORM_NAME>().c_str());
+        fprintf(info, "Running on platform: %s\n",
+                platforms[platformIndex].getInfo<CL_PLATFORM_NAME>().c_str());
 
         std::vector<cl::Device> devices;
         platforms[platformIndex].getDevices(CL_DEVICE_TYPE_ALL, &devices);
 
-        printf("Running on device: %s\n",
-               devices[deviceIndex].getInfo<CL_DEVICE_NAME>().c_str());
+        fprintf(info, "Running on device: %s\n",
+                devices[deviceIndex].getInfo<CL_DEVICE_NAME>().c_str());
 
         cl::Context context{ devices[deviceIndex] };
         sample.commandQueue = cl::CommandQueue{ context, devices[deviceIndex] };
@@ -159,7 +318,26 @@ int main(int argc, char** argv)
 
         init(sample);
         go(sample);
-        checkResults(sample);
+        checkResults(sample, info);
+
+        if (runBenchmark)
+        {
+            sweep.maxSize = clampSize(devices[deviceIndex], sweep.maxSize);
+            if (outFileName != NULL)
+            {
+                sweep.out = fopen(outFileName, "w");
+                if (sweep.out == NULL)
+                {
+                    fprintf(stderr, "Error: Cannot open %s\n", outFileName);
+                    return -1;
+                }
+            }
+            benchmark(sample, sweep);
+            if (sweep.out != stdout)
+            {
+                fclose(sweep.out);
+            }
+        }
     } catch (cl::Error& e)
     {
         printf("OpenCL Error: %s returned %d\n", e.what(), e.err());
@@ -16,6 +16,12 @@
 
 #include <CL/opencl.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+
 struct Sample
 {
     cl::CommandQueue commandQueue;
@@ -32,6 +38,19 @@ kernel void CopyBuffer( global uint* dst, global uint* src )
     uint id = get_global_id(0);
     dst[id] = src[id];
 }
+
+// Same copy with wider loads and stores, for the benchmark
+#define COPY_KERNEL(type)                                           \
+kernel void Copy_##type( global type* dst, global const type* src ) \
+{                                                                   \
+    size_t id = get_global_id(0);                                   \
+    dst[id] = src[id];                                              \
+}
+COPY_KERNEL(uint)
+COPY_KERNEL(uint2)
+COPY_KERNEL(uint4)
+COPY_KERNEL(uint8)
+COPY_KERNEL(uint16)
 )CLC";
 
 static void init(Sample& sample)
@@ -57,7 +76,7 @@ static void go(Sample& sample)
                                              cl::NDRange{ bufferSize });
 }
 
-static void checkResults(Sample& sample)
+static void checkResults(Sample& sample, FILE* info)
 {
     const cl_uint* pDst = (const cl_uint*)sample.commandQueue.enqueueMapBuffer(
         sample.deviceMemDst, CL_TRUE, CL_MAP_READ, 0,
@@ -85,7 +104,7 @@ static void checkResults(Sample& sample)
     }
     else
     {
-        printf("Success.\n");
+        fprintf(info, "Success.\n");
     }
 
     sample.commandQueue.enqueueUnmapMemObject(sample.deviceMemDst, (void*)pDst);
@@ -94,11 +113,101 @@ static void checkResults(Sample& sample)
     sample.commandQueue.finish();
 }
 
+struct Sweep
+{
+    size_t minSize;
+    size_t maxSize;
+    cl_uint iterations;
+    FILE* out;
+};
+
+// Runs op once to warm up, then iterations times, waiting for every run, and
+// writes a line of results for every size of the sweep, doubling from
+// minSize to maxSize. The bandwidth is the size per mean time.
+template <typename Op>
+static void measure(Sample& sample, const Sweep& sweep, const char* test,
+                    const char* memory, Op op)
+{
+    for (size_t size = sweep.minSize; size <= sweep.maxSize; size *= 2)
+    {
+        op(size);
+        sample.commandQueue.finish();
+
+        double total = 0.0;
+        double best = HUGE_VAL;
+        for (cl_uint i = 0; i < sweep.iterations; i++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            op(size);
+            sample.commandQueue.finish();
+            double seconds = std::chrono::duration<double>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count();
+            total += seconds;
+            best = std::min(best, seconds);
+        }
+
+        double mean = total / sweep.iterations;
+        fprintf(sweep.out, "%s,%s,%llu,%u,%.3f,%.3f,%.3f\n", test, memory,
+                (unsigned long long)size, sweep.iterations, mean * 1e6,
+                best * 1e6, size / mean / 1e9);
+        fflush(sweep.out);
+    }
+}
+
+// Times the copy kernels of every width against enqueueCopyBuffer. Every
+// work-item copies one element, sizes are multiples of the widest element.
+static void benchmark(Sample& sample, const cl::Program& program,
+                      const Sweep& sweep)
+{
+    cl::CommandQueue& queue = sample.commandQueue;
+    cl::Context context = queue.getInfo<CL_QUEUE_CONTEXT>();
+
+    cl::Buffer src{ context, CL_MEM_READ_WRITE, sweep.maxSize };
+    cl::Buffer dst{ context, CL_MEM_READ_WRITE, sweep.maxSize };
+    queue.enqueueFillBuffer(src, (cl_uchar)1, 0, sweep.maxSize);
+    queue.enqueueFillBuffer(dst, (cl_uchar)2, 0, sweep.maxSize);
+
+    fprintf(sweep.out, "test,memory,bytes,iterations,mean_us,min_us,gbps\n");
+
+    measure(sample, sweep, "copy", "device", [&](size_t size) {
+        queue.enqueueCopyBuffer(src, dst, 0, 0, size);
+    });
+
+    for (size_t width : { 1, 2, 4, 8, 16 })
+    {
+        std::string type =
+            "uint" + (width > 1 ? std::to_string(width) : std::string{});
+        cl::Kernel kernel{ program, ("Copy_" + type).c_str() };
+        kernel.setArg(0, dst);
+        kernel.setArg(1, src);
+
+        std::string test = "kernel_" + type;
+        measure(sample, sweep, test.c_str(), "device", [&](size_t size) {
+            queue.enqueueNDRangeKernel(
+                kernel, cl::NullRange,
+                cl::NDRange{ size / (width * sizeof(cl_uint)) });
+        });
+    }
+}
+
+// Largest size of the sweep the device can allocate two buffers of,
+// each at most a quarter of the global memory to leave room for others.
+static size_t clampSize(const cl::Device& device, size_t maxSize)
+{
+    cl_ulong limit = std::min(device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>(),
+                              device.getInfo<CL_DEVICE_GLOBAL_MEM_SIZE>() / 4);
+    return static_cast<size_t>(std::min<cl_ulong>(maxSize, limit));
+}
+
 int main(int argc, char** argv)
 {
     bool printUsage = false;
     cl_uint platformIndex = 0;
     cl_uint deviceIndex = 0;
+    bool runBenchmark = false;
+    Sweep sweep{ 4 * 1024, 1024 * 1024 * 1024, 20, stdout };
+    const char* outFileName = NULL;
 
     if (argc < 1)
     {
@@ -126,23 +235,70 @@ int main(int argc, char** argv)
                         static_cast<cl_uint>(strtoul(argv[i], NULL, 10));
                 }
             }
+            else if (!strcmp(argv[i], "-b"))
+            {
+                runBenchmark = true;
+            }
+            else if (!strcmp(argv[i], "-s") || !strcmp(argv[i], "-S"))
+            {
+                size_t& size =
+                    argv[i][1] == 's' ? sweep.minSize : sweep.maxSize;
+                ++i;
+                if (i < argc)
+                {
+                    size = static_cast<size_t>(strtoull(argv[i], NULL, 10));
+                }
+            }
+            else if (!strcmp(argv[i], "-i"))
+            {
+                ++i;
+                if (i < argc)
+                {
+                    sweep.iterations =
+                        static_cast<cl_uint>(strtoul(argv[i], NULL, 10));
+                }
+            }
+            else if (!strcmp(argv[i], "-o"))
+            {
+                ++i;
+                if (i < argc)
+                {
+                    outFileName = argv[i];
+                }
+            }
             else
             {
                 printUsage = true;
             }
         }
     }
+    if (sweep.minSize % (16 * sizeof(cl_uint)) != 0 || sweep.minSize == 0
+        || sweep.minSize > sweep.maxSize || sweep.iterations == 0)
+    {
+        printUsage = true;
+    }
     if (printUsage)
     {
         fprintf(stderr,
                 "Usage: copybufferkernel    [options]\n"
                 "Options:\n"
                 "      -d: Device Index (default = 0)\n"
-                "      -p: Platform Index (default = 0)\n");
+                "      -p: Platform Index (default = 0)\n"
+                "      -b: Benchmark copy kernels of every width\n"
+                "      -s: Smallest size of the benchmark in bytes, a "
+                "multiple of 64 (default = 4096)\n"
+                "      -S: Largest size of the benchmark in bytes "
+                "(default = 1073741824)\n"
+                "      -i: Iterations per size (default = 20)\n"
+                "      -o: CSV file of the benchmark (default = stdout)\n");
 
         return -1;
     }
 
+    // Status messages go to stderr when the CSV is written to stdout, so
+    // that the output can be redirected to a file as is.
+    FILE* info = runBenchmark && outFileName == NULL ? stderr : stdout;
+
     try
     {
         Sample sample;
@@ -150,14 +306,14 @@ int main(int argc, char** argv)
         std::vector<cl::Platform> platforms;
         cl::Platform::get(&platforms);
 
-        printf("Running on platform: %s\n",
-               platforms[platformIndex].getInfo<CL_PLATFORM_NAME>().c_str());
+        fprintf(info, "Running on platform: %s\n",
+                platforms[platformIndex].getInfo<CL_PLATFORM_NAME>().c_str());
 
         std::vector<cl::Device> devices;
         platforms[platformIndex].getDevices(CL_DEVICE_TYPE_ALL, &devices);
 
-        printf("Running on device: %s\n",
-               devices[deviceIndex].getInfo<CL_DEVICE_NAME>().c_str());
+        fprintf(info, "Running on device: %s\n",
+                devices[deviceIndex].getInfo<CL_DEVICE_NAME>().c_str());
 
         cl::Context context{ devices[deviceIndex] };
         sample.commandQueue = cl::CommandQueue{ context, devices[deviceIndex] };
@@ -175,7 +331,26 @@ int main(int argc, char** argv)
 
         init(sample);
         go(sample);
-        checkResults(sample);
+        checkResults(sample, info);
+
+        if (runBenchmark)
+        {
+            sweep.maxSize = clampSize(devices[deviceIndex], sweep.maxSize);
+            if (outFileName != NULL)
+            {
+                sweep.out = fopen(outFileName, "w");
+                if (sweep.out == NULL)
+                {
+                    fprintf(stderr, "Error: Cannot open %s\n", outFileName);
+                    return -1;
+                }
+            }
+            benchmark(sample, program, sweep);
+            if (sweep.out != stdout)
+            {
+                fclose(sweep.out);
+            }
+        }
     } catch (cl::BuildError& e)
     {
         for (const auto& log : e.getBuildLog())
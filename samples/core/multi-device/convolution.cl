@@ -14,6 +14,27 @@
  * limitations under the License.
  */
 
+// Mask dimensions of the generic kernels, set at build time with
+// -DMASK_DIM_X=<n> -DMASK_DIM_Y=<m> so that loops over the mask fully
+// unroll. Both must be odd.
+#ifndef MASK_DIM_X
+#define MASK_DIM_X 3
+#endif
+#ifndef MASK_DIM_Y
+#define MASK_DIM_Y 3
+#endif
+#define PAD_X (MASK_DIM_X / 2)
+#define PAD_Y (MASK_DIM_Y / 2)
+
+// Work-group size of the tiled kernel, every work-group computes a tile of
+// TILE_X x TILE_Y outputs.
+#ifndef TILE_X
+#define TILE_X 16
+#endif
+#ifndef TILE_Y
+#define TILE_Y 16
+#endif
+
 kernel void convolution_3x3(const global float* in, global float* out,
                             const global float* mask, const uint2 out_dim)
 {
@@ -50,3 +71,126 @@ kernel void convolution_3x3(const global float* in, global float* out,
     // Write result to correspoding output cell.
     out[gid.y * out_dim.x + gid.x] = result;
 }
+
+
+// Convolution with a MASK_DIM_X x MASK_DIM_Y mask, input padded with PAD_X
+// columns and PAD_Y rows on both sides.
+kernel void convolution(const global float* in, global float* out,
+                        constant float* mask, const uint2 out_dim)
+{
+    const uint2 gid = (uint2)(get_global_id(0), get_global_id(1));
+    const uint in_dim_x = out_dim.x + 2 * PAD_X;
+
+    // Check possible out of bounds.
+    if (!(gid.x < out_dim.x && gid.y < out_dim.y))
+    {
+        return;
+    }
+
+    // Rows are stored contiguously, so iterate over them in the inner loop.
+    float result = 0.0f;
+    #if __OPENCL_C_VERSION__ >= 200
+    __attribute__((opencl_unroll_hint))
+    #endif
+    for(uint y = 0; y < MASK_DIM_Y; ++y)
+    {
+        #if __OPENCL_C_VERSION__ >= 200
+        __attribute__((opencl_unroll_hint))
+        #endif
+        for(uint x = 0; x < MASK_DIM_X; ++x)
+        {
+            result += mask[y * MASK_DIM_X + x] * in[(gid.y + y) * in_dim_x + (gid.x + x)];
+        }
+    }
+
+    out[gid.y * out_dim.x + gid.x] = result;
+}
+
+// Same as convolution, but every work-group first loads its tile of the input
+// with halos into local memory, so each input element is read from global
+// memory once per work-group instead of once per tap. Must be launched with
+// TILE_X x TILE_Y work-groups.
+kernel __attribute__((reqd_work_group_size(TILE_X, TILE_Y, 1)))
+void convolution_tiled(const global float* in, global float* out,
+                       constant float* mask, const uint2 out_dim)
+{
+    local float tile[TILE_Y + 2 * PAD_Y][TILE_X + 2 * PAD_X];
+
+    const uint2 gid = (uint2)(get_global_id(0), get_global_id(1));
+    const uint2 lid = (uint2)(get_local_id(0), get_local_id(1));
+    const uint2 origin = (uint2)(get_group_id(0) * TILE_X, get_group_id(1) * TILE_Y);
+    const uint2 in_dim = out_dim + (uint2)(2 * PAD_X, 2 * PAD_Y);
+
+    // Halos make the tile larger than the work-group, so work-items load
+    // more than one element. Tiles at the edges may reach past the input.
+    for(uint y = lid.y; y < TILE_Y + 2 * PAD_Y; y += TILE_Y)
+    {
+        for(uint x = lid.x; x < TILE_X + 2 * PAD_X; x += TILE_X)
+        {
+            const uint2 src = origin + (uint2)(x, y);
+            tile[y][x] = (src.x < in_dim.x && src.y < in_dim.y) ? in[src.y * in_dim.x + src.x] : 0.0f;
+        }
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Check possible out of bounds only after the barrier.
+    if (!(gid.x < out_dim.x && gid.y < out_dim.y))
+    {
+        return;
+    }
+
+    float result = 0.0f;
+    #if __OPENCL_C_VERSION__ >= 200
+    __attribute__((opencl_unroll_hint))
+    #endif
+    for(uint y = 0; y < MASK_DIM_Y; ++y)
+    {
+        #if __OPENCL_C_VERSION__ >= 200
+        __attribute__((opencl_unroll_hint))
+        #endif
+        for(uint x = 0; x < MASK_DIM_X; ++x)
+        {
+            result += mask[y * MASK_DIM_X + x] * tile[lid.y + y][lid.x + x];
+        }
+    }
+
+    out[gid.y * out_dim.x + gid.x] = result;
+}
+
+// Convolution of a range of rows of a padded grid, used when iterating the
+// stencil. Rows of the grid are pitch elements apart. Row gid.y of out is row
+// first_row + gid.y of the grid and is padded the same way, so the output of
+// one step can be the input of the next.
+kernel void convolution_rows(const global float* in, global float* out,
+                             constant float* mask, const uint2 out_dim,
+                             const uint pitch, const uint first_row)
+{
+    const uint2 gid = (uint2)(get_global_id(0), get_global_id(1));
+
+    // Check possible out of bounds.
+    if (!(gid.x < out_dim.x && gid.y < out_dim.y))
+    {
+        return;
+    }
+
+    // Rows of the mask start PAD_Y rows above the output row.
+    const global float* window = in + (first_row + gid.y - PAD_Y) * pitch + gid.x;
+
+    float result = 0.0f;
+    #if __OPENCL_C_VERSION__ >= 200
+    __attribute__((opencl_unroll_hint))
+    #endif
+    for(uint y = 0; y < MASK_DIM_Y; ++y)
+    {
+        #if __OPENCL_C_VERSION__ >= 200
+        __attribute__((opencl_unroll_hint))
+        #endif
+        for(uint x = 0; x < MASK_DIM_X; ++x)
+        {
+            result += mask[y * MASK_DIM_X + x] * window[y * pitch + x];
+        }
+    }
+
+    // Skip the padding columns on the left.
+    out[gid.y * pitch + gid.x + PAD_X] = result;
+}
@@ -17,6 +17,8 @@
 // OpenCL SDK includes.
 #include <CL/SDK/CLI.hpp>
 #include <CL/SDK/Context.hpp>
+#include <CL/SDK/DomainDecomposition.hpp>
+#include <CL/SDK/DynamicScheduler.hpp>
 #include <CL/SDK/Options.hpp>
 #include <CL/SDK/Random.hpp>
 
@@ -48,6 +50,9 @@ struct ConvolutionOptions
 {
     cl_uint x_dim;
     cl_uint y_dim;
+    cl_uint mask_x;
+    cl_uint mask_y;
+    cl_uint steps;
 };
 
 // Add option to CLI-parsing SDK utility for input dimensions.
@@ -58,37 +63,52 @@ template <> auto cl::sdk::parse<ConvolutionOptions>()
                                4'096, "positive integral"),
                            std::make_shared<TCLAP::ValueArg<cl_uint>>(
                                "y", "y_dim", "y dimension of input", false,
-                               4'096, "positive integral"));
+                               4'096, "positive integral"),
+                           std::make_shared<TCLAP::ValueArg<cl_uint>>(
+                               "m", "mask_x", "x dimension of mask", false, 3,
+                               "positive odd integral"),
+                           std::make_shared<TCLAP::ValueArg<cl_uint>>(
+                               "n", "mask_y", "y dimension of mask", false, 3,
+                               "positive odd integral"),
+                           std::make_shared<TCLAP::ValueArg<cl_uint>>(
+                               "s", "steps",
+                               "Number of iterated convolution steps, 0 "
+                               "skips the iterative run",
+                               false, 10, "non-negative integral"));
 }
 template <>
 ConvolutionOptions cl::sdk::comprehend<ConvolutionOptions>(
     std::shared_ptr<TCLAP::ValueArg<cl_uint>> x_dim_arg,
-    std::shared_ptr<TCLAP::ValueArg<cl_uint>> y_dim_arg)
+    std::shared_ptr<TCLAP::ValueArg<cl_uint>> y_dim_arg,
+    std::shared_ptr<TCLAP::ValueArg<cl_uint>> mask_x_arg,
+    std::shared_ptr<TCLAP::ValueArg<cl_uint>> mask_y_arg,
+    std::shared_ptr<TCLAP::ValueArg<cl_uint>> steps_arg)
 {
-    return ConvolutionOptions{ x_dim_arg->getValue(), y_dim_arg->getValue() };
+    return ConvolutionOptions{ x_dim_arg->getValue(), y_dim_arg->getValue(),
+                               mask_x_arg->getValue(), mask_y_arg->getValue(),
+                               steps_arg->getValue() };
 }
 
-// Host-side implementation of the convolution for verification. Padded input
-// assumed.
-void host_convolution(const std::vector<cl_float> in,
+// Host-side implementation of the convolution for verification. Input padded
+// with mask_x / 2 columns and mask_y / 2 rows on both sides assumed.
+void host_convolution(const std::vector<cl_float>& in,
                       std::vector<cl_float>& out,
-                      const std::vector<cl_float> mask, const cl_uint x_dim,
-                      const cl_uint y_dim)
+                      const std::vector<cl_float>& mask, const cl_uint x_dim,
+                      const cl_uint y_dim, const cl_uint mask_x,
+                      const cl_uint mask_y)
 {
-    constexpr cl_uint mask_dim = 3;
-    constexpr cl_uint pad_width = mask_dim / 2;
-    const cl_uint in_dim_x = x_dim + pad_width * 2;
+    const cl_uint in_dim_x = x_dim + (mask_x / 2) * 2;
 
-    for (cl_uint gid_x = 0; gid_x < x_dim; ++gid_x)
+    for (cl_uint gid_y = 0; gid_y < y_dim; ++gid_y)
     {
-        for (cl_uint gid_y = 0; gid_y < y_dim; ++gid_y)
+        for (cl_uint gid_x = 0; gid_x < x_dim; ++gid_x)
         {
             float result = 0.f;
-            for (cl_uint y = 0; y < mask_dim; ++y)
+            for (cl_uint y = 0; y < mask_y; ++y)
             {
-                for (cl_uint x = 0; x < mask_dim; ++x)
+                for (cl_uint x = 0; x < mask_x; ++x)
                 {
-                    result += mask[y * mask_dim + x]
+                    result += mask[y * mask_x + x]
                         * in[(gid_y + y) * in_dim_x + (gid_x + x)];
                 }
             }
@@ -103,6 +123,315 @@ bool opencl_version_contains(const cl::string& dev_version,
     return dev_version.find(version_fragment) != cl::string::npos;
 }
 
+// Iterates the convolution, the output of a step being the input of the next.
+// Every sub-device keeps its rows in a buffer of its own, with pad_y halo rows
+// on both sides. Once a sub-device computed the rows at the edges of its
+// range, it copies them into the halos of its neighbours on a second queue
+// while it computes its interior rows. Steps are only ordered by events, the
+// host waits once after enqueueing all of them.
+void iterate_convolution(const cl::Context& context, const cl::Program& program,
+                         const cl::sdk::DomainDecomposition& domain,
+                         const std::vector<cl_float>& h_input_grid,
+                         const std::vector<cl_float>& h_mask,
+                         const ConvolutionOptions& conv_opts,
+                         const cl::sdk::options::Diagnostic& diag_opts)
+{
+    const cl_uint x_dim = conv_opts.x_dim;
+    const cl_uint y_dim = conv_opts.y_dim;
+    const cl_uint steps = conv_opts.steps;
+    const cl_uint pad_x = conv_opts.mask_x / 2;
+    const cl_uint pad_y = conv_opts.mask_y / 2;
+    const cl_uint pad_x_dim = x_dim + 2 * pad_x;
+
+    if (pad_y == 0)
+    {
+        std::cout << "Skipping iterative convolution, a mask of a single row "
+                     "needs no halo exchange."
+                  << std::endl;
+        return;
+    }
+
+    // Only sub-devices owning rows take part, neighbours are the closest
+    // ones owning rows. Edge rows and halos must not overlap.
+    std::vector<cl::sdk::DomainDecomposition::Part> parts;
+    for (const auto& part : domain.parts())
+    {
+        if (part.count == 0) continue;
+        if (part.count < 2 * pad_y)
+        {
+            std::cout << "Skipping iterative convolution, the grid is too "
+                         "small to be split among the sub-devices."
+                      << std::endl;
+            return;
+        }
+        parts.push_back(part);
+    }
+
+    // Normalize the mask such that values neither explode nor vanish when
+    // iterating.
+    std::vector<cl_float> h_step_mask(h_mask);
+    cl_float mask_norm = 0.f;
+    for (auto m : h_mask) mask_norm += std::fabs(m);
+    for (auto& m : h_step_mask) m /= mask_norm;
+    cl::Buffer dev_mask(context,
+                        CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR
+                            | CL_MEM_HOST_NO_ACCESS,
+                        h_step_mask.size() * sizeof(cl_float),
+                        h_step_mask.data());
+
+    // Rows start at aligned offsets, so any range of rows can be a
+    // sub-buffer.
+    const cl_uint align =
+        std::max<cl_uint>(domain.alignment() / sizeof(cl_float), 1);
+    const cl_uint pitch = (pad_x_dim + align - 1) / align * align;
+    const size_t row_bytes = sizeof(cl_float) * pitch;
+    const size_t halo_bytes = row_bytes * pad_y;
+
+    // Every buffer is split into non-overlapping sub-buffers, so that
+    // kernels and copies may access different rows of it concurrently.
+    struct Slab
+    {
+        cl::CommandQueue compute, transfer;
+        cl_uint rows;
+        cl::Buffer grid[2];
+        cl::Buffer top_halo[2], top_rows[2], interior[2], bottom_rows[2],
+            bottom_halo[2];
+    };
+    std::vector<Slab> slabs;
+    for (auto& part : parts)
+    {
+        Slab slab;
+        slab.compute = part.queue;
+        slab.transfer = cl::CommandQueue(context, part.device,
+                                         cl::QueueProperties::Profiling);
+        slab.rows = static_cast<cl_uint>(part.count);
+
+        // Both grids start with padding zeros, the first one also holds the
+        // rows of the input with halos.
+        const size_t grid_rows = slab.rows + 2 * pad_y;
+        std::vector<cl_float> h_grid(grid_rows * pitch, 0.f);
+        for (size_t y = 0; y < grid_rows; ++y)
+            std::copy_n(h_input_grid.begin() + (part.first + y) * pad_x_dim,
+                        pad_x_dim, h_grid.begin() + y * pitch);
+
+        for (int b = 0; b < 2; ++b)
+        {
+            if (b == 1) std::fill(h_grid.begin(), h_grid.end(), 0.f);
+            slab.grid[b] =
+                cl::Buffer(context,
+                           CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR
+                               | CL_MEM_HOST_READ_ONLY,
+                           h_grid.size() * sizeof(cl_float), h_grid.data());
+
+            auto rows_of = [&](size_t first, size_t count) {
+                cl_buffer_region region = { first * row_bytes,
+                                            count * row_bytes };
+                return slab.grid[b].createSubBuffer(
+                    CL_MEM_READ_WRITE, CL_BUFFER_CREATE_TYPE_REGION, &region);
+            };
+            slab.top_halo[b] = rows_of(0, pad_y);
+            slab.top_rows[b] = rows_of(pad_y, pad_y);
+            if (slab.rows > 2 * pad_y)
+                slab.interior[b] =
+                    rows_of(2 * pad_y, slab.rows - 2 * pad_y);
+            slab.bottom_rows[b] = rows_of(slab.rows, pad_y);
+            slab.bottom_halo[b] = rows_of(slab.rows + pad_y, pad_y);
+        }
+        slabs.push_back(slab);
+    }
+
+    cl::KernelFunctor<cl::Buffer, cl::Buffer, cl::Buffer, cl_uint2, cl_uint,
+                      cl_uint>
+        convolution(program, "convolution_rows");
+
+    struct StepEvents
+    {
+        cl::Event top, bottom, last, send_up, send_down;
+    };
+    std::vector<std::vector<StepEvents>> events(
+        steps, std::vector<StepEvents>(slabs.size()));
+
+    if (diag_opts.verbose)
+    {
+        std::cout << "Executing " << steps << " iterated steps on "
+                  << slabs.size() << " sub-devices... ";
+        std::cout.flush();
+    }
+
+    auto dev_start = std::chrono::high_resolution_clock::now();
+
+    const size_t n = slabs.size();
+    for (cl_uint t = 0; t < steps; ++t)
+    {
+        const int cur = t % 2, nxt = 1 - cur;
+        for (size_t a = 0; a < n; ++a)
+        {
+            auto& slab = slabs[a];
+            auto& ev = events[t][a];
+
+            // Halos of cur are sent by the neighbours in the previous step,
+            // edge rows of nxt may still be sent from two steps ago.
+            std::vector<cl::Event> wait;
+            if (t > 0 && a > 0) wait.push_back(events[t - 1][a - 1].send_down);
+            if (t > 0 && a + 1 < n)
+                wait.push_back(events[t - 1][a + 1].send_up);
+            if (t > 1 && a > 0) wait.push_back(events[t - 2][a].send_up);
+            if (t > 1 && a + 1 < n)
+                wait.push_back(events[t - 2][a].send_down);
+
+            const cl::NDRange edge{ x_dim, pad_y };
+            ev.top = convolution(cl::EnqueueArgs{ slab.compute, wait, edge },
+                                 slab.grid[cur], slab.top_rows[nxt], dev_mask,
+                                 { { x_dim, pad_y } }, pitch, pad_y);
+            ev.bottom = convolution(cl::EnqueueArgs{ slab.compute, edge },
+                                    slab.grid[cur], slab.bottom_rows[nxt],
+                                    dev_mask, { { x_dim, pad_y } }, pitch,
+                                    slab.rows);
+
+            // Send edge rows once computed. A neighbour's halo may only be
+            // overwritten once it finished reading it in the previous step.
+            if (a > 0)
+            {
+                std::vector<cl::Event> deps{ ev.top };
+                if (t > 0) deps.push_back(events[t - 1][a - 1].last);
+                slab.transfer.enqueueCopyBuffer(
+                    slab.top_rows[nxt], slabs[a - 1].bottom_halo[nxt], 0, 0,
+                    halo_bytes, &deps, &ev.send_up);
+            }
+            if (a + 1 < n)
+            {
+                std::vector<cl::Event> deps{ ev.bottom };
+                if (t > 0) deps.push_back(events[t - 1][a + 1].last);
+                slab.transfer.enqueueCopyBuffer(
+                    slab.bottom_rows[nxt], slabs[a + 1].top_halo[nxt], 0, 0,
+                    halo_bytes, &deps, &ev.send_down);
+            }
+
+            // Interior rows only depend on rows of the same sub-device.
+            if (slab.rows > 2 * pad_y)
+            {
+                const cl_uint interior_rows = slab.rows - 2 * pad_y;
+                ev.last = convolution(
+                    cl::EnqueueArgs{ slab.compute,
+                                     cl::NDRange{ x_dim, interior_rows } },
+                    slab.grid[cur], slab.interior[nxt], dev_mask,
+                    { { x_dim, interior_rows } }, pitch, 2 * pad_y);
+            }
+            else
+                ev.last = ev.bottom;
+
+            // Commands waiting for events of other queues only make progress
+            // if those queues were flushed.
+            slab.compute.flush();
+            slab.transfer.flush();
+        }
+    }
+    for (auto& slab : slabs)
+    {
+        slab.compute.finish();
+        slab.transfer.finish();
+    }
+
+    auto dev_end = std::chrono::high_resolution_clock::now();
+
+    if (diag_opts.verbose)
+    {
+        std::cout << "done.\nExecuting on host... ";
+        std::cout.flush();
+    }
+
+    // Reference iterates the padded host-side convolution.
+    std::vector<cl_float> h_grid(h_input_grid), h_output_grid(x_dim * y_dim);
+    for (cl_uint t = 0; t < steps; ++t)
+    {
+        host_convolution(h_grid, h_output_grid, h_step_mask, x_dim, y_dim,
+                         conv_opts.mask_x, conv_opts.mask_y);
+        for (cl_uint y = 0; y < y_dim; ++y)
+            std::copy_n(h_output_grid.begin() + y * x_dim, x_dim,
+                        h_grid.begin() + (y + pad_y) * pad_x_dim + pad_x);
+    }
+
+    if (diag_opts.verbose)
+    {
+        std::cout << "done." << std::endl;
+    }
+
+    // Fetch owned rows of every sub-device and validate them.
+    cl_float deviation = 0.f;
+    const cl_float tolerance = 1e-5;
+    for (size_t a = 0; a < n; ++a)
+    {
+        std::vector<cl_float> h_slab((slabs[a].rows + 2 * pad_y) * pitch);
+        cl::copy(slabs[a].compute, slabs[a].grid[steps % 2], h_slab.begin(),
+                 h_slab.end());
+        for (cl_uint y = 0; y < slabs[a].rows; ++y)
+            for (cl_uint x = 0; x < x_dim; ++x)
+                deviation += std::fabs(
+                    h_slab[(y + pad_y) * pitch + x + pad_x]
+                    - h_output_grid[(parts[a].first + y) * x_dim + x]);
+    }
+    deviation /= h_output_grid.size();
+
+    if (deviation > tolerance)
+    {
+        std::cerr << "Failed iterative convolution! Normalized deviation "
+                  << deviation
+                  << " between host and device exceeds tolerance "
+                  << tolerance << std::endl;
+    }
+    else
+    {
+        std::cout << "Successful iterative convolution!" << std::endl;
+    }
+
+    if (diag_opts.quiet) return;
+
+    const auto dev_time = std::chrono::duration<double>(dev_end - dev_start);
+    std::cout << steps << " steps on " << n << " sub-devices as seen by host: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(
+                     dev_time)
+                     .count()
+              << " us (" << steps / dev_time.count() << " steps/s)."
+              << std::endl;
+
+    if (n < 2) return;
+
+    // Overlap efficiency is the fraction of the time spent copying edge rows
+    // during which the sending sub-device computed its interior rows.
+    // Intervals compared are measured by the same device.
+    auto interval = [](const cl::Event& event) {
+        return std::make_pair(
+            event.getProfilingInfo<CL_PROFILING_COMMAND_START>(),
+            event.getProfilingInfo<CL_PROFILING_COMMAND_END>());
+    };
+    double total_efficiency = 0.0;
+    for (cl_uint t = 0; t < steps; ++t)
+    {
+        double hidden = 0.0, exchange = 0.0;
+        for (size_t a = 0; a < n; ++a)
+        {
+            const auto& ev = events[t][a];
+            const auto compute = interval(ev.last);
+            for (const auto* send : { &ev.send_up, &ev.send_down })
+            {
+                if ((*send)() == nullptr) continue;
+                const auto copy = interval(*send);
+                exchange += copy.second - copy.first;
+                const auto begin = std::max(copy.first, compute.first);
+                const auto end = std::min(copy.second, compute.second);
+                if (end > begin) hidden += end - begin;
+            }
+        }
+        const double efficiency = exchange > 0.0 ? hidden / exchange : 1.0;
+        total_efficiency += efficiency;
+        if (diag_opts.verbose)
+            std::cout << "  - step " << t << ": overlap efficiency "
+                      << 100.0 * efficiency << "%" << std::endl;
+    }
+    std::cout << "Average overlap efficiency of halo exchange: "
+              << 100.0 * total_efficiency / steps << "%" << std::endl;
+}
+
 int main(int argc, char* argv[])
 {
     try
@@ -115,6 +444,9 @@ int main(int argc, char* argv[])
         const auto& dev_opts = std::get<1>(opts);
         const auto& conv_opts = std::get<2>(opts);
 
+        if (conv_opts.mask_x % 2 == 0 || conv_opts.mask_y % 2 == 0)
+            throw std::invalid_argument{ "Mask dimensions must be odd." };
+
         // Create runtime objects based on user preference or default.
         cl::Device dev = cl::sdk::get_context(dev_opts.triplet)
                              .getInfo<CL_CONTEXT_DEVICES>()
@@ -168,32 +500,37 @@ int main(int argc, char* argv[])
             exit(EXIT_SUCCESS);
         }
 
-        // Check if the "partition equally" type is supported.
-        if (std::find(dev_props.begin(), dev_props.end(),
-                      CL_DEVICE_PARTITION_EQUALLY)
-            == dev_props.end())
+        // Create subdevices, preferably one per NUMA node or L3 cache so
+        // that every sub-device works on memory close to it, otherwise two
+        // with half of the compute units each.
+        cl::util::Partition partition;
+        try
+        {
+            partition = cl::util::partition_device(dev, 2);
+        } catch (cl::util::Error& e)
         {
-            std::cout << "This sample requires partition equally, which is a "
-                         "partition scheme available from OpenCL 1.2 on, but "
-                         "the device chosen does not seem to support it. "
-                         "Please try with a different OpenCL device instead."
+            if (e.err() != CL_DEVICE_PARTITION_FAILED) throw;
+            std::cout << "This sample requires partitioning the device into "
+                         "at least two sub-devices, but the device chosen "
+                         "does not seem to support it. Please try with a "
+                         "different OpenCL device instead."
                       << std::endl;
             exit(EXIT_SUCCESS);
         }
+        const std::vector<cl::Device>& subdevices = partition.sub_devices;
 
-        // Create subdevices, each with half of the compute units available.
-        cl_uint max_compute_units = dev.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
-        cl_device_partition_property subdevices_properties[] = {
-            CL_DEVICE_PARTITION_EQUALLY,
-            static_cast<cl_device_partition_property>(max_compute_units / 2), 0
-        };
-        std::vector<cl::Device> subdevices{};
-        dev.createSubDevices(subdevices_properties, &subdevices);
-
-        if (subdevices.size() < 2)
+        if (diag_opts.verbose)
         {
-            std::cerr << "Error: OpenCL cannot create subdevices" << std::endl;
-            exit(EXIT_FAILURE);
+            std::cout << " " << subdevices.size() << " sub-devices by "
+                      << (partition.scheme
+                                  == CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN
+                              ? (partition.affinity_domain
+                                         == CL_DEVICE_AFFINITY_DOMAIN_NUMA
+                                     ? "NUMA node"
+                                     : "L3 cache")
+                              : "compute units")
+                      << "...";
+            std::cout.flush();
         }
 
         cl::Context context(subdevices);
@@ -235,19 +572,28 @@ int main(int argc, char* argv[])
                                 ? compiler_opt_str
                                 : "" };
         }
+
+        // Mask and tile dimensions are compile-time constants of the kernels,
+        // so that loops over the mask unroll and tiles have a fixed size.
+        constexpr cl_uint tile_x = 16;
+        constexpr cl_uint tile_y = 16;
+        compiler_options += "-DMASK_DIM_X=" + std::to_string(conv_opts.mask_x)
+            + " -DMASK_DIM_Y=" + std::to_string(conv_opts.mask_y)
+            + " -DTILE_X=" + std::to_string(tile_x)
+            + " -DTILE_Y=" + std::to_string(tile_y);
         program.build(subdevices, compiler_options.c_str());
 
         // Initialize host-side storage.
-        constexpr cl_uint mask_dim = 3;
-        constexpr cl_uint pad_width = mask_dim / 2;
+        const cl_uint pad_x = conv_opts.mask_x / 2;
+        const cl_uint pad_y = conv_opts.mask_y / 2;
         const cl_uint x_dim = conv_opts.x_dim;
         const cl_uint y_dim = conv_opts.y_dim;
-        const cl_uint pad_x_dim = x_dim + 2 * pad_width;
-        const cl_uint pad_y_dim = y_dim + 2 * pad_width;
+        const cl_uint pad_x_dim = x_dim + 2 * pad_x;
+        const cl_uint pad_y_dim = y_dim + 2 * pad_y;
 
         const size_t input_size = pad_x_dim * pad_y_dim;
         const size_t output_size = x_dim * y_dim;
-        const size_t mask_size = mask_dim * mask_dim;
+        const size_t mask_size = conv_opts.mask_x * conv_opts.mask_y;
         const size_t input_bytes = sizeof(cl_float) * input_size;
         const size_t output_bytes = sizeof(cl_float) * output_size;
         const size_t mask_bytes = sizeof(cl_float) * mask_size;
@@ -280,8 +626,8 @@ int main(int argc, char* argv[])
         {
             for (cl_uint x = 0; x < pad_x_dim; ++x)
             {
-                if (x == 0 || y == 0 || x == (pad_x_dim - 1)
-                    || y == (pad_y_dim - 1))
+                if (x < pad_x || y < pad_y || x >= (pad_x_dim - pad_x)
+                    || y >= (pad_y_dim - pad_y))
                 {
                     h_input_grid[y * pad_x_dim + x] = 0;
                 }
@@ -303,19 +649,17 @@ int main(int argc, char* argv[])
 
         // Create device buffers, from which we will create the subbuffers for
         // the subdevices.
-        const cl_uint grid_midpoint = y_dim / 2;
-        const cl_uint pad_grid_midpoint = pad_y_dim / 2;
-
         if (diag_opts.verbose)
         {
             std::cout << "done.\nInitializing device-side storage...";
             std::cout.flush();
         }
 
+        // Grids are filled later, once it is known which sub-device works on
+        // which rows.
         cl::Buffer dev_input_grid(context,
-                                  CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR
-                                      | CL_MEM_HOST_NO_ACCESS,
-                                  input_bytes, h_input_grid.data());
+                                  CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY,
+                                  input_bytes);
         cl::Buffer dev_output_grid(context,
                                    CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR
                                        | CL_MEM_HOST_READ_ONLY,
@@ -331,108 +675,130 @@ int main(int argc, char* argv[])
             std::cout.flush();
         }
 
-        // Set up subdevices for kernel execution.
-        const size_t half_input_bytes =
-            sizeof(cl_float) * pad_x_dim * (pad_grid_midpoint + 1);
-        const size_t input_offset =
-            sizeof(cl_float) * pad_x_dim * (pad_grid_midpoint - 1);
-        const size_t half_output_bytes =
-            sizeof(cl_float) * x_dim * grid_midpoint;
-
-        std::vector<
-            cl::KernelFunctor<cl::Buffer, cl::Buffer, cl::Buffer, cl_uint2>>
-            convolutions{};
-        std::vector<cl::CommandQueue> sub_queues{};
-        std::vector<cl::Buffer> sub_input_grids{}, sub_output_grids{};
-
-        for (size_t i = 0; i < subdevices.size(); ++i)
+        // Split the rows of the output among the sub-devices. Every range of
+        // output rows needs pad_y more input rows on both sides, which the
+        // padding provides at the edges of the grid.
+        const size_t input_row_bytes = sizeof(cl_float) * pad_x_dim;
+        const size_t output_row_bytes = sizeof(cl_float) * x_dim;
+        cl::sdk::DomainDecomposition domain(context, subdevices);
+        domain.decompose(y_dim, { input_row_bytes, output_row_bytes },
+                         pad_y);
+        domain.set_weights(partition.weights);
+
+        // Sub-devices initialize the rows they will work on first, so pages
+        // of the grids are placed in memory close to them.
         {
-            auto subdevice = subdevices[i];
-
-            if (diag_opts.verbose)
+            std::vector<cl::CommandQueue> queues;
+            std::vector<size_t> input_boundaries, output_boundaries;
+            for (const auto& part : domain.parts())
             {
-                std::cout
-                    << "\n  Creating kernel and command queue of sub-device "
-                    << i << "...";
-                std::cout.flush();
+                queues.push_back(part.queue);
+                input_boundaries.push_back(part.first * input_row_bytes);
+                output_boundaries.push_back(part.first * output_row_bytes);
             }
+            input_boundaries.push_back(input_bytes);
+            output_boundaries.push_back(output_bytes);
+            cl::util::first_touch(dev_input_grid, queues, input_boundaries);
+            cl::util::first_touch(dev_output_grid, queues, output_boundaries);
+
+            queues.front().enqueueWriteBuffer(dev_input_grid, CL_BLOCKING, 0,
+                                              input_bytes,
+                                              h_input_grid.data());
+        }
 
-            auto convolution = cl::Kernel(program, "convolution_3x3");
-
-            cl::CommandQueue queue(context, subdevice,
-                                   cl::QueueProperties::Profiling);
-
-            // Initialize device-side storage.
-            // First device performs the convolution in the upper half and
-            // second device in the lower half (middle borders included).
-            if (diag_opts.verbose)
-            {
-                std::cout << "done.\n  Initializing device-side storage of "
-                             "sub-device "
-                          << i << "...";
-                std::cout.flush();
-            }
-
-            cl_buffer_region input_region = { i * input_offset,
-                                              half_input_bytes },
-                             output_region = { i * half_output_bytes,
-                                               half_output_bytes };
-
-            const cl_uint align =
-                subdevice.getInfo<CL_DEVICE_MEM_BASE_ADDR_ALIGN>();
-            if (input_region.origin % align || output_region.origin % align)
-            {
-                std::cerr << "Error: Memory should be aligned to "
-                          << subdevice.getInfo<CL_DEVICE_MEM_BASE_ADDR_ALIGN>()
-                          << std::endl;
-                exit(EXIT_FAILURE);
-            }
+        // Prefer the kernel caching tiles of the input in local memory, if
+        // every device can run work-groups of the size of a tile.
+        const cl::Kernel tiled_kernel(program, "convolution_tiled");
+        const bool tiled = std::all_of(
+            subdevices.begin(), subdevices.end(), [&](const cl::Device& dev) {
+                const auto sizes = dev.getInfo<CL_DEVICE_MAX_WORK_ITEM_SIZES>();
+                return tiled_kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(
+                           dev)
+                    >= tile_x * tile_y
+                    && sizes.size() >= 2 && sizes[0] >= tile_x
+                    && sizes[1] >= tile_y;
+            });
+        cl::KernelFunctor<cl::Buffer, cl::Buffer, cl::Buffer, cl_uint2>
+            convolution(program, tiled ? "convolution_tiled" : "convolution");
 
-            cl::Buffer sub_input_grid = dev_input_grid.createSubBuffer(
-                CL_MEM_READ_ONLY, CL_BUFFER_CREATE_TYPE_REGION, &input_region);
-            cl::Buffer sub_output_grid = dev_output_grid.createSubBuffer(
-                CL_MEM_WRITE_ONLY, CL_BUFFER_CREATE_TYPE_REGION,
-                &output_region);
+        if (diag_opts.verbose)
+        {
+            std::cout << "\n  Using " << (tiled ? "tiled " : "")
+                      << "convolution kernel with " << conv_opts.mask_x << "x"
+                      << conv_opts.mask_y << " mask...";
+            std::cout.flush();
+        }
 
-            if (diag_opts.verbose)
+        // Sub-buffers depend on the decomposition, so they are recreated
+        // whenever it changes.
+        std::vector<cl::Buffer> sub_input_grids{}, sub_output_grids{};
+        auto create_sub_buffers = [&]() {
+            sub_input_grids.clear();
+            sub_output_grids.clear();
+            for (size_t i = 0; i < domain.parts().size(); ++i)
             {
-                std::cout << "done.";
-                std::cout.flush();
+                if (domain.parts()[i].count == 0)
+                {
+                    sub_input_grids.emplace_back();
+                    sub_output_grids.emplace_back();
+                    continue;
+                }
+                sub_input_grids.push_back(domain.with_halo(
+                    i, dev_input_grid, input_row_bytes, CL_MEM_READ_ONLY));
+                sub_output_grids.push_back(domain.owned(
+                    i, dev_output_grid, output_row_bytes, CL_MEM_WRITE_ONLY));
             }
-
-            convolutions.push_back(convolution);
-            sub_queues.push_back(queue);
-            sub_input_grids.push_back(sub_input_grid);
-            sub_output_grids.push_back(sub_output_grid);
-        }
+        };
+        // Convolution of rows output rows, given sub-buffers holding them and
+        // the input rows they need.
+        auto enqueue_rows = [&](cl::CommandQueue& queue, const cl::Buffer& in,
+                                const cl::Buffer& out, const cl_uint rows) {
+            if (!tiled)
+                return convolution(
+                    cl::EnqueueArgs{ queue, cl::NDRange{ x_dim, rows } }, in,
+                    out, dev_mask, { { x_dim, rows } });
+
+            // Whole tiles are launched, kernel checks for out of bounds.
+            const cl::NDRange global{ (x_dim + tile_x - 1) / tile_x * tile_x,
+                                      (rows + tile_y - 1) / tile_y * tile_y };
+            return convolution(
+                cl::EnqueueArgs{ queue, global, cl::NDRange{ tile_x, tile_y } },
+                in, out, dev_mask, { { x_dim, rows } });
+        };
+        auto enqueue_convolution =
+            [&](size_t i, cl::sdk::DomainDecomposition::Part& part) {
+                return enqueue_rows(part.queue, sub_input_grids[i],
+                                    sub_output_grids[i],
+                                    static_cast<cl_uint>(part.count));
+            };
 
         // Launch kernels.
         if (diag_opts.verbose)
         {
-            std::cout << "\nExecuting on device... ";
+            std::cout << "done.\nMeasuring throughput of sub-devices...";
             std::cout.flush();
         }
 
-        // Initialize global and local buffers for device execution.
-        const cl::NDRange global{ x_dim, y_dim };
+        // A first run with the initial estimates measures the throughput of
+        // the sub-devices, the grid is then split according to it.
+        create_sub_buffers();
+        auto kernel_runs = domain.launch(enqueue_convolution);
+        cl::sdk::DomainDecomposition::join(kernel_runs);
+        domain.rebalance(kernel_runs);
+        create_sub_buffers();
+
+        if (diag_opts.verbose)
+        {
+            std::cout << "done.\nExecuting on device... ";
+            std::cout.flush();
+        }
 
         // Enqueue kernel calls and wait for them to finish.
-        std::vector<cl::Event> dev1_kernel_runs;
-        dev1_kernel_runs.reserve(1);
-        std::vector<cl::Event> dev2_kernel_runs;
-        dev2_kernel_runs.reserve(1);
         auto dev_start = std::chrono::high_resolution_clock::now();
 
-        dev1_kernel_runs.push_back(convolutions[0](
-            cl::EnqueueArgs{ sub_queues[0], global }, sub_input_grids[0],
-            sub_output_grids[0], dev_mask, { { x_dim, grid_midpoint } }));
+        kernel_runs = domain.launch(enqueue_convolution);
+        cl::sdk::DomainDecomposition::join(kernel_runs);
 
-        dev2_kernel_runs.push_back(convolutions[1](
-            cl::EnqueueArgs{ sub_queues[1], global }, sub_input_grids[1],
-            sub_output_grids[1], dev_mask, { { x_dim, grid_midpoint } }));
-
-        cl::WaitForEvents(dev1_kernel_runs);
-        cl::WaitForEvents(dev2_kernel_runs);
         auto dev_end = std::chrono::high_resolution_clock::now();
 
         // Compute reference host-side convolution.
@@ -443,7 +809,8 @@ int main(int argc, char* argv[])
         }
         auto host_start = std::chrono::high_resolution_clock::now();
 
-        host_convolution(h_input_grid, h_output_grid, h_mask, x_dim, y_dim);
+        host_convolution(h_input_grid, h_output_grid, h_mask, x_dim, y_dim,
+                         conv_opts.mask_x, conv_opts.mask_y);
 
         auto host_end = std::chrono::high_resolution_clock::now();
 
@@ -454,12 +821,13 @@ int main(int argc, char* argv[])
 
         // Fetch and combine results from devices.
         std::vector<cl_float> concatenated_results(output_size);
-        cl::copy(sub_queues.front(), dev_output_grid,
+        cl::copy(domain.parts().front().queue, dev_output_grid,
                  concatenated_results.begin(), concatenated_results.end());
 
         // Validate device-side solution.
+        // Rounding errors grow with the number of taps of the mask.
         cl_float deviation = 0.f;
-        const cl_float tolerance = 1e-6;
+        const cl_float tolerance = 1e-6f * mask_size;
 
         for (size_t i = 0; i < concatenated_results.size(); ++i)
         {
@@ -488,28 +856,121 @@ int main(int argc, char* argv[])
                       << " us." << std::endl;
             std::cout << "Kernels execution time as measured by devices: "
                       << std::endl;
-            for (auto& pass : dev1_kernel_runs)
-                std::cout << "  - "
-                          << cl::util::get_duration<CL_PROFILING_COMMAND_START,
-                                                    CL_PROFILING_COMMAND_END,
-                                                    std::chrono::microseconds>(
-                                 pass)
-                                 .count()
-                          << " us." << std::endl;
-            for (auto& pass : dev2_kernel_runs)
-                std::cout << "  - "
-                          << cl::util::get_duration<CL_PROFILING_COMMAND_START,
-                                                    CL_PROFILING_COMMAND_END,
-                                                    std::chrono::microseconds>(
-                                 pass)
-                                 .count()
-                          << " us." << std::endl;
+            for (size_t i = 0; i < domain.parts().size(); ++i)
+            {
+                const auto& part = domain.parts()[i];
+                std::cout << "  - sub-device " << i << ", rows "
+                          << part.first << " to " << part.first + part.count
+                          << ": ";
+                if (part.count != 0)
+                    std::cout
+                        << cl::util::get_duration<CL_PROFILING_COMMAND_START,
+                                                  CL_PROFILING_COMMAND_END,
+                                                  std::chrono::microseconds>(
+                               kernel_runs[i])
+                               .count()
+                        << " us." << std::endl;
+                else
+                    std::cout << "idle." << std::endl;
+            }
             std::cout << "Reference execution as seen by host: "
                       << std::chrono::duration_cast<std::chrono::microseconds>(
                              host_end - host_start)
                              .count()
                       << " us." << std::endl;
         }
+
+        // Run the convolution again, handing out chunks of rows to the
+        // sub-devices as they become idle instead of splitting the rows
+        // beforehand. Chunks start at multiples of the granularity of the
+        // decomposition, so their sub-buffers are aligned.
+        if (diag_opts.verbose)
+        {
+            std::cout << "Executing on device with dynamic scheduling... ";
+            std::cout.flush();
+        }
+
+        std::vector<cl::CommandQueue> sub_queues;
+        for (const auto& part : domain.parts())
+            sub_queues.push_back(part.queue);
+        cl::sdk::DynamicScheduler scheduler(sub_queues, domain.granularity(),
+                                            tile_y);
+
+        auto dyn_start = std::chrono::high_resolution_clock::now();
+
+        scheduler.run(
+            y_dim,
+            [&](size_t, cl::CommandQueue& queue,
+                const cl::sdk::DynamicScheduler::Chunk& chunk) {
+                cl_buffer_region input_region = { chunk.first
+                                                      * input_row_bytes,
+                                                  (chunk.count + 2 * pad_y)
+                                                      * input_row_bytes },
+                                 output_region = { chunk.first
+                                                       * output_row_bytes,
+                                                   chunk.count
+                                                       * output_row_bytes };
+                return enqueue_rows(
+                    queue,
+                    dev_input_grid.createSubBuffer(
+                        CL_MEM_READ_ONLY, CL_BUFFER_CREATE_TYPE_REGION,
+                        &input_region),
+                    dev_output_grid.createSubBuffer(
+                        CL_MEM_WRITE_ONLY, CL_BUFFER_CREATE_TYPE_REGION,
+                        &output_region),
+                    static_cast<cl_uint>(chunk.count));
+            });
+
+        auto dyn_end = std::chrono::high_resolution_clock::now();
+
+        if (diag_opts.verbose)
+        {
+            std::cout << "done." << std::endl;
+        }
+
+        cl::copy(sub_queues.front(), dev_output_grid,
+                 concatenated_results.begin(), concatenated_results.end());
+        deviation = 0.f;
+        for (size_t i = 0; i < concatenated_results.size(); ++i)
+        {
+            deviation += std::fabs(concatenated_results[i] - h_output_grid[i]);
+        }
+        deviation /= concatenated_results.size();
+
+        if (deviation > tolerance)
+        {
+            std::cerr << "Failed dynamically scheduled convolution! "
+                         "Normalized deviation "
+                      << deviation
+                      << " between host and device exceeds tolerance "
+                      << tolerance << std::endl;
+        }
+        else
+        {
+            std::cout << "Successful dynamically scheduled convolution!"
+                      << std::endl;
+        }
+
+        if (!diag_opts.quiet)
+        {
+            std::cout << "Dynamically scheduled execution time as seen by "
+                         "host: "
+                      << std::chrono::duration_cast<std::chrono::microseconds>(
+                             dyn_end - dyn_start)
+                             .count()
+                      << " us." << std::endl;
+            for (size_t i = 0; i < scheduler.statistics().size(); ++i)
+            {
+                const auto& stat = scheduler.statistics()[i];
+                std::cout << "  - sub-device " << i << ": " << stat.items
+                          << " rows in " << stat.chunks << " chunks, "
+                          << stat.throughput << " rows/s." << std::endl;
+            }
+        }
+
+        if (conv_opts.steps != 0)
+            iterate_convolution(context, program, domain, h_input_grid, h_mask,
+                                conv_opts, diag_opts);
     } catch (cl::BuildError& e)
     {
         std::cerr << "OpenCL build error: " << e.what() << std::endl;
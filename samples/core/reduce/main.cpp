@@ -20,6 +20,7 @@
 #include <CL/SDK/Options.hpp>
 #include <CL/SDK/CLI.hpp>
 #include <CL/SDK/Random.hpp>
+#include <CL/SDK/SVM.hpp>
 
 // STL includes
 #include <iostream>
@@ -38,6 +39,7 @@ struct ReduceOptions
 {
     size_t length;
     std::string op;
+    bool svm;
 };
 
 std::unique_ptr<TCLAP::ValuesConstraint<std::string>> valid_op_constraint;
@@ -55,14 +57,21 @@ template <> auto cl::sdk::parse<ReduceOptions>()
                                1'048'576, "positive integral"),
                            std::make_shared<TCLAP::ValueArg<std::string>>(
                                "o", "op", "Operation to perform", false, "min",
-                               valid_op_constraint.get()));
+                               valid_op_constraint.get()),
+                           std::make_shared<TCLAP::SwitchArg>(
+                               "s", "svm",
+                               "Also reduce in shared virtual memory and "
+                               "compare with copying buffers",
+                               false));
 }
 template <>
 ReduceOptions cl::sdk::comprehend<ReduceOptions>(
     std::shared_ptr<TCLAP::ValueArg<size_t>> length_arg,
-    std::shared_ptr<TCLAP::ValueArg<std::string>> op_arg)
+    std::shared_ptr<TCLAP::ValueArg<std::string>> op_arg,
+    std::shared_ptr<TCLAP::SwitchArg> svm_arg)
 {
-    return ReduceOptions{ length_arg->getValue(), op_arg->getValue() };
+    return ReduceOptions{ length_arg->getValue(), op_arg->getValue(),
+                          svm_arg->getValue() };
 }
 
 
@@ -215,13 +224,23 @@ int main(int argc, char* argv[])
                      dist = std::uniform_int_distribution<cl_int>{
                          -1000, 1000 }]() mutable { return dist(engine); };
 
+        // Generates the same input for the SVM path
+        auto svm_prng = prng;
+
         std::vector<cl_int> arr(length);
         if (diag_opts.verbose)
             std::cout << "Generating " << length
                       << " random numbers for reduction." << std::endl;
         cl::sdk::fill_with_random(prng, arr);
 
+        // calculate reference dataset, before the copy path is timed
+        auto host_start = std::chrono::high_resolution_clock::now();
+        auto seq_ref =
+            std::accumulate(arr.cbegin(), arr.cend(), zero_elem, host_op);
+        auto host_end = std::chrono::high_resolution_clock::now();
+
         // Initialize device-side storage
+        auto copy_start = std::chrono::high_resolution_clock::now();
         cl::Buffer front{ queue, std::begin(arr), std::end(arr), false },
             back{ context, CL_MEM_READ_WRITE,
                   static_cast<cl::size_type>(new_size(arr.size())
@@ -249,15 +268,10 @@ int main(int argc, char* argv[])
         auto dev_end = std::chrono::high_resolution_clock::now();
         if (diag_opts.verbose) std::cout << "done." << std::endl;
 
-        // calculate reference dataset
-        auto host_start = std::chrono::high_resolution_clock::now();
-        auto seq_ref =
-            std::accumulate(arr.cbegin(), arr.cend(), zero_elem, host_op);
-        auto host_end = std::chrono::high_resolution_clock::now();
-
         // Fetch results
         cl_int dev_res;
         cl::copy(queue, back, &dev_res, &dev_res + 1);
+        auto copy_end = std::chrono::high_resolution_clock::now();
 
         // Validate
         if (dev_res != seq_ref)
@@ -289,6 +303,82 @@ int main(int argc, char* argv[])
                              .count()
                       << " us." << std::endl;
         }
+
+        // Reduce the same input in shared virtual memory. The host generates
+        // the input in place and reads the result where the last pass left
+        // it, so no buffer is copied. On devices sharing memory with the
+        // host, for eg. integrated GPUs and CPUs, this removes the transfers
+        // the copy path needs.
+        if (reduce_opts.svm)
+        {
+            const auto grain = cl::sdk::svm_grain(context);
+            if (grain == cl::sdk::SVMGrain::None)
+            {
+                std::cout << "Device does not support SVM buffers, skipping "
+                             "the SVM path."
+                          << std::endl;
+                return 0;
+            }
+
+            auto reduce_svm =
+                cl::KernelFunctor<cl_int*, cl_int*, cl::LocalSpaceArg,
+                                  cl_ulong, cl_int>(program, "reduce");
+            cl::sdk::SVMVector<cl_int> svm_front{ context, arr.size(), grain },
+                svm_back{ context, new_size(arr.size()), grain };
+
+            // Generate the same input as before directly into SVM. Host STL
+            // algorithms work on the container as on any other.
+            svm_front.map(queue, CL_MAP_WRITE_INVALIDATE_REGION);
+            cl::sdk::fill_with_random(svm_prng, svm_front);
+
+            auto svm_start = std::chrono::high_resolution_clock::now();
+            svm_front.unmap(queue);
+            cl_int* in = svm_front.data();
+            cl_int* out = svm_back.data();
+            curr = static_cast<cl_ulong>(arr.size());
+            while (curr > 1)
+            {
+                reduce_svm(cl::EnqueueArgs{ queue, (size_t)global(curr), wgs },
+                           in, out, cl::Local(factor * sizeof(cl_int)), curr,
+                           zero_elem);
+
+                curr = static_cast<cl_ulong>(new_size(curr));
+                if (curr > 1) std::swap(in, out);
+            }
+            // Mapping waits for the passes, fine-grained memory needs an
+            // explicit wait.
+            cl::sdk::SVMVector<cl_int>& result =
+                out == svm_back.data() ? svm_back : svm_front;
+            if (grain == cl::sdk::SVMGrain::Fine) queue.finish();
+            result.map(queue, CL_MAP_READ);
+            const cl_int svm_res = result[0];
+            auto svm_end = std::chrono::high_resolution_clock::now();
+            result.unmap(queue);
+            queue.finish();
+
+            if (svm_res != seq_ref)
+            {
+                std::cerr << "Sequential reference: " << seq_ref << std::endl;
+                std::cerr << "SVM result: " << svm_res << std::endl;
+                throw std::runtime_error{ "SVM validation failed!" };
+            }
+
+            if (!diag_opts.quiet)
+                std::cout << "Including transfers, copying buffers took "
+                          << std::chrono::duration_cast<
+                                 std::chrono::microseconds>(copy_end
+                                                            - copy_start)
+                                 .count()
+                          << " us, "
+                          << (grain == cl::sdk::SVMGrain::Fine ? "fine"
+                                                               : "coarse")
+                          << "-grained SVM took "
+                          << std::chrono::duration_cast<
+                                 std::chrono::microseconds>(svm_end
+                                                            - svm_start)
+                                 .count()
+                          << " us." << std::endl;
+        }
     } catch (cl::util::Error& e)
     {
         std::cerr << "OpenCL Utils error: " << e.what() << std::endl;
@@ -17,6 +17,7 @@
 // OpenCL SDK includes
 #include <CL/Utils/Context.hpp>
 #include <CL/Utils/File.hpp>
+#include <CL/SDK/Blas.hpp>
 #include <CL/SDK/Context.hpp>
 #include <CL/SDK/Options.hpp>
 #include <CL/SDK/CLI.hpp>
@@ -27,7 +28,10 @@
 #include <valarray>
 #include <random>
 #include <algorithm>
+#include <chrono>
+#include <cmath> // std::abs
 #include <fstream>
+#include <functional> // std::function
 #include <tuple> // std::make_tuple
 
 // TCLAP includes
@@ -37,20 +41,35 @@
 struct SaxpyOptions
 {
     size_t length;
+    bool benchmark;
+    size_t iterations;
 };
 
 // Add option to CLI parsing SDK utility
 template <> auto cl::sdk::parse<SaxpyOptions>()
 {
-    return std::make_tuple(std::make_shared<TCLAP::ValueArg<size_t>>(
-        "l", "length", "Length of input", false, 1'048'576,
-        "positive integral"));
+    return std::make_tuple(
+        std::make_shared<TCLAP::ValueArg<size_t>>("l", "length",
+                                                  "Length of input", false,
+                                                  1'048'576,
+                                                  "positive integral"),
+        std::make_shared<TCLAP::SwitchArg>(
+            "b", "benchmark",
+            "Time the BLAS-1 operations of the SDK library against "
+            "enqueueCopyBuffer",
+            false),
+        std::make_shared<TCLAP::ValueArg<size_t>>(
+            "i", "iterations", "Launches of every operation to time", false,
+            10, "positive integral"));
 }
 template <>
 SaxpyOptions cl::sdk::comprehend<SaxpyOptions>(
-    std::shared_ptr<TCLAP::ValueArg<size_t>> length_arg)
+    std::shared_ptr<TCLAP::ValueArg<size_t>> length_arg,
+    std::shared_ptr<TCLAP::SwitchArg> benchmark_arg,
+    std::shared_ptr<TCLAP::ValueArg<size_t>> iterations_arg)
 {
-    return SaxpyOptions{ length_arg->getValue() };
+    return SaxpyOptions{ length_arg->getValue(), benchmark_arg->getValue(),
+                         iterations_arg->getValue() };
 }
 
 std::valarray<float> fma(float x, std::valarray<float> y,
@@ -67,6 +86,82 @@ std::valarray<float> fma(float x, std::valarray<float> y,
         throw std::logic_error("Different sizes!");
 }
 
+// Checks the BLAS-1 operations of the SDK library on vectors of length
+// floats, then times them and reports their bandwidth relative to
+// enqueueCopyBuffer, which moves the same bytes as fast as the runtime can.
+void run_benchmark(const cl::Context& context, const cl::Device& device,
+                   cl::CommandQueue& queue, size_t length, size_t iterations)
+{
+    cl::sdk::Blas blas{ context, device, queue };
+    const cl::size_type bytes = length * sizeof(cl_float);
+    cl::Buffer x{ context, CL_MEM_READ_WRITE, bytes },
+        y{ context, CL_MEM_READ_WRITE, bytes },
+        z{ context, CL_MEM_READ_WRITE, bytes };
+    queue.enqueueFillBuffer(x, 1.f, 0, bytes);
+    queue.enqueueFillBuffer(y, 2.f, 0, bytes);
+    queue.enqueueFillBuffer(z, -1.f, 0, bytes);
+
+    // Every element contributes a small integer, so the sums are exact up to
+    // the rounding of the partial results.
+    auto check = [&](const char* name, double result, double expected) {
+        if (std::abs(result - expected) > 1e-5 * std::abs(expected))
+            throw std::runtime_error{ std::string{ "Verification of " } + name
+                                      + " FAILED!" };
+    };
+    const double n = static_cast<double>(length);
+    blas.axpy(2.f, x, y, length); // y = 4
+    check("dot", blas.dot(x, y, length), 4 * n);
+    check("asum", blas.asum(z, length), n);
+    check("nrm2", blas.nrm2(y, length), 4 * std::sqrt(n));
+    blas.scal(0.5f, y, length); // y = 2
+    check("axpby_dot", blas.axpby_dot(1.f, x, 2.f, y, y, length),
+          25 * n); // y = 5
+    check("axpby", blas.asum(y, length), 5 * n);
+    std::cout << "Verification of the BLAS-1 operations passed with vector "
+                 "width "
+              << blas.vector_width() << "." << std::endl;
+
+    // Seconds per call of op, after a warm-up call
+    auto time = [&](const std::function<void()>& op) {
+        op();
+        queue.finish();
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; ++i) op();
+        queue.finish();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                             - start)
+                   .count()
+            / iterations;
+    };
+    const double copy =
+        time([&]() { queue.enqueueCopyBuffer(x, z, 0, 0, bytes); });
+    auto report = [&](const char* name, double seconds, int vectors) {
+        const double bandwidth = vectors * bytes / seconds / 1e9;
+        std::cout << name << ": " << seconds * 1e6 << " us, " << bandwidth
+                  << " GB/s, " << 100 * bandwidth / (2 * bytes / copy / 1e9)
+                  << "% of copy" << std::endl;
+    };
+    report("copy", copy, 2);
+    // The operations keep the vectors finite, y converges to x.
+    report("axpy", time([&]() { blas.axpy(0.f, x, y, length); }), 3);
+    report("axpby",
+           time([&]() { blas.axpby(0.5f, x, 0.5f, y, length); }), 3);
+    report("scal", time([&]() { blas.scal(1.f, y, length); }), 2);
+    report("dot", time([&]() { blas.dot(x, y, length); }), 2);
+    report("nrm2", time([&]() { blas.nrm2(y, length); }), 1);
+    report("asum", time([&]() { blas.asum(y, length); }), 1);
+    // Both move the same data, the fused operation in one pass less.
+    report("axpby, dot", time([&]() {
+               blas.axpby(0.5f, x, 0.5f, y, length);
+               blas.dot(y, z, length);
+           }),
+           5);
+    report("axpby_dot", time([&]() {
+               blas.axpby_dot(0.5f, x, 0.5f, y, z, length);
+           }),
+           4);
+}
+
 int main(int argc, char* argv[])
 {
     try
@@ -137,6 +232,10 @@ int main(int argc, char* argv[])
         else
             throw std::runtime_error{ "Verification FAILED!" };
 
+        if (saxpy_opts.benchmark)
+            run_benchmark(context, device, queue, length,
+                          saxpy_opts.iterations);
+
         return 0;
     } catch (cl::util::Error& e)
     {
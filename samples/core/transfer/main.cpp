@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2023 The Khronos Group Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// OpenCL SDK includes
+#include <CL/SDK/CLI.hpp>
+#include <CL/SDK/Context.hpp>
+#include <CL/SDK/Options.hpp>
+#include <CL/Utils/Context.hpp>
+#include <CL/Utils/Staging.hpp>
+
+// STL includes
+#include <algorithm>
+#include <chrono>
+#include <cstring> // std::memcpy
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <numeric> // std::iota
+#include <tuple> // std::make_tuple
+#include <vector>
+
+// TCLAP includes
+#include <tclap/CmdLine.h>
+
+// Sample-specific options
+struct TransferOptions
+{
+    size_t size;
+    size_t repeat;
+};
+
+// Add option to CLI parsing SDK utility
+template <> auto cl::sdk::parse<TransferOptions>()
+{
+    return std::make_tuple(std::make_shared<TCLAP::ValueArg<size_t>>(
+                               "s", "size", "Size of a transfer in MiB", false,
+                               16, "positive integral"),
+                           std::make_shared<TCLAP::ValueArg<size_t>>(
+                               "r", "repeat", "Number of transfers per path",
+                               false, 10, "positive integral"));
+}
+template <>
+TransferOptions cl::sdk::comprehend<TransferOptions>(
+    std::shared_ptr<TCLAP::ValueArg<size_t>> size_arg,
+    std::shared_ptr<TCLAP::ValueArg<size_t>> repeat_arg)
+{
+    return TransferOptions{ size_arg->getValue(), repeat_arg->getValue() };
+}
+
+namespace {
+
+struct Bandwidth
+{
+    double best, average; // GB/s
+};
+
+// Calls transfer repeat times and returns the bandwidth of moving bytes in
+// each call.
+template <typename F>
+Bandwidth measure(size_t bytes, size_t repeat, F&& transfer)
+{
+    using clock = std::chrono::high_resolution_clock;
+    double best = std::numeric_limits<double>::max(), total = 0.0;
+    for (size_t i = 0; i < repeat; ++i)
+    {
+        const auto start = clock::now();
+        transfer();
+        const double seconds =
+            std::chrono::duration<double>(clock::now() - start).count();
+        best = std::min(best, seconds);
+        total += seconds;
+    }
+    return Bandwidth{ bytes / best * 1e-9, bytes * repeat / total * 1e-9 };
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        // Parse command-line options
+        auto opts = cl::sdk::parse_cli<cl::sdk::options::Diagnostic,
+                                       cl::sdk::options::SingleDevice,
+                                       TransferOptions>(argc, argv);
+        const auto& diag_opts = std::get<0>(opts);
+        const auto& dev_opts = std::get<1>(opts);
+        const auto& transfer_opts = std::get<2>(opts);
+
+        // Create runtime objects based on user preference or default
+        cl::Context context = cl::sdk::get_context(dev_opts.triplet);
+        cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>().at(0);
+        cl::CommandQueue queue{ context, device };
+        cl::Platform platform{
+            device.getInfo<CL_DEVICE_PLATFORM>()
+        }; // https://github.com/KhronosGroup/OpenCL-CLHPP/issues/150
+
+        if (!diag_opts.quiet)
+        {
+            std::cout << "Selected platform: "
+                      << platform.getInfo<CL_PLATFORM_VENDOR>() << "\n"
+                      << "Selected device: " << device.getInfo<CL_DEVICE_NAME>()
+                      << "\n"
+                      << std::endl;
+        }
+
+        const size_t bytes = transfer_opts.size * 1024 * 1024;
+        const size_t repeat = std::max<size_t>(transfer_opts.repeat, 1);
+        const size_t length = bytes / sizeof(cl_uint);
+
+        std::vector<cl_uint> source(length), result(length);
+        std::iota(source.begin(), source.end(), 0);
+
+        cl::Buffer device_buffer{ context, CL_MEM_READ_WRITE, bytes };
+        cl::util::StagingPool pool{ context, queue };
+
+        // Every path moves source to the device and back to result, then
+        // the result is validated.
+        auto validate = [&](const char* path) {
+            if (!std::equal(source.begin(), source.end(), result.begin()))
+                throw std::runtime_error{ std::string{ "Validation of the " }
+                                          + path + " path FAILED!" };
+            std::fill(result.begin(), result.end(), 0);
+        };
+        auto report = [&](const char* path, const Bandwidth& upload,
+                          const Bandwidth& download) {
+            std::cout << std::left << std::setw(24) << path << std::right
+                      << std::fixed << std::setprecision(2) << std::setw(10)
+                      << upload.best << std::setw(10) << upload.average
+                      << std::setw(10) << download.best << std::setw(10)
+                      << download.average << std::endl;
+        };
+
+        std::cout << std::left << std::setw(24) << "Path" << std::right
+                  << std::setw(20) << "host->device GB/s" << std::setw(20)
+                  << "device->host GB/s" << "\n"
+                  << std::setw(34) << "best" << std::setw(10) << "average"
+                  << std::setw(10) << "best" << std::setw(10) << "average"
+                  << std::endl;
+
+        // Pageable: the implementation typically stages the transfer through
+        // an internal pinned buffer, copying on the host.
+        {
+            const auto upload = measure(bytes, repeat, [&]() {
+                queue.enqueueWriteBuffer(device_buffer, CL_TRUE, 0, bytes,
+                                         source.data());
+            });
+            const auto download = measure(bytes, repeat, [&]() {
+                queue.enqueueReadBuffer(device_buffer, CL_TRUE, 0, bytes,
+                                        result.data());
+            });
+            validate("pageable");
+            report("pageable", upload, download);
+        }
+
+        // Pinned, pooled: the host side is a block of the staging pool, which
+        // the device may access by DMA. The host copies data in or out of the
+        // block, which is part of the measured time.
+        {
+            auto block = pool.acquire(bytes);
+            const auto upload = measure(bytes, repeat, [&]() {
+                std::memcpy(block.data(), source.data(), bytes);
+                queue.enqueueWriteBuffer(device_buffer, CL_TRUE, 0, bytes,
+                                         block.data());
+            });
+            const auto download = measure(bytes, repeat, [&]() {
+                queue.enqueueReadBuffer(device_buffer, CL_TRUE, 0, bytes,
+                                        block.data());
+                std::memcpy(result.data(), block.data(), bytes);
+            });
+            validate("pinned");
+            report("pinned (pooled)", upload, download);
+        }
+
+        // Pinned, allocated per transfer: acquiring after trimming the pool
+        // creates and maps a new buffer every time, showing the cost of
+        // allocation churn the pool avoids.
+        {
+            auto transfer_fresh = [&](bool upload) {
+                pool.trim();
+                auto block = pool.acquire(bytes);
+                if (upload)
+                {
+                    std::memcpy(block.data(), source.data(), bytes);
+                    queue.enqueueWriteBuffer(device_buffer, CL_TRUE, 0, bytes,
+                                             block.data());
+                }
+                else
+                {
+                    queue.enqueueReadBuffer(device_buffer, CL_TRUE, 0, bytes,
+                                            block.data());
+                    std::memcpy(result.data(), block.data(), bytes);
+                }
+            };
+            const auto upload =
+                measure(bytes, repeat, [&]() { transfer_fresh(true); });
+            const auto download =
+                measure(bytes, repeat, [&]() { transfer_fresh(false); });
+            validate("pinned per transfer");
+            report("pinned (per transfer)", upload, download);
+        }
+
+        // Mapped: the device buffer itself is mapped. Devices sharing memory
+        // with the host may map it without copying.
+        {
+            const auto upload = measure(bytes, repeat, [&]() {
+                void* ptr = queue.enqueueMapBuffer(
+                    device_buffer, CL_TRUE, CL_MAP_WRITE_INVALIDATE_REGION, 0,
+                    bytes);
+                std::memcpy(ptr, source.data(), bytes);
+                queue.enqueueUnmapMemObject(device_buffer, ptr);
+                queue.finish();
+            });
+            const auto download = measure(bytes, repeat, [&]() {
+                void* ptr = queue.enqueueMapBuffer(device_buffer, CL_TRUE,
+                                                   CL_MAP_READ, 0, bytes);
+                std::memcpy(result.data(), ptr, bytes);
+                queue.enqueueUnmapMemObject(device_buffer, ptr);
+                queue.finish();
+            });
+            validate("mapped");
+            report("mapped", upload, download);
+        }
+
+        if (diag_opts.verbose)
+        {
+            const auto stats = pool.statistics();
+            std::cout << "\nStaging pool: " << stats.allocations
+                      << " buffers created, " << stats.reuses
+                      << " blocks reused, " << stats.high_water
+                      << " bytes at most." << std::endl;
+        }
+        std::cout << "\nVerification passed." << std::endl;
+
+        return 0;
+    } catch (cl::util::Error& e)
+    {
+        std::cerr << "OpenCL Utils error: " << e.what() << std::endl;
+        std::exit(e.err());
+    } catch (cl::BuildError& e)
+    {
+        std::cerr << "OpenCL runtime error: " << e.what() << std::endl;
+        for (auto& build_log : e.getBuildLog())
+        {
+            std::cerr << "\tBuild log for device: "
+                      << build_log.first.getInfo<CL_DEVICE_NAME>() << "\n"
+                      << std::endl;
+            std::cerr << build_log.second << "\n" << std::endl;
+        }
+        std::exit(e.err());
+    } catch (cl::Error& e)
+    {
+        std::cerr << "OpenCL runtime error: " << e.what() << std::endl;
+        std::exit(e.err());
+    } catch (std::exception& e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    return 0;
+}
@@ -23,3 +23,143 @@ __kernel void conway(
         (count == 3 ? 1 : 0)
     );
 }
+
+// Bit-packed variant: every bit of a word is a cell, bit i of word w of a row
+// being the cell in column 32 * w + i. A work-item updates a whole word. The
+// work-group first stages its words with a halo of one word and one row in
+// local memory, wrapping around the edges of the grid like the image sampler.
+
+// Words holding the west and east neighbors of the cells of word c, given the
+// words west and east of it.
+uint west(uint c, uint w) { return (c << 1) | (w >> 31); }
+uint east(uint c, uint e) { return (c >> 1) | (e << 31); }
+
+// Bitwise full adder of 32 independent one-bit sums
+void full_add(uint a, uint b, uint c, uint* sum, uint* carry)
+{
+    uint t = a ^ b;
+    *sum = t ^ c;
+    *carry = (a & b) | (t & c);
+}
+
+// Next generation of the cells of word c of a tile pitch words wide, from the
+// words around it.
+uint next_word(__local const uint* tile, int c, int pitch)
+{
+    uint up = tile[c - pitch], self = tile[c], down = tile[c + pitch];
+    uint n0 = west(up, tile[c - pitch - 1]), n1 = up,
+         n2 = east(up, tile[c - pitch + 1]);
+    uint n3 = west(self, tile[c - 1]), n4 = east(self, tile[c + 1]);
+    uint n5 = west(down, tile[c + pitch - 1]), n6 = down,
+         n7 = east(down, tile[c + pitch + 1]);
+
+    // Neighbor count of every cell in binary, ones + 2 * twos + 4 * fours
+    uint s_a, c_a, s_b, c_b, ones, c_d, twos, c_e;
+    full_add(n0, n1, n2, &s_a, &c_a);
+    full_add(n3, n4, n5, &s_b, &c_b);
+    uint s_c = n6 ^ n7, c_c = n6 & n7;
+    full_add(s_a, s_b, s_c, &ones, &c_d);
+    full_add(c_a, c_b, c_c, &twos, &c_e);
+    uint fours = c_e | (twos & c_d);
+    twos ^= c_d;
+
+    // Alive with 3 neighbors, or with 2 if alive before
+    return twos & ~fours & (ones | self);
+}
+
+__kernel void conway_packed(
+    __global const uint* front,
+    __global uint* back,
+    uint words_per_row,
+    uint rows,
+    __local uint* tile
+)
+{
+    int lx = get_local_id(0), ly = get_local_id(1);
+    int sx = get_local_size(0), sy = get_local_size(1);
+    int pitch = sx + 2;
+    int x0 = get_group_id(0) * sx - 1, y0 = get_group_id(1) * sy - 1;
+    for (int i = ly * sx + lx; i < pitch * (sy + 2); i += sx * sy)
+    {
+        uint x = (x0 + i % pitch + words_per_row) % words_per_row;
+        uint y = (y0 + i / pitch + rows) % rows;
+        tile[i] = front[y * words_per_row + x];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    uint gx = get_global_id(0), gy = get_global_id(1);
+    if (gx >= words_per_row || gy >= rows) return;
+
+    back[gy * words_per_row + gx] =
+        next_word(tile, (ly + 1) * pitch + lx + 1, pitch);
+}
+
+// Temporally blocked variant of conway_packed, advancing GENERATIONS
+// generations per launch. The work-group stages its words with a halo of two
+// words and GENERATIONS rows, then steps between two tiles in local memory and
+// writes its words once. The outermost words and rows miss neighbors and are
+// never updated, which corrupts one more column and row of cells every
+// generation. The rows of the halo absorb that, and the 32 columns of the
+// inner halo word do for up to 32 generations.
+#ifndef GENERATIONS
+#define GENERATIONS 8
+#endif
+
+__kernel void conway_blocked(
+    __global const uint* front,
+    __global uint* back,
+    uint words_per_row,
+    uint rows,
+    __local uint* tiles // two tiles of (sx + 4) * (sy + 2 * GENERATIONS) words
+)
+{
+    int lx = get_local_id(0), ly = get_local_id(1);
+    int sx = get_local_size(0), sy = get_local_size(1);
+    int pitch = sx + 4, height = sy + 2 * GENERATIONS, size = pitch * height;
+    int x0 = get_group_id(0) * sx - 2,
+        y0 = get_group_id(1) * sy - GENERATIONS;
+    int w = words_per_row, r = rows;
+    for (int i = ly * sx + lx; i < size; i += sx * sy)
+    {
+        int x = ((x0 + i % pitch) % w + w) % w;
+        int y = ((y0 + i / pitch) % r + r) % r;
+        // The edge columns are read but never updated in either tile.
+        tiles[i] = tiles[size + i] = front[y * words_per_row + x];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Generation g only updates the rows the words of the work-group still
+    // depend on, which shrink by one row from each side every generation.
+    __local uint* in = tiles;
+    __local uint* out = tiles + size;
+    for (int g = 0; g < GENERATIONS; ++g)
+    {
+        int first = (g + 1) * pitch, last = (height - 1 - g) * pitch;
+        for (int i = first + ly * sx + lx; i < last; i += sx * sy)
+        {
+            int x = i % pitch;
+            if (x != 0 && x != pitch - 1) out[i] = next_word(in, i, pitch);
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        __local uint* t = in;
+        in = out;
+        out = t;
+    }
+
+    uint gx = get_global_id(0), gy = get_global_id(1);
+    if (gx >= words_per_row || gy >= rows) return;
+
+    back[gy * words_per_row + gx] = in[(ly + GENERATIONS) * pitch + lx + 2];
+}
+
+// Expands bit-packed cells to an image of one cell per texel for display.
+__kernel void unpack(
+    __global const uint* cells,
+    uint words_per_row,
+    __write_only image2d_t image
+)
+{
+    int x = get_global_id(0), y = get_global_id(1);
+    uint word = cells[y * words_per_row + x / 32];
+    write_imageui(image, (int2)(x, y), (uint4)((word >> (x % 32)) & 1u));
+}
@@ -23,38 +23,108 @@
 #include <CL/Utils/Utils.hpp>
 
 // STL includes
+#include <array>
 #include <iostream>
 #include <valarray>
 #include <random>
 #include <algorithm>
 #include <fstream>
+#include <memory> // std::unique_ptr
+#include <stdexcept>
+#include <string>
 #include <tuple> // std::make_tuple
 
 // OpenGL includes
 #include <SFML/Graphics.hpp>
 #include <SFML/OpenGL.hpp>
 
-template <typename T> struct DoubleBuffer
+struct ConwayOptions
 {
-    T front, back;
-
-    void swap() { std::swap(front, back); }
+    std::string kernel;
+    std::size_t generations;
 };
 
+std::unique_ptr<TCLAP::ValuesConstraint<std::string>> valid_kernel_constraint;
+
+template <> auto cl::sdk::parse<ConwayOptions>()
+{
+    std::vector<std::string> valid_kernel_strings{ "image", "packed",
+                                                   "blocked" };
+    valid_kernel_constraint =
+        std::make_unique<TCLAP::ValuesConstraint<std::string>>(
+            valid_kernel_strings);
+
+    return std::make_tuple(
+        std::make_shared<TCLAP::ValueArg<std::string>>(
+            "k", "kernel",
+            "Step kernel: image stores a cell per texel, packed 32 cells per "
+            "word, blocked runs several generations of packed cells per launch",
+            false, "image", valid_kernel_constraint.get()),
+        std::make_shared<TCLAP::ValueArg<std::size_t>>(
+            "g", "generations",
+            "Generations per launch of the blocked kernel, at most 32", false,
+            8, "positive integral"));
+}
+
+template <>
+ConwayOptions cl::sdk::comprehend<ConwayOptions>(
+    std::shared_ptr<TCLAP::ValueArg<std::string>> kernel_arg,
+    std::shared_ptr<TCLAP::ValueArg<std::size_t>> generations_arg)
+{
+    return ConwayOptions{ kernel_arg->getValue(), generations_arg->getValue() };
+}
+
+// Random cells, one byte per cell, alive if 1.
+std::vector<cl_uchar> random_cells(std::size_t count)
+{
+    std::vector<cl_uchar> cells;
+    std::generate_n(
+        std::back_inserter(cells), count,
+        [prng = std::ranlux48{ std::random_device{}() },
+         dist = std::uniform_int_distribution<std::uint16_t>{
+             0, 1 }]() mutable { return static_cast<cl_uchar>(dist(prng)); });
+    return cells;
+}
+
+// Packs cells of one byte each into bits, 32 cells per word.
+std::vector<cl_uint> pack_cells(const std::vector<cl_uchar>& cells)
+{
+    std::vector<cl_uint> words((cells.size() + 31) / 32, 0);
+    for (std::size_t i = 0; i < cells.size(); ++i)
+        words[i / 32] |= static_cast<cl_uint>(cells[i] & 1) << (i % 32);
+    return words;
+}
+
+std::vector<cl_uchar> unpack_cells(const std::vector<cl_uint>& words,
+                                   std::size_t count)
+{
+    std::vector<cl_uchar> cells(count);
+    for (std::size_t i = 0; i < count; ++i)
+        cells[i] = static_cast<cl_uchar>((words[i / 32] >> (i % 32)) & 1);
+    return cells;
+}
+
 class Conway : public cl::sdk::InteropWindow {
 public:
     explicit Conway(int width, int height, bool fullscreen,
                     cl_uint platform_id = 0, cl_uint device_id = 0,
-                    cl_bitfield device_type = CL_DEVICE_TYPE_DEFAULT)
+                    cl_bitfield device_type = CL_DEVICE_TYPE_DEFAULT,
+                    std::string kernel_name = "image",
+                    std::size_t generations = 8,
+                    const cl::sdk::options::Headless& headless =
+                        cl::sdk::options::Headless{ false, 0, 0 })
         : InteropWindow(
             sf::VideoMode(width, height), "Conway's Game of Life",
             fullscreen ? sf::Style::Fullscreen : sf::Style::Default,
             sf::ContextSettings{ 0, 0, 0, // Depth, Stencil, AA
                                  3, 3, // OpenGL version
                                  sf::ContextSettings::Attribute::Core },
-            platform_id, device_id, device_type),
-          animating(true)
-    {}
+            platform_id, device_id, device_type, headless),
+          kernel_name(std::move(kernel_name)), generations(generations),
+          animating(true), latest(0)
+    {
+        initial = random_cells(getSize().x * getSize().y);
+    }
 
 protected:
     virtual void
@@ -71,10 +141,14 @@ protected:
         override; // Function that handles render area resize
 
 private:
+    std::string kernel_name;
+    std::size_t generations; // per launch of the blocked kernel
+    std::vector<cl_uchar> initial; // cells, one byte each
+
     // OpenGL objects
     cl_GLuint vertex_shader, fragment_shader, gl_program;
     cl_GLuint vertex_buffer, vertex_array;
-    DoubleBuffer<cl_GLuint> gl_images;
+    std::array<cl_GLuint, 3> gl_images;
 
     // OpenCL objects
     cl::Device device;
@@ -83,9 +157,29 @@ private:
     cl::Kernel kernel;
     cl::Sampler sampler;
 
-    DoubleBuffer<cl::ImageGL> cl_images;
+    // Three copies of the cells, shared with OpenGL unless headless. The copy
+    // rendered holds the result of the last steps. The steps in flight read
+    // it and write the other two in turns, so they never write the copy
+    // being drawn.
+    std::array<cl::Image, 3> cl_images;
+    cl::Event simulated; // completion of the last steps
     cl::vector<cl::Memory> interop_resources;
     bool animating;
+    std::size_t latest; // copy of the cells to render
+
+    // Bit-packed cells and kernels, used by the packed and blocked kernels
+    // only. Steps alternate between the buffers, and unpack into an image for
+    // display.
+    cl::Kernel packed_kernel, blocked_kernel, unpack_kernel;
+    cl::NDRange packed_global, packed_local;
+    cl_uint words_per_row;
+    cl::Buffer packed_front, packed_back;
+
+    cl::Event packed_step(cl::Kernel& step_kernel, const cl::Buffer& front,
+                          const cl::Buffer& back);
+    cl::Event packed_steps(cl::Buffer& front, cl::Buffer& back,
+                           std::size_t count);
+    void check_packed(std::size_t count);
 };
 
 inline bool checkError(const char* Title)
@@ -219,16 +313,9 @@ void Conway::initializeGL()
     glBindVertexArray(0);
     checkError("glBindVertexArray(0)");
 
-    std::vector<GLchar> texels;
-    std::generate_n(
-        std::back_inserter(texels), getSize().x * getSize().y,
-        [prng = std::ranlux48{ std::random_device{}() },
-         dist = std::uniform_int_distribution<std::uint16_t>{
-             0, 1 }]() mutable { return static_cast<GLchar>(dist(prng)); });
-
     glUseProgram(gl_program);
     checkError("");
-    for (auto image : { &gl_images.front, &gl_images.back })
+    for (auto image : { &gl_images[0], &gl_images[1], &gl_images[2] })
     {
         glGenTextures(1, image);
         checkError("glGenTextures(1, image);");
@@ -237,7 +324,7 @@ void Conway::initializeGL()
         glBindTexture(GL_TEXTURE_2D, *image);
         checkError("glBindTexture(GL_TEXTURE_2D, *image);");
         glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, getSize().x, getSize().y, 0,
-                     GL_RED_INTEGER, GL_UNSIGNED_BYTE, texels.data());
+                     GL_RED_INTEGER, GL_UNSIGNED_BYTE, initial.data());
         checkError(
             "glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, getSize().x, getSize().y, "
             "0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, texels.data())");
@@ -274,57 +361,231 @@ void Conway::initializeCL()
     cl_program =
         cl::Program{ opencl_context,
                      cl::util::read_exe_relative_text_file("conway.cl") };
-    cl_program.build(device);
+    cl_program.build(device,
+                     ("-DGENERATIONS=" + std::to_string(generations)).c_str());
     kernel = cl::Kernel{ cl_program, "conway" };
 
+    if (kernel_name != "image")
+    {
+        if (getSize().x % 32 != 0)
+            throw std::invalid_argument{ "The packed kernel needs a width "
+                                         "that is a multiple of 32." };
+        words_per_row = getSize().x / 32;
+        if (generations < 1 || generations > 32)
+            throw std::invalid_argument{ "The blocked kernel runs 1 to 32 "
+                                         "generations per launch." };
+        packed_kernel = cl::Kernel{ cl_program, "conway_packed" };
+        blocked_kernel = cl::Kernel{ cl_program, "conway_blocked" };
+        unpack_kernel = cl::Kernel{ cl_program, "unpack" };
+
+        // Work-groups of up to 8x8 words, as many as the device runs
+        std::size_t local_x = 8, local_y = 8;
+        const std::size_t max_group = std::min(
+            packed_kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device),
+            blocked_kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(
+                device));
+        while (local_x * local_y > max_group)
+        {
+            if (local_y >= local_x)
+                local_y /= 2;
+            else
+                local_x /= 2;
+        }
+        packed_local = cl::NDRange{ local_x, local_y };
+        packed_global =
+            cl::NDRange{ (words_per_row + local_x - 1) / local_x * local_x,
+                         (getSize().y + local_y - 1) / local_y * local_y };
+        packed_kernel.setArg(2, words_per_row);
+        packed_kernel.setArg(3, static_cast<cl_uint>(getSize().y));
+        packed_kernel.setArg(
+            4, cl::Local((local_x + 2) * (local_y + 2) * sizeof(cl_uint)));
+        unpack_kernel.setArg(1, words_per_row);
+
+        // Two tiles with a halo of two words and a row per generation
+        const std::size_t tiles_size =
+            2 * (local_x + 4) * (local_y + 2 * generations) * sizeof(cl_uint);
+        if (kernel_name == "blocked"
+            && tiles_size > device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>())
+            throw std::invalid_argument{ "The tiles of the blocked kernel "
+                                         "exceed the local memory, run "
+                                         "fewer generations per launch." };
+        blocked_kernel.setArg(2, words_per_row);
+        blocked_kernel.setArg(3, static_cast<cl_uint>(getSize().y));
+        blocked_kernel.setArg(4, cl::Local(tiles_size));
+
+        std::vector<cl_uint> words = pack_cells(initial);
+        packed_front =
+            cl::Buffer{ opencl_context, words.begin(), words.end(), false };
+        packed_back = cl::Buffer{ opencl_context, CL_MEM_READ_WRITE,
+                                  words.size() * sizeof(cl_uint) };
+    }
+
+    if (headless())
+    {
+        const cl::ImageFormat format{ CL_R, CL_UNSIGNED_INT8 };
+        cl_images[0] = cl::Image2D{ opencl_context,
+                                    CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+                                    format,
+                                    getSize().x,
+                                    getSize().y,
+                                    0,
+                                    initial.data() };
+        for (std::size_t i = 1; i < cl_images.size(); ++i)
+            cl_images[i] = cl::Image2D{ opencl_context, CL_MEM_READ_WRITE,
+                                        format, getSize().x, getSize().y };
+
+        if (kernel_name != "image")
+            check_packed(std::max<std::size_t>(16, 2 * generations + 1));
+        return;
+    }
+
     // Translate OpenGL object handles into OpenCL handles
-    cl_images.front = cl::ImageGL{ opencl_context, CL_MEM_READ_WRITE,
-                                   GL_TEXTURE_2D, 0, gl_images.front };
-    cl_images.back = cl::ImageGL{ opencl_context, CL_MEM_READ_WRITE,
-                                  GL_TEXTURE_2D, 0, gl_images.back };
+    for (std::size_t i = 0; i < cl_images.size(); ++i)
+        cl_images[i] = cl::ImageGL{ opencl_context, CL_MEM_READ_WRITE,
+                                    GL_TEXTURE_2D, 0, gl_images[i] };
 
     // Translate
     interop_resources =
-        cl::vector<cl::Memory>{ cl_images.front, cl_images.back };
+        cl::vector<cl::Memory>(cl_images.begin(), cl_images.end());
 }
 
 void Conway::updateScene()
 {
     if (animating)
     {
-        auto conway =
-            cl::KernelFunctor<cl::ImageGL, cl::ImageGL, cl_float2>{ cl_program,
-                                                                    "conway" };
-        cl::Event acquire, release;
-
-        queue.enqueueAcquireGLObjects(&interop_resources, nullptr, &acquire);
-
-        conway(
-            cl::EnqueueArgs{ queue, cl::NDRange{ getSize().x, getSize().y } },
-            cl_images.front, cl_images.back,
-            cl_float2{ { 1.f / getSize().x, 1.f / getSize().y } });
+        // The steps may only start once the frame being drawn is done with
+        // the cells.
+        if (!headless())
+        {
+            const cl::vector<cl::Event> rendered = gl_fence();
+            queue.enqueueAcquireGLObjects(&interop_resources, &rendered);
+        }
 
-        queue.enqueueReleaseGLObjects(&interop_resources, nullptr, &release);
+        if (kernel_name != "image")
+        {
+            simulated =
+                packed_steps(packed_front, packed_back, steps_per_frame());
+            if (!headless())
+            {
+                latest = (latest + 1) % 3;
+                unpack_kernel.setArg(0, packed_front);
+                unpack_kernel.setArg(2, cl_images[latest]);
+                queue.enqueueNDRangeKernel(
+                    unpack_kernel, cl::NullRange,
+                    cl::NDRange{ getSize().x, getSize().y }, cl::NullRange,
+                    nullptr, &simulated);
+            }
+        }
+        else
+        {
+            auto conway = cl::KernelFunctor<cl::Image, cl::Image, cl_float2>{
+                cl_program, "conway"
+            };
+            std::size_t front = latest, back = (latest + 1) % 3;
+            for (std::size_t i = 0; i < steps_per_frame(); ++i)
+            {
+                simulated = conway(
+                    cl::EnqueueArgs{ queue,
+                                     cl::NDRange{ getSize().x, getSize().y } },
+                    cl_images[front], cl_images[back],
+                    cl_float2{ { 1.f / getSize().x, 1.f / getSize().y } });
+                front = back;
+                back = 3 - latest - front; // the other copy not rendered
+            }
+            latest = front;
+        }
 
-        // Wait for all OpenCL commands to finish
-        if (!cl_khr_gl_event_supported)
-            cl::finish();
+        // Rendering waits for the steps instead, unless headless.
+        if (!headless())
+            queue.enqueueReleaseGLObjects(&interop_resources, nullptr,
+                                          &simulated);
         else
-            release.wait();
+            simulated.wait();
+    }
+}
+
+cl::Event Conway::packed_step(cl::Kernel& step_kernel,
+                              const cl::Buffer& front, const cl::Buffer& back)
+{
+    step_kernel.setArg(0, front);
+    step_kernel.setArg(1, back);
+    cl::Event event;
+    queue.enqueueNDRangeKernel(step_kernel, cl::NullRange, packed_global,
+                               packed_local, nullptr, &event);
+    return event;
+}
 
-        // Swap front and back buffer handles
-        std::swap(cl_images.front, cl_images.back);
-        std::swap(gl_images.front, gl_images.back);
+// Advances count generations, swapping the buffers after every launch so that
+// front holds the result. The blocked kernel runs as many launches of
+// generations as fit, single steps make up the rest.
+cl::Event Conway::packed_steps(cl::Buffer& front, cl::Buffer& back,
+                               std::size_t count)
+{
+    const std::size_t blocked =
+        kernel_name == "blocked" ? count / generations : 0;
+    cl::Event event;
+    for (std::size_t i = 0; i < blocked; ++i)
+    {
+        event = packed_step(blocked_kernel, front, back);
+        std::swap(front, back);
     }
+    for (std::size_t i = blocked * generations; i < count; ++i)
+    {
+        event = packed_step(packed_kernel, front, back);
+        std::swap(front, back);
+    }
+    return event;
+}
+
+// Runs count generations from the initial cells with the image kernel and
+// the selected packed kernel, and throws if they compute different cells.
+void Conway::check_packed(std::size_t count)
+{
+    const cl::size_type width = getSize().x, height = getSize().y;
+    const cl::ImageFormat format{ CL_R, CL_UNSIGNED_INT8 };
+    std::array<cl::Image, 2> images{
+        cl::Image2D{ opencl_context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+                     format, width, height, 0, initial.data() },
+        cl::Image2D{ opencl_context, CL_MEM_READ_WRITE, format, width, height }
+    };
+    std::vector<cl_uint> words = pack_cells(initial);
+    std::array<cl::Buffer, 2> buffers{
+        cl::Buffer{ opencl_context, words.begin(), words.end(), false },
+        cl::Buffer{ opencl_context, CL_MEM_READ_WRITE,
+                    words.size() * sizeof(cl_uint) }
+    };
+
+    auto conway = cl::KernelFunctor<cl::Image, cl::Image, cl_float2>{
+        cl_program, "conway"
+    };
+    for (std::size_t i = 0; i < count; ++i)
+        conway(cl::EnqueueArgs{ queue, cl::NDRange{ width, height } },
+               images[i % 2], images[(i + 1) % 2],
+               cl_float2{ { 1.f / width, 1.f / height } });
+    packed_steps(buffers[0], buffers[1], count);
+
+    std::vector<cl_uchar> expected(width * height);
+    queue.enqueueReadImage(images[count % 2], CL_FALSE, { 0, 0, 0 },
+                           { width, height, 1 }, 0, 0, expected.data());
+    queue.enqueueReadBuffer(buffers[0], CL_TRUE, 0,
+                            words.size() * sizeof(cl_uint), words.data());
+    if (unpack_cells(words, expected.size()) != expected)
+        throw std::runtime_error{ "The " + kernel_name
+                                  + " kernel deviates from the image "
+                                    "kernel." };
 }
 
 void Conway::render()
 {
+    // Without cl_khr_gl_event, OpenGL commands do not wait for the release
+    // of shared objects.
+    if (!cl_khr_gl_event_supported && simulated() != nullptr) wait(simulated);
+
     glClear(GL_COLOR_BUFFER_BIT);
 
     glUseProgram(gl_program);
     glBindVertexArray(vertex_array);
-    glBindTexture(GL_TEXTURE_2D, gl_images.front);
+    glBindTexture(GL_TEXTURE_2D, gl_images[latest]);
 
     glDrawArrays(GL_TRIANGLE_STRIP, 0, static_cast<GLsizei>(4));
 
@@ -332,11 +593,8 @@ void Conway::render()
     glBindVertexArray(0);
     glUseProgram(0);
 
-    // Wait for all drawing commands to finish
-    if (!cl_khr_gl_event_supported)
-        glFinish();
-    else
-        glFlush();
+    // Steps wait for the drawing commands through gl_fence()
+    glFlush();
 }
 
 void Conway::event(const sf::Event& event)
@@ -361,15 +619,41 @@ int main(int argc, char* argv[])
         // Parse command-line options
         auto opts = cl::sdk::parse_cli<cl::sdk::options::Diagnostic,
                                        cl::sdk::options::SingleDevice,
-                                       cl::sdk::options::Window>(argc, argv);
+                                       cl::sdk::options::Window,
+                                       cl::sdk::options::Headless,
+                                       ConwayOptions>(argc, argv);
+        const auto& diag_opts = std::get<0>(opts);
         const auto& dev_opts = std::get<1>(opts).triplet;
         const auto& win_opts = std::get<2>(opts);
+        const auto& headless_opts = std::get<3>(opts);
+        const auto& conway_opts = std::get<4>(opts);
 
         Conway window{ win_opts.width,      win_opts.height,
                        win_opts.fullscreen, dev_opts.plat_index,
-                       dev_opts.dev_index,  dev_opts.dev_type };
+                       dev_opts.dev_index,  dev_opts.dev_type,
+                       conway_opts.kernel,  conway_opts.generations,
+                       headless_opts };
+        // A frame of the blocked kernel runs at least one blocked launch,
+        // fewer steps would only launch the packed kernel.
+        window.set_steps_per_frame(
+            conway_opts.kernel == "blocked"
+                ? std::max(win_opts.steps_per_frame, conway_opts.generations)
+                : win_opts.steps_per_frame);
 
         window.run();
+
+        if (headless_opts.enabled && !diag_opts.quiet)
+        {
+            const double steps_per_second =
+                window.headless_steps() / window.headless_seconds();
+            std::cout << window.headless_steps() << " steps of "
+                      << win_opts.width << "x" << win_opts.height
+                      << " cells with the " << conway_opts.kernel
+                      << " kernel in " << window.headless_seconds()
+                      << " s: " << steps_per_second << " steps/s, "
+                      << steps_per_second * win_opts.width * win_opts.height
+                      << " cells/s" << std::endl;
+        }
     } catch (cl::util::Error& e)
     {
         std::cerr << "OpenCL Utils error: " << e.what() << std::endl;
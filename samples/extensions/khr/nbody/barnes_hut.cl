@@ -0,0 +1,278 @@
+// Must match nbody.cl
+#define G 1.0f
+#define epsilon_sq 1.f
+
+// Depth of the tree walk. Trees are rarely deeper than the 30 bits of the
+// Morton codes plus the bits telling duplicate codes apart.
+#define STACK_SIZE 64
+
+// Reduces the bounding box of mins and maxs, which are the same buffer of
+// particles at first, then the partial results of the work-groups.
+kernel void bounds(global const float4* mins,
+                   global const float4* maxs,
+                   uint count,
+                   global float4* out_min,
+                   global float4* out_max,
+                   local float4* local_min,
+                   local float4* local_max)
+{
+    size_t lid = get_local_id(0);
+    float4 lo = (float4)(INFINITY), hi = (float4)(-INFINITY);
+    for (size_t i = get_global_id(0); i < count; i += get_global_size(0))
+    {
+        lo = fmin(lo, mins[i]);
+        hi = fmax(hi, maxs[i]);
+    }
+    local_min[lid] = lo;
+    local_max[lid] = hi;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // The work-group size is a power of two
+    for (size_t s = get_local_size(0) / 2; s > 0; s /= 2)
+    {
+        if (lid < s)
+        {
+            local_min[lid] = fmin(local_min[lid], local_min[lid + s]);
+            local_max[lid] = fmax(local_max[lid], local_max[lid + s]);
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    if (lid == 0)
+    {
+        out_min[get_group_id(0)] = local_min[0];
+        out_max[get_group_id(0)] = local_max[0];
+    }
+}
+
+// Spreads the lower 10 bits of v to every third bit.
+uint expand_bits(uint v)
+{
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+// Computes the 30-bit Morton code of every particle within the bounding cube.
+// Keys past the last particle are padded with the largest key, so that they
+// are sorted to the end.
+kernel void morton(global const float4* pos_mass,
+                   global const float4* bounds_min,
+                   global const float4* bounds_max,
+                   uint particle_count,
+                   global uint* keys,
+                   global uint* values)
+{
+    uint i = get_global_id(0);
+    values[i] = i;
+    if (i >= particle_count)
+    {
+        keys[i] = 0xFFFFFFFFu;
+        return;
+    }
+
+    float3 lo = bounds_min[0].xyz;
+    float3 extent = bounds_max[0].xyz - lo;
+    float size = fmax(fmax(extent.x, extent.y), fmax(extent.z, FLT_MIN));
+    float3 cell = clamp((pos_mass[i].xyz - lo) / size * 1024.f, 0.f, 1023.f);
+    keys[i] = expand_bits((uint)cell.x) << 2 | expand_bits((uint)cell.y) << 1
+        | expand_bits((uint)cell.z);
+}
+
+// One compare-exchange pass of a bitonic sort of keys and values. Equal keys
+// are ordered by value, so that every key-value pair is unique.
+kernel void bitonic_step(global uint* keys,
+                         global uint* values,
+                         uint j,
+                         uint k)
+{
+    uint i = get_global_id(0);
+    uint partner = i ^ j;
+    if (partner <= i) return;
+
+    uint key_i = keys[i], key_p = keys[partner];
+    uint value_i = values[i], value_p = values[partner];
+    bool greater = key_i > key_p || (key_i == key_p && value_i > value_p);
+    bool ascending = (i & k) == 0;
+    if (greater == ascending)
+    {
+        keys[i] = key_p;
+        keys[partner] = key_i;
+        values[i] = value_p;
+        values[partner] = value_i;
+    }
+}
+
+// Length of the common prefix of the keys of sorted particles i and j. Equal
+// keys are told apart by the index. -1 if j is out of range.
+int delta(global const uint* keys, int count, int i, int j)
+{
+    if (j < 0 || j >= count) return -1;
+    uint a = keys[i], b = keys[j];
+    return a != b ? (int)clz(a ^ b) : 32 + (int)clz((uint)(i ^ j));
+}
+
+// Builds the binary radix tree of the sorted keys in parallel, as described by
+// Karras, "Maximizing Parallelism in the Construction of BVHs, Octrees, and
+// k-d Trees" (HPG 2012). Internal node i of the n - 1 internal nodes covers
+// a range of sorted particles that starts or ends at i. Node 0 is the root.
+// Leaves are numbered after the internal nodes, leaf i is node n - 1 + i.
+kernel void build_tree(global const uint* keys,
+                       uint particle_count,
+                       global int* left,
+                       global int* right,
+                       global int* parent)
+{
+    int n = particle_count;
+    int i = get_global_id(0);
+    if (i >= n - 1) return;
+
+    // Direction of the range and upper bound of its length
+    int d = delta(keys, n, i, i + 1) > delta(keys, n, i, i - 1) ? 1 : -1;
+    int delta_min = delta(keys, n, i, i - d);
+    int l_max = 2;
+    while (delta(keys, n, i, i + l_max * d) > delta_min) l_max *= 2;
+
+    // Other end of the range by binary search
+    int l = 0;
+    for (int t = l_max / 2; t >= 1; t /= 2)
+        if (delta(keys, n, i, i + (l + t) * d) > delta_min) l += t;
+    int j = i + l * d;
+
+    // Split position by binary search
+    int delta_node = delta(keys, n, i, j);
+    int s = 0;
+    int t = l;
+    do
+    {
+        t = (t + 1) / 2;
+        if (delta(keys, n, i, i + (s + t) * d) > delta_node) s += t;
+    } while (t > 1);
+    int gamma = i + s * d + min(d, 0);
+
+    int left_child = min(i, j) == gamma ? n - 1 + gamma : gamma;
+    int right_child = max(i, j) == gamma + 1 ? n - 1 + gamma + 1 : gamma + 1;
+    left[i] = left_child;
+    right[i] = right_child;
+    parent[left_child] = i;
+    parent[right_child] = i;
+    if (i == 0) parent[0] = -1;
+}
+
+// Computes the center of mass, total mass and bounding box of every node
+// bottom-up. Every leaf climbs towards the root. Of the two children of a
+// node, the one arriving first stops, the second one summarizes the node.
+// flags must be zero.
+kernel void summarize(global const float4* pos_mass,
+                      global const uint* values,
+                      uint particle_count,
+                      global const int* left,
+                      global const int* right,
+                      global const int* parent,
+                      volatile global uint* flags,
+                      volatile global float4* com,
+                      volatile global float4* box_min,
+                      volatile global float4* box_max)
+{
+    int n = particle_count;
+    int i = get_global_id(0);
+    if (i >= n) return;
+
+    int node = n - 1 + i;
+    float4 p = pos_mass[values[i]];
+    com[node] = p;
+    box_min[node] = p;
+    box_max[node] = p;
+
+    for (node = parent[node]; node >= 0; node = parent[node])
+    {
+        // Make the results of this work-item visible before the flag.
+        mem_fence(CLK_GLOBAL_MEM_FENCE);
+        if (atomic_inc(&flags[node]) == 0) return;
+
+        int a = left[node], b = right[node];
+        float4 com_a = com[a], com_b = com[b];
+        float mass = com_a.w + com_b.w;
+        float3 center = mass > 0.f
+            ? (com_a.xyz * com_a.w + com_b.xyz * com_b.w) / mass
+            : 0.5f * (com_a.xyz + com_b.xyz);
+        com[node] = (float4)(center, mass);
+        float4 min_a = box_min[a], min_b = box_min[b];
+        float4 max_a = box_max[a], max_b = box_max[b];
+        box_min[node] = fmin(min_a, min_b);
+        box_max[node] = fmax(max_a, max_b);
+    }
+}
+
+// Force exerted by other on a particle at pos, without G and the mass of the
+// particle, as in nbody.cl.
+float3 interaction(float3 pos, float4 other)
+{
+    float3 d = other.xyz - pos;
+    float inv_q = rsqrt(dot(d, d) + epsilon_sq);
+    return other.w * inv_q * inv_q * inv_q * d;
+}
+
+// Same step as nbody, but forces are summed over the tree. Nodes that appear
+// smaller than theta radians from the particle act as a single body at their
+// center of mass, others are opened. Work-items take particles in sorted
+// order, so that neighbouring work-items walk similar paths.
+kernel void barnes_hut(global const float4* pos_mass_front,
+                       global float4* pos_mass_back,
+                       global float4* velocity,
+                       global const uint* values,
+                       global const int* left,
+                       global const int* right,
+                       global const float4* com,
+                       global const float4* box_min,
+                       global const float4* box_max,
+                       uint particle_count,
+                       float dt,
+                       float theta_sq)
+{
+    int n = particle_count;
+    int i = get_global_id(0);
+    if (i >= n) return;
+
+    uint me = values[i];
+    float4 my_pos_mass = pos_mass_front[me];
+
+    float3 acc = (float3)0.f;
+    int stack[STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        int node = stack[--top];
+        float4 body = com[node];
+        // The particle itself exerts no force, the distance being zero.
+        if (node >= n - 1)
+        {
+            acc += interaction(my_pos_mass.xyz, body);
+            continue;
+        }
+
+        float3 extent = box_max[node].xyz - box_min[node].xyz;
+        float size = fmax(extent.x, fmax(extent.y, extent.z));
+        float3 d = body.xyz - my_pos_mass.xyz;
+        if (size * size < theta_sq * dot(d, d) || top + 2 > STACK_SIZE)
+            acc += interaction(my_pos_mass.xyz, body);
+        else
+        {
+            stack[top++] = left[node];
+            stack[top++] = right[node];
+        }
+    }
+    acc *= G * my_pos_mass.w;
+
+    // updated position and velocity
+    float3 my_pos = my_pos_mass.xyz;
+    float3 my_vel = velocity[me].xyz;
+    my_pos += my_vel * dt + acc * 0.5f * dt * dt;
+    my_vel += acc * dt;
+
+    // write to global memory
+    pos_mass_back[me] = (float4)(my_pos, my_pos_mass.w);
+    velocity[me] = (float4)(my_vel, 0.f);
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2023 The Khronos Group Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "barnes_hut.hpp"
+
+#include <CL/Utils/File.hpp>
+
+// STL includes
+#include <algorithm> // std::min
+#include <stdexcept>
+
+BarnesHut::BarnesHut(const cl::Context& context, const cl::Device& device,
+                     std::size_t particle_count, cl_float theta)
+    : count{ particle_count }, padded{ 1 }, theta_sq{ theta * theta }
+{
+    if (count < 2)
+        throw std::invalid_argument{ "Barnes-Hut needs at least 2 particles." };
+    while (padded < count) padded *= 2;
+
+    cl::Program program{ context,
+                         cl::util::read_exe_relative_text_file(
+                             "barnes_hut.cl") };
+    program.build(device);
+    bounds_partial = cl::Kernel{ program, "bounds" };
+    bounds_final = cl::Kernel{ program, "bounds" };
+    morton = cl::Kernel{ program, "morton" };
+    bitonic_step = cl::Kernel{ program, "bitonic_step" };
+    build_tree = cl::Kernel{ program, "build_tree" };
+    summarize = cl::Kernel{ program, "summarize" };
+    walk = cl::Kernel{ program, "barnes_hut" };
+
+    // The reduction needs a power of two work-group size. A few work-groups
+    // stride over the particles, one more reduces their results.
+    group_size = 256;
+    while (group_size > 1
+           && group_size > bounds_partial.getWorkGroupInfo<
+                   CL_KERNEL_WORK_GROUP_SIZE>(device))
+        group_size /= 2;
+    groups = std::min<std::size_t>(64, (count + group_size - 1) / group_size);
+
+    const std::size_t nodes = 2 * count - 1;
+    auto buffer = [&](std::size_t bytes) {
+        return cl::Buffer{ context, CL_MEM_READ_WRITE, bytes };
+    };
+    partial_min = buffer(groups * sizeof(cl_float4));
+    partial_max = buffer(groups * sizeof(cl_float4));
+    bounds_min = buffer(sizeof(cl_float4));
+    bounds_max = buffer(sizeof(cl_float4));
+    keys = buffer(padded * sizeof(cl_uint));
+    values = buffer(padded * sizeof(cl_uint));
+    left = buffer((count - 1) * sizeof(cl_int));
+    right = buffer((count - 1) * sizeof(cl_int));
+    parent = buffer(nodes * sizeof(cl_int));
+    flags = buffer((count - 1) * sizeof(cl_uint));
+    com = buffer(nodes * sizeof(cl_float4));
+    box_min = buffer(nodes * sizeof(cl_float4));
+    box_max = buffer(nodes * sizeof(cl_float4));
+
+    const cl::LocalSpaceArg local_bounds =
+        cl::Local(group_size * sizeof(cl_float4));
+    bounds_partial.setArg(2, static_cast<cl_uint>(count));
+    bounds_partial.setArg(3, partial_min);
+    bounds_partial.setArg(4, partial_max);
+    bounds_partial.setArg(5, local_bounds);
+    bounds_partial.setArg(6, local_bounds);
+    bounds_final.setArg(0, partial_min);
+    bounds_final.setArg(1, partial_max);
+    bounds_final.setArg(2, static_cast<cl_uint>(groups));
+    bounds_final.setArg(3, bounds_min);
+    bounds_final.setArg(4, bounds_max);
+    bounds_final.setArg(5, local_bounds);
+    bounds_final.setArg(6, local_bounds);
+
+    morton.setArg(1, bounds_min);
+    morton.setArg(2, bounds_max);
+    morton.setArg(3, static_cast<cl_uint>(count));
+    morton.setArg(4, keys);
+    morton.setArg(5, values);
+
+    bitonic_step.setArg(0, keys);
+    bitonic_step.setArg(1, values);
+
+    build_tree.setArg(0, keys);
+    build_tree.setArg(1, static_cast<cl_uint>(count));
+    build_tree.setArg(2, left);
+    build_tree.setArg(3, right);
+    build_tree.setArg(4, parent);
+
+    summarize.setArg(1, values);
+    summarize.setArg(2, static_cast<cl_uint>(count));
+    summarize.setArg(3, left);
+    summarize.setArg(4, right);
+    summarize.setArg(5, parent);
+    summarize.setArg(6, flags);
+    summarize.setArg(7, com);
+    summarize.setArg(8, box_min);
+    summarize.setArg(9, box_max);
+
+    walk.setArg(3, values);
+    walk.setArg(4, left);
+    walk.setArg(5, right);
+    walk.setArg(6, com);
+    walk.setArg(7, box_min);
+    walk.setArg(8, box_max);
+    walk.setArg(9, static_cast<cl_uint>(count));
+    walk.setArg(11, theta_sq);
+}
+
+cl::Event BarnesHut::step(const cl::CommandQueue& queue,
+                          const cl::Buffer& front, const cl::Buffer& back,
+                          const cl::Buffer& velocity, cl_float dt)
+{
+    // Bounding box of the particles
+    bounds_partial.setArg(0, front);
+    bounds_partial.setArg(1, front);
+    queue.enqueueNDRangeKernel(bounds_partial, cl::NullRange,
+                               cl::NDRange{ groups * group_size },
+                               cl::NDRange{ group_size });
+    queue.enqueueNDRangeKernel(bounds_final, cl::NullRange,
+                               cl::NDRange{ group_size },
+                               cl::NDRange{ group_size });
+
+    // Morton codes sorted along with the particle indices
+    morton.setArg(0, front);
+    queue.enqueueNDRangeKernel(morton, cl::NullRange, cl::NDRange{ padded });
+    for (cl_uint k = 2; k <= padded; k *= 2)
+        for (cl_uint j = k / 2; j > 0; j /= 2)
+        {
+            bitonic_step.setArg(2, j);
+            bitonic_step.setArg(3, k);
+            queue.enqueueNDRangeKernel(bitonic_step, cl::NullRange,
+                                       cl::NDRange{ padded });
+        }
+
+    // Tree and its nodes' mass distribution
+    queue.enqueueNDRangeKernel(build_tree, cl::NullRange,
+                               cl::NDRange{ count - 1 });
+    queue.enqueueFillBuffer(flags, cl_uint{ 0 }, 0,
+                            (count - 1) * sizeof(cl_uint));
+    summarize.setArg(0, front);
+    queue.enqueueNDRangeKernel(summarize, cl::NullRange,
+                               cl::NDRange{ count });
+
+    // Forces and integration
+    walk.setArg(0, front);
+    walk.setArg(1, back);
+    walk.setArg(2, velocity);
+    walk.setArg(10, dt);
+    cl::Event event;
+    queue.enqueueNDRangeKernel(walk, cl::NullRange, cl::NDRange{ count },
+                               cl::NullRange, nullptr, &event);
+    return event;
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2023 The Khronos Group Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <CL/opencl.hpp>
+
+// STL includes
+#include <cstddef> // std::size_t
+
+// Advances the simulation by steps of O(N log N) cost. Every step builds a
+// binary radix tree of the particles on the device from their sorted Morton
+// codes, sums the mass of every node bottom-up, and walks the tree to compute
+// forces, approximating distant nodes by their center of mass.
+class BarnesHut {
+public:
+    // theta is the opening angle below which nodes are approximated. It must
+    // be smaller than 1 / sqrt(3), so that nodes containing the particle are
+    // always opened.
+    BarnesHut(const cl::Context& context, const cl::Device& device,
+              std::size_t particle_count, cl_float theta = 0.5f);
+
+    // Reads positions and masses from front, writes them to back and updates
+    // velocity in place, like the direct-sum kernels of nbody.cl.
+    cl::Event step(const cl::CommandQueue& queue, const cl::Buffer& front,
+                   const cl::Buffer& back, const cl::Buffer& velocity,
+                   cl_float dt);
+
+private:
+    std::size_t count, padded; // particles, rounded up to a power of two
+    std::size_t group_size, groups; // of the bounding box reduction
+    cl_float theta_sq;
+
+    cl::Kernel bounds_partial, bounds_final, morton, bitonic_step, build_tree,
+        summarize, walk;
+
+    cl::Buffer partial_min, partial_max, bounds_min, bounds_max;
+    cl::Buffer keys, values; // sorted Morton codes and particle indices
+    cl::Buffer left, right, parent, flags;
+    cl::Buffer com, box_min, box_max; // of every node
+};
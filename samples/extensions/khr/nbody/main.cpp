@@ -19,14 +19,24 @@
 // OpenCL SDK includes
 #include <CL/Utils/Utils.hpp>
 #include <CL/SDK/SDK.hpp>
+#include <CL/SDK/Context.hpp>
+
+// Sample includes
+#include "barnes_hut.hpp"
 
 // STL includes
+#include <array>
+#include <cmath>
+#include <functional>
 #include <iostream>
+#include <memory> // std::make_shared
+#include <string>
 #include <valarray>
 #include <random>
 #include <algorithm>
 #include <fstream>
 #include <tuple> // std::make_tuple
+#include <utility> // std::pair
 
 // TCLAP includes
 #include <tclap/CmdLine.h>
@@ -46,25 +56,169 @@ template <typename T> struct DoubleBuffer
     void swap() { std::swap(front, back); }
 };
 
+struct NBodyOptions
+{
+    std::string kernel;
+    std::size_t particles;
+};
+
+std::unique_ptr<TCLAP::ValuesConstraint<std::string>> valid_kernel_constraint;
+
+template <> auto cl::sdk::parse<NBodyOptions>()
+{
+    std::vector<std::string> valid_kernel_strings{ "naive", "tiled",
+                                                   "barnes-hut" };
+    valid_kernel_constraint =
+        std::make_unique<TCLAP::ValuesConstraint<std::string>>(
+            valid_kernel_strings);
+
+    return std::make_tuple(
+        std::make_shared<TCLAP::ValueArg<std::string>>(
+            "k", "kernel",
+            "Force kernel: naive reads particles from global memory, tiled "
+            "stages them in local memory, barnes-hut approximates distant "
+            "particles with a tree",
+            false, "tiled", valid_kernel_constraint.get()),
+        std::make_shared<TCLAP::ValueArg<std::size_t>>(
+            "n", "particles", "Number of particles", false, 8192,
+            "positive integral"));
+}
+
+template <>
+NBodyOptions cl::sdk::comprehend<NBodyOptions>(
+    std::shared_ptr<TCLAP::ValueArg<std::string>> kernel_arg,
+    std::shared_ptr<TCLAP::ValueArg<std::size_t>> particles_arg)
+{
+    return NBodyOptions{ kernel_arg->getValue(), particles_arg->getValue() };
+}
+
+// Extent of the initial particle cloud and range of particle masses
+constexpr float x_range = 192.f, y_range = 128.f, z_range = 32.f,
+                min_mass = 100.f, max_mass = 500.f;
+constexpr cl_float time_step = 0.0001f;
+
+std::vector<cl_float4> generate_particles(std::size_t count)
+{
+    using uni = std::uniform_real_distribution<float>;
+    std::vector<cl_float4> result;
+    result.reserve(count);
+    std::generate_n(std::back_inserter(result), count,
+                    [prng = std::default_random_engine(),
+                     x_dist = uni(-x_range, x_range),
+                     y_dist = uni(-y_range, y_range),
+                     z_dist = uni(-z_range, z_range),
+                     m_dist = uni(min_mass, max_mass)]() mutable {
+                        return cl_float4{ { x_dist(prng), y_dist(prng),
+                                            z_dist(prng), m_dist(prng) } };
+                    });
+    return result;
+}
+
+struct StepKernel
+{
+    cl::Kernel kernel;
+    cl::NDRange global, local;
+};
+
+// Builds the kernel advancing the simulation by a step. The tiled kernel
+// works on tiles as large as a work-group, the largest power of two up to 256
+// work-items the device runs it with.
+StepKernel build_step_kernel(const cl::Context& context,
+                             const cl::Device& device,
+                             const std::string& kernel_name,
+                             std::size_t particle_count)
+{
+    const std::string source =
+        cl::util::read_exe_relative_text_file("nbody.cl");
+    if (kernel_name == "naive")
+    {
+        cl::Program program{ context, source };
+        program.build(device);
+        return StepKernel{ cl::Kernel{ program, "nbody" },
+                           cl::NDRange{ particle_count }, cl::NullRange };
+    }
+
+    std::size_t tile = 256;
+    while (tile > device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>()) tile /= 2;
+    for (; tile >= 4; tile /= 2)
+    {
+        cl::Program program{ context, source };
+        program.build(device, ("-DTILE_SIZE=" + std::to_string(tile)).c_str());
+        cl::Kernel kernel{ program, "nbody_tiled" };
+        if (kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device) >= tile)
+        {
+            // Work-items past the last particle only help loading tiles.
+            const std::size_t groups = (particle_count + tile - 1) / tile;
+            return StepKernel{ kernel, cl::NDRange{ groups * tile },
+                               cl::NDRange{ tile } };
+        }
+    }
+    throw std::runtime_error{ "The device cannot run the tiled kernel." };
+}
+
+// Enqueues a step reading positions and masses from front, writing them to
+// back and updating velocity in place.
+using Step = std::function<cl::Event(
+    const cl::CommandQueue& queue, const cl::Buffer& front,
+    const cl::Buffer& back, const cl::Buffer& velocity)>;
+
+Step make_step(const cl::Context& context, const cl::Device& device,
+               const std::string& kernel_name, std::size_t particle_count)
+{
+    if (kernel_name == "barnes-hut")
+    {
+        auto barnes_hut =
+            std::make_shared<BarnesHut>(context, device, particle_count);
+        return [barnes_hut](const cl::CommandQueue& queue,
+                            const cl::Buffer& front, const cl::Buffer& back,
+                            const cl::Buffer& velocity) {
+            return barnes_hut->step(queue, front, back, velocity, time_step);
+        };
+    }
+
+    StepKernel step =
+        build_step_kernel(context, device, kernel_name, particle_count);
+    return [step, particle_count](
+               const cl::CommandQueue& queue, const cl::Buffer& front,
+               const cl::Buffer& back, const cl::Buffer& velocity) mutable {
+        step.kernel.setArg(0, front);
+        step.kernel.setArg(1, back);
+        step.kernel.setArg(2, velocity);
+        step.kernel.setArg(3, static_cast<cl_uint>(particle_count));
+        step.kernel.setArg(4, time_step);
+        cl::Event event;
+        queue.enqueueNDRangeKernel(step.kernel, cl::NullRange, step.global,
+                                   step.local, nullptr, &event);
+        return event;
+    };
+}
+
 class NBody : public cl::sdk::InteropWindow {
 public:
     explicit NBody(unsigned int platform_id = 0, unsigned int device_id = 0,
-                   cl_bitfield device_type = CL_DEVICE_TYPE_DEFAULT)
-        : InteropWindow{ sf::VideoMode(800, 800),
+                   cl_bitfield device_type = CL_DEVICE_TYPE_DEFAULT,
+                   std::size_t particle_count = 8192,
+                   std::string kernel_name = "tiled", int width = 800,
+                   int height = 800, bool fullscreen = false,
+                   const cl::sdk::options::Headless& headless =
+                       cl::sdk::options::Headless{ false, 0, 0 })
+        : InteropWindow{ sf::VideoMode(width, height),
                          "Gravitational NBody",
-                         sf::Style::Default,
+                         fullscreen ? sf::Style::Fullscreen
+                                    : sf::Style::Default,
                          sf::ContextSettings{
                              32, 0, 0, // Depth, Stencil, AA
                              3, 3, // OpenGL version
                              sf::ContextSettings::Attribute::Core },
                          platform_id,
                          device_id,
-                         device_type },
-          particle_count(8192), x_abs_range(192.f), y_abs_range(128.f),
-          z_abs_range(32.f), mass_min(100.f), mass_max(500.f),
-          RMB_pressed(false),
+                         device_type,
+                         headless },
+          particle_count(particle_count), x_abs_range(x_range),
+          y_abs_range(y_range), z_abs_range(z_range),
+          kernel_name(std::move(kernel_name)), RMB_pressed(false),
           dist(std::max({ x_abs_range, y_abs_range, z_abs_range }) * 3), phi(0),
-          theta(0), needMatrixReset(true), animating(true)
+          theta(0), needMatrixReset(true), animating(true), latest(0)
     {}
 
 protected:
@@ -84,7 +238,8 @@ protected:
 private:
     // Simulation related variables
     std::size_t particle_count;
-    float x_abs_range, y_abs_range, z_abs_range, mass_min, mass_max;
+    float x_abs_range, y_abs_range, z_abs_range;
+    std::string kernel_name;
 
     // Host-side containers
     std::vector<cl_float4> pos_mass;
@@ -94,28 +249,29 @@ private:
     // OpenCL objects
     cl::Device device;
     cl::CommandQueue queue;
-    cl::Program cl_program;
-    cl::Kernel kernel;
-    cl::Sampler sampler;
+    Step step;
 
     cl::Buffer velocity_buffer;
-    DoubleBuffer<cl::BufferGL> cl_pos_mass;
+    // Three copies of the particles, shared with OpenGL unless headless. The
+    // copy rendered holds the result of the last steps. The steps in flight
+    // read it and write the other two in turns, so they never write the copy
+    // being drawn.
+    std::array<cl::Buffer, 3> cl_pos_mass;
+    cl::Event simulated; // completion of the last steps
 
     cl::vector<cl::Memory> interop_resources;
-    cl::vector<cl::Event> acquire_wait_list, release_wait_list;
-    cl::NDRange gws, lws; // Global/local work-sizes
-    cl::Kernel step_kernel; // Kernel
 
     // OpenGL objects
     cl_GLuint vertex_shader, fragment_shader, gl_program;
-    DoubleBuffer<cl_GLuint> vertex_array;
-    DoubleBuffer<cl_GLuint> gl_pos_mass;
+    std::array<cl_GLuint, 3> vertex_array;
+    std::array<cl_GLuint, 3> gl_pos_mass;
 
     bool RMB_pressed; // Variables to enable dragging
     sf::Vector2<int> mousePos; // Variables to enable dragging
     float dist, phi, theta; // Mouse polar coordinates
     bool needMatrixReset; // Whether matrices need to be reset in shaders
     bool animating;
+    std::size_t latest; // copy of the particles to render
 
     void
     mouseDrag(const sf::Event::MouseMoveEvent& event); // Handle mouse dragging
@@ -218,22 +374,13 @@ void NBody::initializeGL()
     fragment_shader = create_shader("nbody.frag.glsl", GL_FRAGMENT_SHADER);
     gl_program = create_program({ vertex_shader, fragment_shader });
 
-    using uni = std::uniform_real_distribution<float>;
-    std::generate_n(std::back_inserter(pos_mass), particle_count,
-                    [prng = std::default_random_engine(),
-                     x_dist = uni(-x_abs_range, x_abs_range),
-                     y_dist = uni(-y_abs_range, y_abs_range),
-                     z_dist = uni(-z_abs_range, z_abs_range),
-                     m_dist = uni(mass_min, mass_max)]() mutable {
-                        return cl_float4{ { x_dist(prng), y_dist(prng),
-                                            z_dist(prng), m_dist(prng) } };
-                    });
+    pos_mass = generate_particles(particle_count);
 
     glUseProgram(gl_program);
     checkError("glUseProgram(gl_program)");
-    for (auto vbo_vao :
-         { std::make_pair(&gl_pos_mass.front, &vertex_array.front),
-           std::make_pair(&gl_pos_mass.back, &vertex_array.back) })
+    for (auto vbo_vao : { std::make_pair(&gl_pos_mass[0], &vertex_array[0]),
+                          std::make_pair(&gl_pos_mass[1], &vertex_array[1]),
+                          std::make_pair(&gl_pos_mass[2], &vertex_array[2]) })
     {
         glGenBuffers(1, vbo_vao.first);
         checkError("glGenBuffers(1, &vertex_buffer)");
@@ -286,14 +433,7 @@ void NBody::initializeCL()
     queue = cl::CommandQueue{ opencl_context, device };
 
     // Compile kernel
-    cl_program =
-        cl::Program{ opencl_context,
-                     cl::util::read_exe_relative_text_file("nbody.cl") };
-    cl_program.build(device);
-    kernel = cl::Kernel{ cl_program, "nbody" };
-
-    gws = cl::NDRange{ particle_count };
-    lws = cl::NullRange;
+    step = make_step(opencl_context, device, kernel_name, particle_count);
 
     // velocity = std::vector<cl_float4>(particle_count, cl_float4{ 0, 0, 0, 0
     // });
@@ -303,57 +443,74 @@ void NBody::initializeCL()
                             particle_count * sizeof(cl_float4));
     queue.finish();
 
+    if (headless())
+    {
+        pos_mass = generate_particles(particle_count);
+        cl_pos_mass[0] = cl::Buffer{ opencl_context, pos_mass.begin(),
+                                     pos_mass.end(), false };
+        for (std::size_t i = 1; i < cl_pos_mass.size(); ++i)
+            cl_pos_mass[i] =
+                cl::Buffer{ opencl_context, CL_MEM_READ_WRITE,
+                            particle_count * sizeof(cl_float4) };
+        return;
+    }
+
     // Translate OpenGL object handles into OpenCL handles
-    cl_pos_mass.front =
-        cl::BufferGL{ opencl_context, CL_MEM_READ_WRITE, gl_pos_mass.front };
-    cl_pos_mass.back =
-        cl::BufferGL{ opencl_context, CL_MEM_READ_WRITE, gl_pos_mass.back };
+    for (std::size_t i = 0; i < cl_pos_mass.size(); ++i)
+        cl_pos_mass[i] =
+            cl::BufferGL{ opencl_context, CL_MEM_READ_WRITE, gl_pos_mass[i] };
 
     // Translate
     interop_resources =
-        cl::vector<cl::Memory>{ cl_pos_mass.front, cl_pos_mass.back };
+        cl::vector<cl::Memory>(cl_pos_mass.begin(), cl_pos_mass.end());
 }
 
 void NBody::updateScene()
 {
     if (animating)
     {
-        auto nbody =
-            cl::KernelFunctor<cl::BufferGL, cl::BufferGL, cl::Buffer, cl_uint,
-                              cl_float>{ cl_program, "nbody" };
-        cl::Event acquire, release;
-
-        queue.enqueueAcquireGLObjects(&interop_resources, nullptr, &acquire);
-
-        nbody(cl::EnqueueArgs{ queue, cl::NDRange{ particle_count } },
-              cl_pos_mass.front, cl_pos_mass.back, velocity_buffer,
-              static_cast<cl_uint>(particle_count), 0.0001f);
+        // The steps may only start once the frame being drawn is done with
+        // the particles.
+        if (!headless())
+        {
+            const cl::vector<cl::Event> rendered = gl_fence();
+            queue.enqueueAcquireGLObjects(&interop_resources, &rendered);
+        }
 
-        queue.enqueueReleaseGLObjects(&interop_resources, nullptr, &release);
+        std::size_t front = latest, back = (latest + 1) % 3;
+        for (std::size_t i = 0; i < steps_per_frame(); ++i)
+        {
+            simulated = step(queue, cl_pos_mass[front], cl_pos_mass[back],
+                             velocity_buffer);
+            front = back;
+            back = 3 - latest - front; // the other copy not rendered
+        }
+        latest = front;
 
-        // Wait for all OpenCL commands to finish
-        if (!cl_khr_gl_event_supported)
-            cl::finish();
+        // Rendering waits for the steps instead, unless headless.
+        if (!headless())
+            queue.enqueueReleaseGLObjects(&interop_resources, nullptr,
+                                          &simulated);
         else
-            release.wait();
-
-        // Swap front and back buffer handles
-        cl_pos_mass.swap();
-        gl_pos_mass.swap();
+            simulated.wait();
     }
 }
 
 void NBody::render()
 {
+    // Without cl_khr_gl_event, OpenGL commands do not wait for the release
+    // of shared objects.
+    if (!cl_khr_gl_event_supported && simulated() != nullptr) wait(simulated);
+
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     checkError("glClear(GL_COLOR_BUFFER_BIT)");
 
     glUseProgram(gl_program);
     checkError("glUseProgram(gl_program)");
-    glBindVertexArray(vertex_array.front);
+    glBindVertexArray(vertex_array[latest]);
     checkError("glBindVertexArray(vertex_array)");
-    glBindBuffer(GL_ARRAY_BUFFER, gl_pos_mass.front);
-    checkError("glBindBuffer(GL_ARRAY_BUFFER, gl_pos_mass.front)");
+    glBindBuffer(GL_ARRAY_BUFFER, gl_pos_mass[latest]);
+    checkError("glBindBuffer(GL_ARRAY_BUFFER, gl_pos_mass[latest])");
 
     if (needMatrixReset) setMatrices();
 
@@ -366,12 +523,9 @@ void NBody::render()
     glBindVertexArray(0);
     checkError("glBindVertexArray(0)");
 
-    // Wait for all drawing commands to finish
-    if (!cl_khr_gl_event_supported)
-        glFinish();
-    else
-        glFlush();
-    checkError("glFlush()/glFinish()");
+    // Steps wait for the drawing commands through gl_fence()
+    glFlush();
+    checkError("glFlush()");
 }
 
 void NBody::event(const sf::Event& event)
@@ -462,6 +616,150 @@ void NBody::setMatrices()
     needMatrixReset = false;
 }
 
+// Total energy of the particles. The step kernels apply forces as
+// accelerations, so the conserved quantity is the kinetic energy of unit
+// masses plus the softened potential energy. O(N^2) on the host.
+double total_energy(const std::vector<cl_float4>& pos_mass,
+                    const std::vector<cl_float4>& velocity)
+{
+    // Must match nbody.cl
+    const double gravity = 1.0, epsilon_sq = 1.0;
+
+    double kinetic = 0, potential = 0;
+    for (std::size_t i = 0; i < pos_mass.size(); ++i)
+    {
+        const cl_float4& v = velocity[i];
+        kinetic += 0.5
+            * (static_cast<double>(v.s[0]) * v.s[0]
+               + static_cast<double>(v.s[1]) * v.s[1]
+               + static_cast<double>(v.s[2]) * v.s[2]);
+        for (std::size_t j = i + 1; j < pos_mass.size(); ++j)
+        {
+            const double dx = pos_mass[i].s[0] - pos_mass[j].s[0],
+                         dy = pos_mass[i].s[1] - pos_mass[j].s[1],
+                         dz = pos_mass[i].s[2] - pos_mass[j].s[2];
+            potential -= gravity * pos_mass[i].s[3] * pos_mass[j].s[3]
+                / std::sqrt(dx * dx + dy * dy + dz * dz + epsilon_sq);
+        }
+    }
+    return kinetic + potential;
+}
+
+// Checks the selected kernel before a headless run: the first step of the
+// tiled kernel against the naive kernel, the energy drift of Barnes-Hut over
+// drift_steps steps against that of the tiled direct sum.
+void check_kernel(const cl::sdk::options::DeviceTriplet& triplet,
+                  const NBodyOptions& opts, bool quiet)
+{
+    constexpr std::size_t drift_steps = 100;
+
+    cl::Context context = cl::sdk::get_context(triplet);
+    cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>().at(0);
+    cl::CommandQueue queue{ context, device };
+    if (!quiet) cl::util::print_device_info(device);
+
+    const std::size_t count = opts.particles;
+    const std::vector<cl_float4> initial = generate_particles(count);
+    const cl::size_type bytes = count * sizeof(cl_float4);
+
+    // Runs steps from the initial state. Returns the positions and masses,
+    // and the velocities.
+    using State = std::pair<std::vector<cl_float4>, std::vector<cl_float4>>;
+    auto simulate = [&](Step& step, std::size_t steps) {
+        DoubleBuffer<cl::Buffer> positions{
+            cl::Buffer{ context, CL_MEM_READ_WRITE, bytes },
+            cl::Buffer{ context, CL_MEM_READ_WRITE, bytes }
+        };
+        cl::Buffer velocity{ context, CL_MEM_READ_WRITE, bytes };
+        queue.enqueueWriteBuffer(positions.front, CL_FALSE, 0, bytes,
+                                 initial.data());
+        queue.enqueueFillBuffer(velocity, cl_float4{ { 0, 0, 0, 0 } }, 0,
+                                bytes);
+
+        for (std::size_t i = 0; i < steps; ++i)
+        {
+            step(queue, positions.front, positions.back, velocity);
+            positions.swap();
+        }
+
+        State result{ std::vector<cl_float4>(count),
+                      std::vector<cl_float4>(count) };
+        queue.enqueueReadBuffer(positions.front, CL_FALSE, 0, bytes,
+                                result.first.data());
+        queue.enqueueReadBuffer(velocity, CL_TRUE, 0, bytes,
+                                result.second.data());
+        return result;
+    };
+
+    Step step = make_step(context, device, opts.kernel, count);
+
+    if (opts.kernel == "tiled")
+    {
+        const State tiled = simulate(step, 1);
+        Step naive = make_step(context, device, "naive", count);
+        const State reference = simulate(naive, 1);
+
+        // Sums are accumulated in a different order, the deviation relative
+        // to the largest velocity should stay at rounding error.
+        auto length = [](const cl_float4& v) {
+            return std::sqrt(static_cast<double>(v.s[0]) * v.s[0]
+                             + static_cast<double>(v.s[1]) * v.s[1]
+                             + static_cast<double>(v.s[2]) * v.s[2]);
+        };
+        double deviation = 0, largest = 0;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const cl_float4& v = tiled.second[i];
+            const cl_float4& r = reference.second[i];
+            const cl_float4 diff{
+                { v.s[0] - r.s[0], v.s[1] - r.s[1], v.s[2] - r.s[2], 0.f }
+            };
+            deviation = std::max(deviation, length(diff));
+            largest = std::max(largest, length(r));
+        }
+        const double relative = largest > 0 ? deviation / largest : 0;
+        if (!quiet)
+            std::cout << "Deviation from the naive kernel: " << relative
+                      << std::endl;
+        if (relative > 1e-3)
+            throw std::runtime_error{
+                "The tiled kernel deviates from the naive kernel."
+            };
+    }
+    else if (opts.kernel == "barnes-hut" && count > 65536)
+    {
+        if (!quiet)
+            std::cout << "Skipping the energy check, which is O(N^2) on the "
+                         "host, for more than 65536 particles."
+                      << std::endl;
+    }
+    else if (opts.kernel == "barnes-hut")
+    {
+        // The approximation error of the tree shows as energy drift beyond
+        // that of the integrator, which the direct sum also has.
+        const double initial_energy = total_energy(
+            initial, std::vector<cl_float4>(count, cl_float4{}));
+        const State tree = simulate(step, drift_steps);
+        Step direct = make_step(context, device, "tiled", count);
+        const State reference = simulate(direct, drift_steps);
+
+        const double tree_drift =
+            (total_energy(tree.first, tree.second) - initial_energy)
+            / std::abs(initial_energy);
+        const double direct_drift =
+            (total_energy(reference.first, reference.second) - initial_energy)
+            / std::abs(initial_energy);
+        if (!quiet)
+            std::cout << "Relative energy drift after " << drift_steps
+                      << " steps: " << tree_drift << " (Barnes-Hut), "
+                      << direct_drift << " (direct sum)" << std::endl;
+        if (std::abs(tree_drift - direct_drift) > 1e-3)
+            throw std::runtime_error{
+                "Barnes-Hut drifts from the direct sum."
+            };
+    }
+}
+
 int main(int argc, char* argv[])
 {
     try
@@ -469,13 +767,45 @@ int main(int argc, char* argv[])
         // Parse command-line options
         auto opts =
             cl::sdk::parse_cli<cl::sdk::options::Diagnostic,
-                               cl::sdk::options::SingleDevice>(argc, argv);
+                               cl::sdk::options::SingleDevice, NBodyOptions,
+                               cl::sdk::options::Window,
+                               cl::sdk::options::Headless>(argc, argv);
+        const auto& diag_opts = std::get<0>(opts);
         const auto& dev_opts = std::get<1>(opts).triplet;
+        const auto& nbody_opts = std::get<2>(opts);
+        const auto& win_opts = std::get<3>(opts);
+        const auto& headless_opts = std::get<4>(opts);
+
+        if (headless_opts.enabled)
+            check_kernel(dev_opts, nbody_opts, diag_opts.quiet);
 
         NBody window{ dev_opts.plat_index, dev_opts.dev_index,
-                      dev_opts.dev_type };
+                      dev_opts.dev_type,   nbody_opts.particles,
+                      nbody_opts.kernel,   win_opts.width,
+                      win_opts.height,     win_opts.fullscreen,
+                      headless_opts };
+        window.set_steps_per_frame(win_opts.steps_per_frame);
 
         window.run();
+
+        if (headless_opts.enabled && !diag_opts.quiet)
+        {
+            const double steps_per_second =
+                window.headless_steps() / window.headless_seconds();
+            std::cout << nbody_opts.particles << " particles, "
+                      << window.headless_steps() << " steps of the "
+                      << nbody_opts.kernel << " kernel in "
+                      << window.headless_seconds()
+                      << " s: " << steps_per_second << " steps/s";
+            // Counting 20 floating-point operations per interaction, as
+            // usual for N-body codes.
+            const double interactions = steps_per_second
+                * nbody_opts.particles * nbody_opts.particles;
+            if (nbody_opts.kernel != "barnes-hut")
+                std::cout << ", " << interactions << " interactions/s, "
+                          << interactions * 20 / 1e9 << " GFLOP/s";
+            std::cout << std::endl;
+        }
     } catch (cl::util::Error& e)
     {
         std::cerr << "OpenCL Utils error: " << e.what() << std::endl;
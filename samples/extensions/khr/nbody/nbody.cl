@@ -44,3 +44,63 @@ kernel void nbody(global const float4* pos_mass_front,
     pos_mass_back[gid] = (float4)(my_pos, my_mass);
     velocity[gid] = (float4)(my_vel, 0.f);
 }
+
+#ifdef TILE_SIZE
+// Force exerted by other on a particle at pos, without G and the mass of the
+// particle.
+float3 interaction(float3 pos, float4 other)
+{
+    float3 d = other.xyz - pos;
+    float inv_q = rsqrt(dot(d, d) + epsilon_sq);
+    return other.w * inv_q * inv_q * inv_q * d;
+}
+
+// Same step as nbody, but work-groups load TILE_SIZE particles at a time to
+// local memory, from where all work-items of the group read them, instead of
+// every work-item reading every particle from global memory.
+kernel __attribute__((reqd_work_group_size(TILE_SIZE, 1, 1)))
+void nbody_tiled(global const float4* pos_mass_front,
+                 global float4* pos_mass_back,
+                 global float4* velocity,
+                 uint particle_count,
+                 float dt)
+{
+    local float4 tile[TILE_SIZE];
+
+    size_t gid = get_global_id(0);
+    size_t lid = get_local_id(0);
+    bool active = gid < particle_count;
+    float4 my_pos_mass = active ? pos_mass_front[gid] : (float4)0.f;
+
+    float3 acc = (float3)0.f;
+    for (uint base = 0; base < particle_count; base += TILE_SIZE)
+    {
+        // Particles past the end have no mass, they exert no force.
+        uint i = base + lid;
+        tile[lid] = i < particle_count ? pos_mass_front[i] : (float4)0.f;
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        // TILE_SIZE is a multiple of 4
+        for (uint j = 0; j < TILE_SIZE; j += 4)
+        {
+            acc += interaction(my_pos_mass.xyz, tile[j]);
+            acc += interaction(my_pos_mass.xyz, tile[j + 1]);
+            acc += interaction(my_pos_mass.xyz, tile[j + 2]);
+            acc += interaction(my_pos_mass.xyz, tile[j + 3]);
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    if (!active) return;
+    acc *= G * my_pos_mass.w;
+
+    // updated position and velocity
+    float3 my_pos = my_pos_mass.xyz;
+    float3 my_vel = velocity[gid].xyz;
+    my_pos += my_vel * dt + acc * 0.5f * dt * dt;
+    my_vel += acc * dt;
+
+    // write to global memory
+    pos_mass_back[gid] = (float4)(my_pos, my_pos_mass.w);
+    velocity[gid] = (float4)(my_vel, 0.f);
+}
+#endif